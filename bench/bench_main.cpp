@@ -0,0 +1,460 @@
+// MediaDatabaseBench: builds synthetic photo libraries and times the core stages the app
+// runs on them (scan, catalog, filter, query, favorites, decode, metadata, fit/layout, import).
+//
+//   MediaDatabaseBench [--sizes 1000,100000] [--full] [--samples N] [--dir PATH] [--keep]
+//
+// --full adds the 1M-file library. Library files are hard links to a handful of template
+// images (JPG/PNG/BMP at three resolutions), so even the large libraries take little disk.
+
+#include <SFML/Graphics/Image.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../core/util.hpp"
+#include "../core/catalog.hpp"
+#include "../core/decode.hpp"
+#include "../core/favorites.hpp"
+#include "../core/import.hpp"
+#include "../core/layout.hpp"
+#include "../core/metadata.hpp"
+#include "../core/photo_table.hpp"
+#include "../core/library_index.hpp"
+#include "../core/search_index.hpp"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double msSince(BenchClock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t0).count();
+}
+
+// ---------- results ----------
+// One timed stage: the latency of each operation plus how many items each operation covered.
+struct StageResult {
+    explicit StageResult(std::string n) : name(std::move(n)) {}
+
+    std::string name;
+    std::vector<double> opMs;
+    std::uint64_t items = 0;
+    std::uint64_t bytes = 0;
+};
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    std::size_t i = (std::size_t)std::min<double>((double)v.size() - 1, p * (double)(v.size() - 1) + 0.5);
+    return v[i];
+}
+
+static void printHeader(std::size_t files) {
+    std::printf("\n== library: %zu files ==\n", files);
+    std::printf("%-16s %8s %10s %12s %9s %10s %10s %10s\n",
+                "stage", "ops", "items", "items/s", "MB/s", "p50 ms", "p95 ms", "p99 ms");
+}
+
+static void printStage(const StageResult& r) {
+    double totalMs = 0.0;
+    for (double ms : r.opMs) totalMs += ms;
+    double secs = totalMs / 1000.0;
+    double ips = secs > 0.0 ? (double)r.items / secs : 0.0;
+    double mbs = secs > 0.0 ? (double)r.bytes / (1024.0 * 1024.0) / secs : 0.0;
+    std::printf("%-16s %8zu %10llu %12.0f %9.1f %10.3f %10.3f %10.3f\n",
+                r.name.c_str(), r.opMs.size(), (unsigned long long)r.items, ips, mbs,
+                percentile(r.opMs, 0.50), percentile(r.opMs, 0.95), percentile(r.opMs, 0.99));
+}
+
+// ---------- synthetic library ----------
+struct Template {
+    std::string path;
+    sf::Vector2u size;
+    std::uint64_t bytes = 0;
+};
+
+// a smooth gradient with some noise, so JPEG and PNG sizes look like photos rather than flat fills
+static sf::Image makePattern(sf::Vector2u size, std::uint32_t seed) {
+    std::vector<std::uint8_t> px((std::size_t)size.x * size.y * 4);
+    std::minstd_rand rng(seed);
+    for (unsigned y = 0; y < size.y; y++) {
+        for (unsigned x = 0; x < size.x; x++) {
+            std::uint8_t* p = px.data() + ((std::size_t)y * size.x + x) * 4;
+            unsigned n = rng() & 15;
+            p[0] = (std::uint8_t)((x * 255 / size.x + n) & 255);
+            p[1] = (std::uint8_t)((y * 255 / size.y + n) & 255);
+            p[2] = (std::uint8_t)(((x + y) * 127 / (size.x + size.y) + seed * 40) & 255);
+            p[3] = 255;
+        }
+    }
+    return sf::Image(size, px.data());
+}
+
+static std::vector<Template> makeTemplates(const fs::path& dir) {
+    const sf::Vector2u sizes[] = {{640, 480}, {1920, 1080}, {4000, 3000}};
+    const char* exts[] = {".jpg", ".png", ".bmp"};
+
+    fs::create_directories(dir);
+    std::vector<Template> out;
+    std::uint32_t seed = 1;
+    for (auto size : sizes) {
+        sf::Image img = makePattern(size, seed++);
+        for (const char* ext : exts) {
+            Template t;
+            t.path = (dir / ("template_" + std::to_string(size.x) + "x" + std::to_string(size.y) + ext)).string();
+            t.size = size;
+            if (!img.saveToFile(t.path)) {
+                std::cout << "Cannot write template: " << t.path << "\n";
+                continue;
+            }
+            t.bytes = (std::uint64_t)fs::file_size(t.path);
+            out.push_back(t);
+        }
+    }
+    return out;
+}
+
+// file i is a hard link to template i % T (a copy if the filesystem refuses links)
+static std::vector<std::size_t> populateLibrary(const fs::path& dir, std::size_t files,
+                                                const std::vector<Template>& templates) {
+    fs::create_directories(dir);
+    std::vector<std::size_t> kinds(files);
+    char name[64];
+    for (std::size_t i = 0; i < files; i++) {
+        std::size_t k = i % templates.size();
+        kinds[i] = k;
+        std::snprintf(name, sizeof(name), "img_%07zu", i);
+        fs::path dst = dir / (name + fs::path(templates[k].path).extension().string());
+        std::error_code ec;
+        fs::create_hard_link(templates[k].path, dst, ec);
+        if (ec) fs::copy_file(templates[k].path, dst, fs::copy_options::overwrite_existing, ec);
+    }
+    return kinds;
+}
+
+// ---------- stages ----------
+static StageResult benchScanCold(const std::string& lib, const std::string& idx, int runs) {
+    StageResult r{"scan (cold)"};
+    for (int i = 0; i < runs; i++) {
+        std::error_code ec;
+        fs::remove(idx, ec);
+        auto t0 = BenchClock::now();
+        LibraryIndex index(lib, idx);
+        index.reconcile();
+        r.opMs.push_back(msSince(t0));
+        r.items += index.size();
+    }
+    return r;
+}
+
+// index file already present and the folder unchanged: load + mtime check only
+static StageResult benchScanWarm(const std::string& lib, const std::string& idx, int runs) {
+    StageResult r{"scan (warm)"};
+    for (int i = 0; i < runs; i++) {
+        auto t0 = BenchClock::now();
+        LibraryIndex index(lib, idx);
+        index.reconcile();
+        auto paths = index.paths();
+        r.opMs.push_back(msSince(t0));
+        r.items += paths.size();
+    }
+    return r;
+}
+
+// reopening a catalog that holds a record per library file: map + replay, independent of its size
+static StageResult benchCatalogOpen(const std::string& db, const std::string& wal, int runs) {
+    StageResult r{"catalog open"};
+    for (int i = 0; i < runs; i++) {
+        auto t0 = BenchClock::now();
+        Catalog catalog(db, wal);
+        std::string v;
+        catalog.get(CatalogTable::Settings, "lang", v);
+        r.opMs.push_back(msSince(t0));
+        r.items++;
+    }
+    return r;
+}
+
+static StageResult benchFilter(const std::vector<std::string>& paths, const FavoritesSet& favorites, int runs) {
+    StageResult r{"filter"};
+    for (int i = 0; i < runs; i++) {
+        auto t0 = BenchClock::now();
+        auto kept = filterFavorites(paths, favorites);
+        r.opMs.push_back(msSince(t0));
+        r.items += paths.size();
+    }
+    return r;
+}
+
+// combined predicates over the columnar table, the way the grid re-filters on every change
+static StageResult benchQuery(PhotoTable& table, int runs) {
+    const char* queries[] = {"fav", "landscape >2mp", "fav landscape >12mp taken:2025", "sort:-date",
+                             "sort:res <1mb", "portrait sort:size"};
+    StageResult r{"query"};
+    for (int i = 0; i < runs; i++) {
+        for (const char* q : queries) {
+            PhotoFilter f;
+            parsePhotoFilter(q, f);
+            auto t0 = BenchClock::now();
+            auto rows = table.select(f);
+            r.opMs.push_back(msSince(t0));
+            r.items += table.size();
+        }
+    }
+    return r;
+}
+
+static StageResult benchFavorites(FavoritesSet& favorites, const std::vector<std::string>& paths, std::size_t toggles) {
+    StageResult r{"favorite toggle"};
+    if (paths.empty()) return r;
+    std::minstd_rand rng(7);
+    for (std::size_t i = 0; i < toggles; i++) {
+        const std::string& path = paths[rng() % paths.size()];
+        auto t0 = BenchClock::now();
+        favorites.toggle(path);
+        r.opMs.push_back(msSince(t0));
+        r.items++;
+    }
+    return r;
+}
+
+// index build over name + caption, then one query per keystroke while typing a few queries
+static StageResult benchSearch(const std::vector<std::string>& paths, double& buildMs) {
+    const char* words[] = {"beach", "mountain", "birthday", "family", "sunset", "party",
+                           "кот", "дача", "море", "Москва", "snow", "city"};
+    std::vector<std::string> texts;
+    texts.reserve(paths.size());
+    std::minstd_rand rng(11);
+    for (auto& p : paths) texts.push_back(baseName(p) + " " + words[rng() % 12] + " " + words[rng() % 12]);
+
+    SearchIndex index;
+    auto t0 = BenchClock::now();
+    index.build(texts);
+    buildMs = msSince(t0);
+
+    StageResult r{"search (key)"};
+    const char* typed[] = {"sunset", "img_00012", "море кот", "birthday sno"};
+    for (const char* q : typed) {
+        std::string partial;
+        for (const char* c = q; *c; c++) {
+            partial += *c;
+            if (((unsigned char)c[1] & 0xC0) == 0x80) continue;   // whole UTF-8 characters only
+            auto k0 = BenchClock::now();
+            index.query(partial);
+            r.opMs.push_back(msSince(k0));
+            r.items++;
+        }
+    }
+    return r;
+}
+
+static StageResult benchDecode(const char* name, const std::vector<std::string>& sample, sf::Vector2u target) {
+    StageResult r{name};
+    for (auto& path : sample) {
+        auto t0 = BenchClock::now();
+        DecodedImage img;
+        bool ok = decodeFileForTarget(path, target, img);
+        r.opMs.push_back(msSince(t0));
+        if (!ok) continue;
+        r.items++;
+        r.bytes += (std::uint64_t)fs::file_size(path);
+    }
+    return r;
+}
+
+// viewer fit for every photo at a few window sizes
+static StageResult benchLayout(const std::vector<Template>& templates, const std::vector<std::size_t>& kinds, int runs) {
+    const sf::Vector2u windows[] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    StageResult r{"fit/layout"};
+    float sink = 0.f;
+    for (int i = 0; i < runs; i++) {
+        auto t0 = BenchClock::now();
+        for (std::size_t k : kinds) {
+            for (auto win : windows) sink += computeFit(templates[k].size, win, 70.f, 1.f).scale;
+        }
+        r.opMs.push_back(msSince(t0));
+        r.items += kinds.size();
+    }
+    if (sink < 0.f) std::cout << sink;
+    return r;
+}
+
+// header-only metadata read, what MetadataStore workers do per file
+static StageResult benchMetadata(const std::vector<std::string>& sample) {
+    StageResult r{"metadata"};
+    for (auto& path : sample) {
+        auto t0 = BenchClock::now();
+        ImageMeta meta;
+        bool ok = readImageMeta(path, meta);
+        r.opMs.push_back(msSince(t0));
+        if (ok) r.items++;
+    }
+    return r;
+}
+
+static StageResult benchThumbnail(const std::vector<std::string>& sample) {
+    StageResult r{"thumbnail"};
+    std::vector<std::uint8_t> thumb((std::size_t)128 * 128 * 4);
+    for (auto& path : sample) {
+        auto t0 = BenchClock::now();
+        DecodedImage img;
+        if (decodeFileForTarget(path, {128, 128}, img)) {
+            makeThumbnail(img.image, thumb.data(), 128);
+            r.items++;
+        }
+        r.opMs.push_back(msSince(t0));
+    }
+    return r;
+}
+
+static StageResult benchImport(const std::vector<std::string>& sample, const std::string& dst) {
+    StageResult r{"import"};
+    std::string finalName;
+    for (auto& path : sample) {
+        auto t0 = BenchClock::now();
+        bool ok = copyToFolderUnique(path, dst, finalName);
+        r.opMs.push_back(msSince(t0));
+        if (!ok) continue;
+        r.items++;
+        r.bytes += (std::uint64_t)fs::file_size(path);
+    }
+    return r;
+}
+
+// the same files through the parallel importer: one operation, throughput is what matters
+static StageResult benchBulkImport(const std::vector<std::string>& sample, const std::string& dst) {
+    StageResult r{"import (bulk)"};
+    unsigned hw = std::thread::hardware_concurrency();
+    auto t0 = BenchClock::now();
+    auto result = importFiles(sample, dst, hw > 1 ? std::min(hw, 8u) : 2);
+    r.opMs.push_back(msSince(t0));
+    r.items = result.imported.size();
+    r.bytes = result.totals.bytesDone;
+    return r;
+}
+
+static std::vector<std::string> sampleOf(const std::vector<std::string>& paths, std::size_t n) {
+    std::vector<std::string> out;
+    if (paths.empty()) return out;
+    std::size_t step = std::max<std::size_t>(1, paths.size() / n);
+    for (std::size_t i = 0; i < paths.size() && out.size() < n; i += step) out.push_back(paths[i]);
+    return out;
+}
+
+static std::vector<std::size_t> parseSizes(const std::string& s) {
+    std::vector<std::size_t> out;
+    std::size_t pos = 0;
+    while (pos < s.size()) {
+        auto comma = s.find(',', pos);
+        if (comma == std::string::npos) comma = s.size();
+        std::string part = trim(s.substr(pos, comma - pos));
+        if (!part.empty()) out.push_back((std::size_t)std::stoull(part));
+        pos = comma + 1;
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes = {1000, 100000};
+    std::size_t samples = 60;
+    fs::path base = fs::temp_directory_path() / "mediadb_bench";
+    bool keep = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--sizes" && i + 1 < argc) sizes = parseSizes(argv[++i]);
+        else if (a == "--full") sizes.push_back(1000000);
+        else if (a == "--samples" && i + 1 < argc) samples = (std::size_t)std::stoull(argv[++i]);
+        else if (a == "--dir" && i + 1 < argc) base = argv[++i];
+        else if (a == "--keep") keep = true;
+        else {
+            std::cout << "usage: MediaDatabaseBench [--sizes 1000,100000] [--full] [--samples N] [--dir PATH] [--keep]\n";
+            return a == "--help" ? 0 : 1;
+        }
+    }
+
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    auto templates = makeTemplates(base / "templates");
+    if (templates.empty()) {
+        std::cout << "No template images could be written to " << base << "\n";
+        return 1;
+    }
+#ifdef MEDIADB_HAVE_LIBJPEG
+    std::cout << "libjpeg: scaled JPEG decoding enabled\n";
+#else
+    std::cout << "libjpeg: not available, JPEGs decode at full size then halve\n";
+#endif
+
+    for (std::size_t files : sizes) {
+        fs::path root = base / ("lib_" + std::to_string(files));
+        std::string lib = (root / "images").string();
+        std::string idx = (root / "library.idx").string();
+
+        auto t0 = BenchClock::now();
+        auto kinds = populateLibrary(lib, files, templates);
+        std::printf("\n(generated %zu files in %.1f s)", files, msSince(t0) / 1000.0);
+        printHeader(files);
+
+        int scanRuns = files >= 1000000 ? 2 : 5;
+        printStage(benchScanCold(lib, idx, scanRuns));
+        printStage(benchScanWarm(lib, idx, scanRuns * 4));
+
+        LibraryIndex index(lib, idx);
+        index.reconcile();
+        auto paths = index.paths();
+
+        // every 10th file is a favorite; every file gets its header metadata
+        std::string db = (root / "catalog.db").string(), wal = (root / "catalog.wal").string();
+        Catalog catalog(db, wal);
+        FavoritesSet favorites(catalog, lib);
+        for (std::size_t i = 0; i < paths.size(); i += 10) favorites.toggle(paths[i]);
+        unsigned hw = std::thread::hardware_concurrency();
+        {
+            MetadataStore metadata(catalog, hw ? hw : 2);
+            t0 = BenchClock::now();
+            metadata.sync(index.all());
+            while (metadata.pending() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::printf("(metadata for %zu files in %.1f s)\n", paths.size(), msSince(t0) / 1000.0);
+        }
+        catalog.checkpoint();
+
+        printStage(benchCatalogOpen(db, wal, 20));
+
+        PhotoTable table;
+        {
+            MetadataStore metadata(catalog, 1);
+            t0 = BenchClock::now();
+            table.build(index.all(), metadata, favorites);
+            double buildMs = msSince(t0);
+            printStage(benchQuery(table, 5));
+            std::printf("%-16s %8s %10zu %12s %9s %10.3f\n", "query (build)", "1", table.size(), "", "", buildMs);
+        }
+
+        printStage(benchFilter(paths, favorites, 20));
+        printStage(benchFavorites(favorites, paths, 10000));
+        double searchBuildMs = 0.0;
+        printStage(benchSearch(paths, searchBuildMs));
+        std::printf("%-16s %8s %10zu %12s %9s %10.3f\n", "search (build)", "1", paths.size(), "", "", searchBuildMs);
+
+        auto sample = sampleOf(paths, samples);
+        printStage(benchDecode("decode (fit)", sample, {1920, 1080}));
+        printStage(benchDecode("decode (full)", sample, {0, 0}));
+        printStage(benchMetadata(sample));
+        printStage(benchThumbnail(sample));
+        printStage(benchLayout(templates, kinds, 10));
+        auto importSample = sampleOf(paths, samples * 10);
+        printStage(benchImport(importSample, (root / "imported").string()));
+        printStage(benchBulkImport(importSample, (root / "imported_bulk").string()));
+
+        if (!keep) fs::remove_all(root, ec);
+    }
+
+    if (!keep) fs::remove_all(base, ec);
+    return 0;
+}
@@ -0,0 +1,316 @@
+// MediaDatabaseHttpLoad: drives a running `MediaDatabaseGUI --serve` with keep-alive
+// connections and reports throughput and latency, like a gallery front end would load it.
+//
+//   MediaDatabaseHttpLoad [--host 127.0.0.1] [--port 8080] [--connections 64] [--threads 4]
+//                         [--seconds 10] [--kind thumb|image|meta|mixed]
+//
+// The photo list comes from /api/photos first; every connection then requests random photos
+// back to back (one request in flight per connection) until the time is up.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using LoadClock = std::chrono::steady_clock;
+
+struct Target {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+};
+
+static int connectTo(const Target& t, bool nonBlocking) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((std::uint16_t)t.port);
+    if (inet_pton(AF_INET, t.host.c_str(), &addr.sin_addr) != 1 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (nonBlocking) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static std::string urlEncode(const std::string& s) {
+    static const char* hex = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : s) {
+        if (std::isalnum(c) || c == '/' || c == '.' || c == '-' || c == '_' || c == '~') {
+            out += (char)c;
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out;
+}
+
+// one blocking GET with Connection: close; the body, or empty on failure
+static std::string fetch(const Target& t, const std::string& path) {
+    int fd = connectTo(t, false);
+    if (fd < 0) return {};
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + t.host + "\r\nConnection: close\r\n\r\n";
+    send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+    std::string resp;
+    char buf[65536];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) resp.append(buf, (std::size_t)n);
+    close(fd);
+    auto body = resp.find("\r\n\r\n");
+    if (resp.compare(0, 12, "HTTP/1.1 200") != 0 || body == std::string::npos) return {};
+    return resp.substr(body + 4);
+}
+
+// the "path" strings of an /api/photos response
+static std::vector<std::string> parsePaths(const std::string& json) {
+    std::vector<std::string> paths;
+    const std::string key = "\"path\":\"";
+    for (std::size_t at = json.find(key); at != std::string::npos; at = json.find(key, at)) {
+        at += key.size();
+        std::string p;
+        while (at < json.size() && json[at] != '"') {
+            if (json[at] == '\\' && at + 1 < json.size()) at++;
+            p += json[at++];
+        }
+        paths.push_back(std::move(p));
+    }
+    return paths;
+}
+
+// ---------- load ----------
+struct Conn {
+    int fd = -1;
+    std::string out;
+    std::size_t outSent = 0;
+    std::string in;
+    long long bodyLeft = -1;   // -1 while the headers are still coming
+    int status = 0;
+    bool watchOut = false;
+    LoadClock::time_point sentAt;
+};
+
+struct Totals {
+    std::vector<double> latencyMs;
+    std::uint64_t requests = 0, bytes = 0, ok = 0, notModified = 0, unavailable = 0, otherStatus = 0, errors = 0;
+
+    void add(const Totals& o) {
+        latencyMs.insert(latencyMs.end(), o.latencyMs.begin(), o.latencyMs.end());
+        requests += o.requests;
+        bytes += o.bytes;
+        ok += o.ok;
+        notModified += o.notModified;
+        unavailable += o.unavailable;
+        otherStatus += o.otherStatus;
+        errors += o.errors;
+    }
+};
+
+static void runLoad(const Target& t, const std::vector<std::string>& urls, unsigned connections, double seconds,
+                    unsigned seed, Totals& out) {
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Conn> conns(connections);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::size_t> pick(0, urls.size() - 1);
+    auto deadline = LoadClock::now() + std::chrono::duration_cast<LoadClock::duration>(std::chrono::duration<double>(seconds));
+
+    // sends what the socket takes; EPOLLOUT is watched only while some of the request is left
+    auto flush = [&](std::size_t i) {
+        Conn& c = conns[i];
+        while (c.outSent < c.out.size()) {
+            ssize_t w = send(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent, MSG_NOSIGNAL);
+            if (w < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                break;
+            }
+            c.outSent += (std::size_t)w;
+        }
+        bool left = c.outSent < c.out.size();
+        if (left != c.watchOut) {
+            epoll_event ev {};
+            ev.events = left ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            ev.data.u64 = i;
+            epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+            c.watchOut = left;
+        }
+        return true;
+    };
+    auto issue = [&](std::size_t i) {
+        Conn& c = conns[i];
+        c.out = "GET " + urls[pick(rng)] + " HTTP/1.1\r\nHost: " + t.host + "\r\n\r\n";
+        c.outSent = 0;
+        c.bodyLeft = -1;
+        c.sentAt = LoadClock::now();
+        return flush(i);
+    };
+    auto open = [&](std::size_t i) {
+        Conn& c = conns[i];
+        c = Conn{};
+        c.fd = connectTo(t, true);
+        if (c.fd < 0) return false;
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+        return issue(i);
+    };
+    auto reopen = [&](std::size_t i) {
+        out.errors++;
+        close(conns[i].fd);
+        conns[i].fd = -1;
+        if (LoadClock::now() < deadline) open(i);
+    };
+
+    std::size_t live = 0;
+    for (std::size_t i = 0; i < conns.size(); i++) live += open(i) ? 1 : 0;
+    out.errors += conns.size() - live;
+
+    epoll_event events[256];
+    char buf[65536];
+    while (LoadClock::now() < deadline) {
+        int n = epoll_wait(ep, events, 256, 100);
+        for (int k = 0; k < n; k++) {
+            std::size_t i = events[k].data.u64;
+            Conn& c = conns[i];
+            if (c.fd < 0) continue;
+            bool failed = (events[k].events & EPOLLERR) != 0;
+            if (!failed && (events[k].events & EPOLLOUT)) failed = !flush(i);
+
+            while (!failed) {
+                ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+                if (r < 0) {
+                    failed = errno != EAGAIN && errno != EWOULDBLOCK;
+                    break;
+                }
+                if (r == 0) {
+                    failed = true;
+                    break;
+                }
+                std::size_t used = 0;
+                if (c.bodyLeft < 0) {
+                    c.in.append(buf, (std::size_t)r);
+                    auto end = c.in.find("\r\n\r\n");
+                    if (end == std::string::npos) continue;
+                    c.status = std::atoi(c.in.c_str() + 9);
+                    c.bodyLeft = 0;
+                    auto cl = c.in.find("Content-Length: ");
+                    if (cl != std::string::npos && cl < end) c.bodyLeft = std::atoll(c.in.c_str() + cl + 16);
+                    std::size_t extra = c.in.size() - (end + 4);
+                    used = (std::size_t)r - extra;
+                    c.in.clear();
+                }
+                long long take = std::min<long long>(c.bodyLeft, (long long)((std::size_t)r - used));
+                c.bodyLeft -= take;
+                out.bytes += (std::uint64_t)take;
+                if (c.bodyLeft > 0) continue;
+
+                out.latencyMs.push_back(std::chrono::duration<double, std::milli>(LoadClock::now() - c.sentAt).count());
+                out.requests++;
+                if (c.status == 200) out.ok++;
+                else if (c.status == 304) out.notModified++;
+                else if (c.status == 503) out.unavailable++;
+                else out.otherStatus++;
+                // one request in flight: the response ends exactly where this read ended
+                if (LoadClock::now() < deadline) failed = !issue(i);
+                break;
+            }
+            if (failed) reopen(i);
+        }
+    }
+    for (auto& c : conns) {
+        if (c.fd >= 0) close(c.fd);
+    }
+    close(ep);
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0.0;
+    std::size_t i = (std::size_t)std::min<double>((double)v.size() - 1, p * (double)(v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + (std::ptrdiff_t)i, v.end());
+    return v[i];
+}
+
+int main(int argc, char** argv) {
+    Target target;
+    unsigned connections = 64, threads = 4;
+    double seconds = 10.0;
+    std::string kind = "mixed";
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto value = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (a == "--host") target.host = value();
+        else if (a == "--port") target.port = std::atoi(value().c_str());
+        else if (a == "--connections") connections = (unsigned)std::max(1, std::atoi(value().c_str()));
+        else if (a == "--threads") threads = (unsigned)std::max(1, std::atoi(value().c_str()));
+        else if (a == "--seconds") seconds = std::atof(value().c_str());
+        else if (a == "--kind") kind = value();
+        else {
+            std::cout << "usage: MediaDatabaseHttpLoad [--host H] [--port P] [--connections N] [--threads N]"
+                         " [--seconds S] [--kind thumb|image|meta|mixed]\n";
+            return 2;
+        }
+    }
+    threads = std::min(threads, connections);
+
+    auto paths = parsePaths(fetch(target, "/api/photos?limit=10000"));
+    if (paths.empty()) {
+        std::cout << "no photos from http://" << target.host << ":" << target.port << "/api/photos\n";
+        return 1;
+    }
+    std::vector<std::string> urls;
+    for (auto& p : paths) {
+        std::string enc = urlEncode(p);
+        if (kind == "thumb" || kind == "mixed") urls.push_back("/thumb/" + enc);
+        if (kind == "image" || kind == "mixed") urls.push_back("/image/" + enc);
+        if (kind == "meta" || kind == "mixed") urls.push_back("/api/meta/" + enc);
+    }
+    if (urls.empty()) {
+        std::cout << "unknown --kind " << kind << "\n";
+        return 2;
+    }
+
+    std::printf("%zu photos, %u connections on %u threads, %.0f s, %s\n",
+                paths.size(), connections, threads, seconds, kind.c_str());
+    std::vector<Totals> perThread(threads);
+    std::vector<std::thread> workers;
+    auto t0 = LoadClock::now();
+    for (unsigned i = 0; i < threads; i++) {
+        unsigned share = connections / threads + (i < connections % threads ? 1 : 0);
+        workers.emplace_back([&, i, share]{ runLoad(target, urls, share, seconds, 1234 + i, perThread[i]); });
+    }
+    for (auto& w : workers) w.join();
+    double elapsed = std::chrono::duration<double>(LoadClock::now() - t0).count();
+
+    Totals all;
+    for (auto& t : perThread) all.add(t);
+    std::printf("%-10s %12s %10s %10s %10s %10s\n", "requests", "req/s", "MB/s", "p50 ms", "p95 ms", "p99 ms");
+    std::printf("%-10llu %12.0f %10.1f %10.3f %10.3f %10.3f\n",
+                (unsigned long long)all.requests, all.requests / elapsed,
+                (double)all.bytes / (1024.0 * 1024.0) / elapsed,
+                percentile(all.latencyMs, 0.50), percentile(all.latencyMs, 0.95), percentile(all.latencyMs, 0.99));
+    std::printf("200: %llu  304: %llu  503: %llu  other: %llu  connection errors: %llu\n",
+                (unsigned long long)all.ok, (unsigned long long)all.notModified, (unsigned long long)all.unavailable,
+                (unsigned long long)all.otherStatus, (unsigned long long)all.errors);
+    return all.errors == 0 && all.otherStatus == 0 ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#include "batch_jobs.hpp"
+#include "content_hash.hpp"
+#include "hash_index.hpp"
+#include "import.hpp"
+#include "library_index.hpp"
+#include "metadata.hpp"
+#include "profiler.hpp"
+#include "thumb_store.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+
+namespace {
+
+using JobClock = std::chrono::steady_clock;
+
+double secondsSince(JobClock::time_point t0) {
+    return std::chrono::duration<double>(JobClock::now() - t0).count();
+}
+
+double perSec(double n, double seconds) {
+    return seconds > 0.0 ? n / seconds : 0.0;
+}
+
+// the store's workers drain their queue on their own; the job just waits for them
+double waitForMetadata(MetadataStore& metadata) {
+    auto t0 = JobClock::now();
+    while (metadata.pending() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return secondsSince(t0);
+}
+
+} // namespace
+
+std::string JobReport::json() const {
+    std::string out = "{\"job\":\"" + job + "\",\"ok\":" + (ok ? "true" : "false");
+    char num[64];
+    for (auto& [key, value] : fields) {
+        if (value == std::floor(value) && std::fabs(value) < 1e15) std::snprintf(num, sizeof(num), "%.0f", value);
+        else std::snprintf(num, sizeof(num), "%.3f", value);
+        out += ",\"" + key + "\":" + num;
+    }
+    return out + "}";
+}
+
+JobReport runScanJob(LibraryIndex& library, MetadataStore& metadata, HashIndex& hashes, unsigned threads) {
+    JobReport r("scan");
+    library.reconcile();
+    auto& s = library.lastScan();
+    metadata.sync(library.all());
+    std::size_t queued = metadata.pending();
+
+    // hashed alongside the metadata workers; import and verify need the hashes
+    std::size_t toHash = 0;
+    for (auto& e : library.all()) {
+        std::uint64_t hash, size;
+        std::int64_t mtime;
+        if (!hashes.get(e.path, hash, size, mtime) || size != e.size || mtime != e.mtime) toHash++;
+    }
+    auto t0 = JobClock::now();
+    hashes.sync(library.all(), threads);
+    hashes.flush();
+    double hashSeconds = secondsSince(t0);
+    double metaSeconds = waitForMetadata(metadata) + hashSeconds;
+
+    r.set("dirs", (double)s.dirs);
+    r.set("dirs_listed", (double)s.listed);
+    r.set("files_sniffed", (double)s.opened);
+    r.set("images", (double)library.size());
+    r.set("mislabeled", (double)s.mislabeled);
+    r.set("unsupported", (double)s.unsupported);
+    r.set("scan_seconds", s.seconds);
+    r.set("files_per_sec", perSec((double)s.files, s.seconds));
+    r.set("metadata_read", (double)queued);
+    r.set("metadata_seconds", metaSeconds);
+    r.set("metadata_per_sec", perSec((double)queued, metaSeconds));
+    r.set("hashed", (double)toHash);
+    r.set("hash_seconds", hashSeconds);
+    r.set("hash_per_sec", perSec((double)toHash, hashSeconds));
+    return r;
+}
+
+JobReport runImportJob(const std::string& srcFolder, const std::string& dstFolder, LibraryIndex& library,
+                       HashIndex& hashes, MetadataStore& metadata, unsigned threads) {
+    JobReport r("import");
+    library.reconcile();
+    hashes.sync(library.all(), threads);
+
+    auto result = importFolder(srcFolder, dstFolder, threads, {}, &hashes);
+    for (auto& f : result.failed) std::cerr << "import failed: " << f << "\n";
+    library.add(result.imported);
+    metadata.sync(library.all());
+    double metaSeconds = waitForMetadata(metadata);
+    library.flush();
+    hashes.flush();
+
+    auto& t = result.totals;
+    r.set("files", (double)t.filesTotal);
+    r.set("imported", (double)result.imported.size());
+    r.set("duplicates", (double)result.duplicates.size());
+    r.set("failed", (double)result.failed.size());
+    r.set("cloned", (double)result.cloned);
+    r.set("kernel_copied", (double)result.kernelCopied);
+    r.set("bytes", (double)t.bytesDone);
+    r.set("seconds", t.seconds);
+    r.set("mb_per_sec", t.mbPerSec());
+    r.set("files_per_sec", perSec((double)t.filesDone, t.seconds));
+    r.set("metadata_seconds", metaSeconds);
+    r.ok = result.failed.empty();
+    return r;
+}
+
+JobReport runThumbsJob(LibraryIndex& library, ThumbStore& thumbs) {
+    JobReport r("build-thumbs");
+    library.reconcile();
+    std::vector<LibraryIndex::Entry> missing;
+    std::size_t total = 0;
+    for (auto& e : library.all()) {
+        total++;
+        if (!thumbs.has(e.path, e.mtime)) missing.push_back(e);
+    }
+
+    // request() replaces the queue and reads the whole batch ahead, so it gets a slice at a time
+    const std::size_t CHUNK = 1024;
+    auto t0 = JobClock::now();
+    for (std::size_t start = 0; start < missing.size(); start += CHUNK) {
+        thumbs.request({missing.begin() + (std::ptrdiff_t)start,
+                        missing.begin() + (std::ptrdiff_t)std::min(missing.size(), start + CHUNK)});
+        while (thumbs.busy()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double seconds = secondsSince(t0);
+
+    std::size_t failed = 0;
+    for (auto& e : missing) {
+        if (thumbs.has(e.path, e.mtime)) continue;
+        std::cerr << "no thumbnail: " << e.path << "\n";
+        failed++;
+    }
+    r.set("images", (double)total);
+    r.set("already", (double)(total - missing.size()));
+    r.set("generated", (double)(missing.size() - failed));
+    r.set("failed", (double)failed);
+    r.set("stored", (double)thumbs.count());
+    r.set("seconds", seconds);
+    r.set("thumbs_per_sec", perSec((double)(missing.size() - failed), seconds));
+    r.ok = failed == 0;
+    return r;
+}
+
+JobReport runVerifyJob(LibraryIndex& library, HashIndex& hashes, unsigned threads) {
+    JobReport r("verify");
+    const auto& entries = library.all();
+    std::atomic<std::size_t> next{0}, good{0}, missing{0}, changed{0}, corrupt{0}, unhashed{0}, unreadable{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::mutex logM;
+    auto problem = [&](const char* what, const std::string& path) {
+        std::lock_guard<std::mutex> lk(logM);
+        std::cerr << what << ": " << path << "\n";
+    };
+
+    auto t0 = JobClock::now();
+    if (threads == 0) threads = 1;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&]{
+            ImageMeta meta;
+            while (true) {
+                std::size_t i = next.fetch_add(1);
+                if (i >= entries.size()) return;
+                const auto& e = entries[i];
+
+                struct stat st {};
+                if (stat(e.path.c_str(), &st) != 0) {
+                    missing++;
+                    problem("missing", e.path);
+                    continue;
+                }
+                if ((std::uint64_t)st.st_size != e.size || (std::int64_t)st.st_mtime != e.mtime) {
+                    changed++;
+                    problem("changed", e.path);
+                    continue;
+                }
+                bool readable = readImageMeta(e.path, meta);
+                if (!readable) {
+                    unreadable++;
+                    problem("unreadable", e.path);
+                }
+
+                // same size and mtime as when it was hashed, so different bytes mean damage
+                std::uint64_t want, wantSize, hash = 0, size = 0;
+                std::int64_t wantMtime;
+                if (!hashes.get(e.path, want, wantSize, wantMtime) || wantSize != e.size || wantMtime != e.mtime) {
+                    unhashed++;
+                    if (readable) good++;
+                    continue;
+                }
+                bool ok;
+                {
+                    PROFILE_ZONE("hash");
+                    ok = hashFile(e.path, hash, &size);
+                }
+                bytes += size;
+                if (!ok || hash != want) {
+                    corrupt++;
+                    problem("corrupt", e.path);
+                } else if (readable) {
+                    good++;
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double seconds = secondsSince(t0);
+
+    r.set("files", (double)entries.size());
+    r.set("ok_files", (double)good);
+    r.set("missing", (double)missing);
+    r.set("changed", (double)changed);
+    r.set("corrupt", (double)corrupt);
+    r.set("unreadable", (double)unreadable);
+    r.set("unhashed", (double)unhashed);
+    r.set("bytes_hashed", (double)bytes);
+    r.set("seconds", seconds);
+    r.set("mb_per_sec", perSec((double)bytes / (1024.0 * 1024.0), seconds));
+    r.set("files_per_sec", perSec((double)entries.size(), seconds));
+    r.ok = good == entries.size();
+    return r;
+}
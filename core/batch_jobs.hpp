@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+class LibraryIndex;
+class HashIndex;
+class MetadataStore;
+class ThumbStore;
+
+// Outcome of one headless job: numeric fields in print order, printed as one JSON object per
+// line so scripts can collect them. ok is false when the job found or caused problems.
+struct JobReport {
+    explicit JobReport(std::string job) : job(std::move(job)) {}
+
+    std::string job;
+    std::vector<std::pair<std::string, double>> fields;
+    bool ok = true;
+
+    void set(const std::string& key, double value) { fields.emplace_back(key, value); }
+    std::string json() const;
+};
+
+// The library operations of the GUI, run to completion without a window on `threads` workers.
+// File names of failures go to stderr; the numbers are in the report.
+
+// re-scans the library tree, reads the header metadata and content hash of every new or
+// changed image
+JobReport runScanJob(LibraryIndex& library, MetadataStore& metadata, HashIndex& hashes, unsigned threads);
+
+// copies the images under srcFolder into dstFolder (the library), skipping content the
+// library already has, and catalogs them
+JobReport runImportJob(const std::string& srcFolder, const std::string& dstFolder, LibraryIndex& library,
+                       HashIndex& hashes, MetadataStore& metadata, unsigned threads);
+
+// generates every missing grid thumbnail
+JobReport runThumbsJob(LibraryIndex& library, ThumbStore& thumbs);
+
+// checks the index against the disk without changing either: every file still there with the
+// recorded size and mtime, its content hash unchanged, and its header readable
+JobReport runVerifyJob(LibraryIndex& library, HashIndex& hashes, unsigned threads);
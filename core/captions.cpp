@@ -0,0 +1,32 @@
+#include "captions.hpp"
+#include "catalog.hpp"
+#include "util.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+void syncCaptionsFile(Catalog& catalog, const std::string& path) {
+    const std::string MTIME_KEY = "captionsFileMtime";
+    std::error_code ec;
+    bool exists = fs::exists(path, ec);
+    std::string mtime = exists ? std::to_string(mtimeTicks(mtimeOf(path))) : "";
+    std::string synced;
+    catalog.get(CatalogTable::Settings, MTIME_KEY, synced);
+    if (mtime == synced) return;
+
+    std::unordered_map<std::string, std::string> captions;
+    for (auto& line : loadLines(path)) {
+        auto bar = line.find('|');
+        if (bar == std::string::npos) continue;
+        std::string name = trim(line.substr(0, bar));
+        if (!name.empty()) captions[name] = trim(line.substr(bar + 1));
+    }
+
+    std::vector<std::string> gone;
+    catalog.forEach(CatalogTable::Captions, [&](std::string_view name, std::string_view) {
+        if (!captions.count(std::string(name))) gone.emplace_back(name);
+    });
+    for (auto& name : gone) catalog.erase(CatalogTable::Captions, name);
+    for (auto& [name, caption] : captions) catalog.put(CatalogTable::Captions, name, caption);
+    catalog.put(CatalogTable::Settings, MTIME_KEY, mtime);
+}
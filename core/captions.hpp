@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+class Catalog;
+
+// Captions live in the catalog's Captions table (path below the images folder, libraryKey ->
+// caption). captions.txt stays the place to edit them: one "path|caption" per line (a photo
+// at the top of the folder is just its file name), a later line for the same path wins.
+// The file is only parsed when its mtime differs from the one recorded at the last sync, and a
+// path missing from the file loses its caption.
+void syncCaptionsFile(Catalog& catalog, const std::string& path);
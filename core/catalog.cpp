@@ -0,0 +1,360 @@
+#include "catalog.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+constexpr std::uint8_t OP_PUT = 1;
+constexpr std::uint8_t OP_ERASE = 2;
+
+// WAL record: checksum(8) | payload length(4) | payload
+// payload:    op(1) | table(1) | key length(4) | value length(4) | key | value
+constexpr std::size_t RECORD_HEAD = 12;
+constexpr std::size_t PAYLOAD_HEAD = 10;
+
+// Down to stable storage, not just to the drive's cache. On macOS fsync stops at the cache;
+// F_FULLFSYNC flushes it (plain fsync where the file system does not support that). Linux
+// fdatasync skips metadata the data does not need.
+bool syncToDisk(int fd) {
+#if defined(__APPLE__)
+    return fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+#elif defined(__linux__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+bool writeAll(int fd, const void* data, std::size_t n) {
+    const char* p = (const char*)data;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= (std::size_t)w;
+    }
+    return true;
+}
+
+// write(2) behind a buffer; the snapshot is written once per checkpoint, front to back
+struct FileWriter {
+    int fd;
+    std::vector<char> buf;
+    std::uint64_t offset = 0;
+    bool ok = true;
+
+    explicit FileWriter(int fd) : fd(fd) { buf.reserve(1u << 20); }
+
+    void put(const void* data, std::size_t n) {
+        offset += n;
+        if (buf.size() + n > buf.capacity()) drain();
+        if (n >= buf.capacity()) ok = ok && writeAll(fd, data, n);
+        else buf.insert(buf.end(), (const char*)data, (const char*)data + n);
+    }
+    void drain() {
+        ok = ok && writeAll(fd, buf.data(), buf.size());
+        buf.clear();
+    }
+};
+
+} // namespace
+
+Catalog::Catalog(const std::string& snapshotPath, const std::string& walPath)
+    : snapshotPath(snapshotPath), walPath(walPath) {
+    wasFresh = !fs::exists(snapshotPath) && !fs::exists(walPath);
+    mapSnapshot();
+    replayWal();
+}
+
+Catalog::~Catalog() {
+    unmapSnapshot();
+    if (walFd >= 0) close(walFd);
+}
+
+bool Catalog::get(CatalogTable t, std::string_view key, std::string& value) const {
+    std::lock_guard<std::mutex> lk(m);
+    std::string_view v;
+    if (!findLocked(t, key, v)) return false;
+    value.assign(v.data(), v.size());
+    return true;
+}
+
+bool Catalog::contains(CatalogTable t, std::string_view key) const {
+    std::lock_guard<std::mutex> lk(m);
+    std::string_view v;
+    return findLocked(t, key, v);
+}
+
+std::size_t Catalog::count(CatalogTable t) const {
+    std::lock_guard<std::mutex> lk(m);
+    return counts[(std::size_t)t];
+}
+
+void Catalog::put(CatalogTable t, std::string_view key, std::string_view value) {
+    std::lock_guard<std::mutex> lk(m);
+    std::string_view old;
+    if (findLocked(t, key, old) && old == value) return;
+    appendWal(OP_PUT, t, key, value);
+    setLocked(t, key, value);
+    if (walBytes > WAL_CHECKPOINT_BYTES) checkpointLocked();
+}
+
+void Catalog::erase(CatalogTable t, std::string_view key) {
+    std::lock_guard<std::mutex> lk(m);
+    std::string_view old;
+    if (!findLocked(t, key, old)) return;
+    appendWal(OP_ERASE, t, key, {});
+    setLocked(t, key, std::nullopt);
+    if (walBytes > WAL_CHECKPOINT_BYTES) checkpointLocked();
+}
+
+void Catalog::forEach(CatalogTable t, const std::function<void(std::string_view, std::string_view)>& fn) const {
+    std::lock_guard<std::mutex> lk(m);
+    forEachLocked(t, fn);
+}
+
+void Catalog::checkpoint() {
+    std::lock_guard<std::mutex> lk(m);
+    checkpointLocked();
+}
+
+void Catalog::flush() {
+    std::lock_guard<std::mutex> lk(m);
+    if (walFd >= 0) syncToDisk(walFd);
+}
+
+bool Catalog::snapshotFind(CatalogTable t, std::string_view key, std::string_view& value) const {
+    if (!base) return false;
+    const Header* h = (const Header*)base;
+    const TableDir& dir = h->dir[(std::size_t)t];
+    const IndexEntry* first = (const IndexEntry*)(base + dir.indexOff);
+    const IndexEntry* last = first + dir.count;
+    auto keyOf = [&](const IndexEntry& e) {
+        return entryFits(e) ? std::string_view((const char*)base + e.keyOff, e.keyLen) : std::string_view();
+    };
+    auto it = std::lower_bound(first, last, key, [&](const IndexEntry& e, std::string_view k) { return keyOf(e) < k; });
+    if (it == last || !entryFits(*it) || keyOf(*it) != key) return false;
+    value = std::string_view((const char*)base + it->keyOff + it->keyLen, it->valLen);
+    return true;
+}
+
+bool Catalog::findLocked(CatalogTable t, std::string_view key, std::string_view& value) const {
+    const Overlay& ov = overlay[(std::size_t)t];
+    if (!ov.empty()) {
+        auto it = ov.find(std::string(key));
+        if (it != ov.end()) {
+            if (!it->second) return false;
+            value = *it->second;
+            return true;
+        }
+    }
+    return snapshotFind(t, key, value);
+}
+
+void Catalog::setLocked(CatalogTable t, std::string_view key, std::optional<std::string_view> value) {
+    std::string_view old;
+    bool had = findLocked(t, key, old);
+    Overlay& ov = overlay[(std::size_t)t];
+    std::string_view inSnapshot;
+    if (value) ov[std::string(key)] = std::string(*value);
+    else if (snapshotFind(t, key, inSnapshot)) ov[std::string(key)] = std::nullopt;
+    else ov.erase(std::string(key));
+
+    std::size_t& n = counts[(std::size_t)t];
+    if (had && !value) n--;
+    else if (!had && value) n++;
+}
+
+void Catalog::forEachLocked(CatalogTable t, const std::function<void(std::string_view, std::string_view)>& fn) const {
+    const Overlay& ov = overlay[(std::size_t)t];
+    if (base) {
+        const TableDir& dir = ((const Header*)base)->dir[(std::size_t)t];
+        const IndexEntry* idx = (const IndexEntry*)(base + dir.indexOff);
+        for (std::uint64_t i = 0; i < dir.count; i++) {
+            if (!entryFits(idx[i])) continue;
+            const char* k = (const char*)base + idx[i].keyOff;
+            std::string_view key(k, idx[i].keyLen);
+            if (!ov.empty() && ov.count(std::string(key))) continue;
+            fn(key, std::string_view(k + idx[i].keyLen, idx[i].valLen));
+        }
+    }
+    for (auto& [key, value] : ov) {
+        if (value) fn(key, *value);
+    }
+}
+
+// a snapshot that is missing, truncated or from another version is treated as empty. Only the
+// header is checked here (entries are bounds-checked as they are read), so opening stays O(1).
+void Catalog::mapSnapshot() {
+    for (auto& n : counts) n = 0;
+    int fd = open(snapshotPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st {};
+    std::size_t bytes = fstat(fd, &st) == 0 ? (std::size_t)st.st_size : 0;
+    void* p = bytes >= sizeof(Header) ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (p == MAP_FAILED) return;
+
+    const Header* h = (const Header*)p;
+    bool ok = std::memcmp(h->magic, MAGIC, 8) == 0 && h->version == SNAPSHOT_VERSION &&
+              h->tables == TABLES && h->fileSize == bytes;
+    for (std::size_t t = 0; ok && t < TABLES; t++) {
+        const TableDir& dir = h->dir[t];
+        ok = dir.indexOff % alignof(IndexEntry) == 0 && dir.indexOff <= bytes &&
+             dir.count <= (bytes - dir.indexOff) / sizeof(IndexEntry);
+    }
+    if (!ok) {
+        std::cout << "Catalog snapshot ignored (unreadable): " << snapshotPath << "\n";
+        munmap(p, bytes);
+        return;
+    }
+    base = (const std::uint8_t*)p;
+    mappedBytes = bytes;
+    for (std::size_t t = 0; t < TABLES; t++) counts[t] = (std::size_t)h->dir[t].count;
+}
+
+void Catalog::unmapSnapshot() {
+    if (base) munmap((void*)base, mappedBytes);
+    base = nullptr;
+    mappedBytes = 0;
+}
+
+void Catalog::replayWal() {
+    walFd = open(walPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (walFd < 0) {
+        std::cout << "Catalog log unavailable: " << walPath << "\n";
+        return;
+    }
+    std::vector<char> bytes;
+    readWholeFile(walPath, bytes);
+
+    std::size_t off = 0;
+    while (off + RECORD_HEAD <= bytes.size()) {
+        std::uint64_t sum;
+        std::uint32_t len;
+        std::memcpy(&sum, bytes.data() + off, 8);
+        std::memcpy(&len, bytes.data() + off + 8, 4);
+        if (len < PAYLOAD_HEAD || len > bytes.size() - off - RECORD_HEAD) break;
+        const char* p = bytes.data() + off + RECORD_HEAD;
+        if (fnv1a64(p, len) != sum) break;
+
+        std::uint8_t op = (std::uint8_t)p[0], table = (std::uint8_t)p[1];
+        std::uint32_t keyLen, valLen;
+        std::memcpy(&keyLen, p + 2, 4);
+        std::memcpy(&valLen, p + 6, 4);
+        if (table >= TABLES || (std::uint64_t)PAYLOAD_HEAD + keyLen + valLen != len) break;
+        std::string_view key(p + PAYLOAD_HEAD, keyLen);
+        if (op == OP_PUT) setLocked((CatalogTable)table, key, std::string_view(p + PAYLOAD_HEAD + keyLen, valLen));
+        else if (op == OP_ERASE) setLocked((CatalogTable)table, key, std::nullopt);
+        else break;
+        off += RECORD_HEAD + len;
+    }
+    // whatever follows the last good record is a torn append
+    if (off < bytes.size() && ftruncate(walFd, (off_t)off) != 0) off = bytes.size();
+    lseek(walFd, (off_t)off, SEEK_SET);
+    walBytes = off;
+    if (walBytes > WAL_CHECKPOINT_BYTES) checkpointLocked();
+}
+
+bool Catalog::appendWal(std::uint8_t op, CatalogTable t, std::string_view key, std::string_view value) {
+    if (walFd < 0) return false;
+    std::uint32_t keyLen = (std::uint32_t)key.size(), valLen = (std::uint32_t)value.size();
+    std::uint32_t len = (std::uint32_t)(PAYLOAD_HEAD + key.size() + value.size());
+
+    std::string rec(RECORD_HEAD + len, '\0');
+    char* p = rec.data() + RECORD_HEAD;
+    p[0] = (char)op;
+    p[1] = (char)t;
+    std::memcpy(p + 2, &keyLen, 4);
+    std::memcpy(p + 6, &valLen, 4);
+    std::memcpy(p + PAYLOAD_HEAD, key.data(), key.size());
+    if (!value.empty()) std::memcpy(p + PAYLOAD_HEAD + key.size(), value.data(), value.size());
+    std::uint64_t sum = fnv1a64(p, len);
+    std::memcpy(rec.data(), &sum, 8);
+    std::memcpy(rec.data() + 8, &len, 4);
+
+    if (!writeAll(walFd, rec.data(), rec.size())) {
+        // drop a partial record now rather than leave it for the next open
+        if (ftruncate(walFd, (off_t)walBytes) == 0) lseek(walFd, (off_t)walBytes, SEEK_SET);
+        return false;
+    }
+    walBytes += rec.size();
+    return true;
+}
+
+// snapshot layout: Header | per table: keys and values back to back, then its sorted IndexEntry array
+void Catalog::checkpointLocked() {
+    std::string tmp = snapshotPath + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    Header h {};
+    std::memcpy(h.magic, MAGIC, 8);
+    h.version = SNAPSHOT_VERSION;
+    h.tables = TABLES;
+
+    FileWriter out(fd);
+    out.put(&h, sizeof(h));
+    std::vector<std::pair<std::string_view, std::string_view>> live;
+    std::vector<IndexEntry> index;
+    for (std::size_t t = 0; t < TABLES; t++) {
+        live.clear();
+        live.reserve(counts[t]);
+        forEachLocked((CatalogTable)t, [&](std::string_view key, std::string_view value) {
+            live.emplace_back(key, value);
+        });
+        std::sort(live.begin(), live.end());
+
+        index.clear();
+        index.reserve(live.size());
+        for (auto& [key, value] : live) {
+            index.push_back(IndexEntry{out.offset, (std::uint32_t)key.size(), (std::uint32_t)value.size()});
+            out.put(key.data(), key.size());
+            out.put(value.data(), value.size());
+        }
+        static const char pad[alignof(IndexEntry)] = {};
+        out.put(pad, (alignof(IndexEntry) - out.offset % alignof(IndexEntry)) % alignof(IndexEntry));
+        h.dir[t] = TableDir{out.offset, (std::uint64_t)index.size()};
+        out.put(index.data(), index.size() * sizeof(IndexEntry));
+    }
+    out.drain();
+    h.fileSize = out.offset;
+    bool ok = out.ok && pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && syncToDisk(fd);
+    close(fd);
+
+    std::error_code ec;
+    if (ok) fs::rename(tmp, snapshotPath, ec);
+    if (!ok || ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    // make the rename itself durable before the log that backs it goes away
+    std::string dir = fs::path(snapshotPath).parent_path().string();
+    int dirFd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        syncToDisk(dirFd);
+        close(dirFd);
+    }
+
+    unmapSnapshot();
+    for (auto& ov : overlay) ov.clear();
+    mapSnapshot();
+    if (walFd >= 0 && ftruncate(walFd, 0) == 0) {
+        lseek(walFd, 0, SEEK_SET);
+        walBytes = 0;
+    }
+}
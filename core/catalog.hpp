@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// What the catalog holds; each table is an independent string -> bytes map.
+enum class CatalogTable : std::uint8_t { Settings, Favorites, Captions, Metadata };
+
+// All user state in one place: a memory-mapped snapshot (catalog.db) plus a write-ahead log
+// (catalog.wal). Opening maps the snapshot and replays the log, which is bounded by
+// WAL_CHECKPOINT_BYTES, so startup does not grow with the library. Lookups binary-search the
+// snapshot's sorted key index behind a small in-memory overlay of logged changes.
+//
+// Every put/erase is one checksummed append to the log. A checkpoint writes a new snapshot to
+// a temp file, fsyncs and renames it, then truncates the log; replaying a log that was already
+// folded in is harmless, so a crash at any point leaves either the old or the new state, and a
+// torn record at the end of the log is dropped on the next open. Safe to call from several threads.
+class Catalog {
+public:
+    static constexpr std::size_t WAL_CHECKPOINT_BYTES = 4u << 20;
+
+    Catalog(const std::string& snapshotPath, const std::string& walPath);
+    ~Catalog();
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    // true when neither file existed (first run, or first run after the text files)
+    bool fresh() const { return wasFresh; }
+
+    bool get(CatalogTable t, std::string_view key, std::string& value) const;
+    bool contains(CatalogTable t, std::string_view key) const;
+    std::size_t count(CatalogTable t) const;
+
+    // no log record is written when the value is already there
+    void put(CatalogTable t, std::string_view key, std::string_view value);
+    void erase(CatalogTable t, std::string_view key);
+
+    // every live record of the table, in no particular order; fn must not call back into the catalog
+    void forEach(CatalogTable t, const std::function<void(std::string_view key, std::string_view value)>& fn) const;
+
+    // folds the log into a new snapshot
+    void checkpoint();
+    // syncs the log to disk (F_FULLFSYNC on macOS); appends already survive a crash of the app itself
+    void flush();
+
+private:
+    static constexpr std::size_t TABLES = 4;
+    static constexpr const char* MAGIC = "MDBCAT01";
+
+    struct TableDir {
+        std::uint64_t indexOff;        // sorted IndexEntry array
+        std::uint64_t count;
+    };
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t tables;
+        std::uint64_t fileSize;
+        TableDir dir[TABLES];
+    };
+    struct IndexEntry {
+        std::uint64_t keyOff;          // the value follows the key
+        std::uint32_t keyLen;
+        std::uint32_t valLen;
+    };
+    // nullopt = erased since the snapshot
+    using Overlay = std::unordered_map<std::string, std::optional<std::string>>;
+
+    bool entryFits(const IndexEntry& e) const {
+        return e.keyOff <= mappedBytes && (std::uint64_t)e.keyLen + e.valLen <= mappedBytes - e.keyOff;
+    }
+    bool snapshotFind(CatalogTable t, std::string_view key, std::string_view& value) const;
+    bool findLocked(CatalogTable t, std::string_view key, std::string_view& value) const;
+    void setLocked(CatalogTable t, std::string_view key, std::optional<std::string_view> value);
+    void forEachLocked(CatalogTable t, const std::function<void(std::string_view key, std::string_view value)>& fn) const;
+
+    void mapSnapshot();
+    void unmapSnapshot();
+    void replayWal();
+    bool appendWal(std::uint8_t op, CatalogTable t, std::string_view key, std::string_view value);
+    void checkpointLocked();
+
+    std::string snapshotPath;
+    std::string walPath;
+    mutable std::mutex m;
+
+    const std::uint8_t* base = nullptr;
+    std::size_t mappedBytes = 0;
+    int walFd = -1;
+    std::uint64_t walBytes = 0;
+    bool wasFresh = false;
+
+    Overlay overlay[TABLES];
+    std::size_t counts[TABLES] = {};
+};
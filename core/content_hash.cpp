@@ -0,0 +1,135 @@
+#include "content_hash.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef MEDIADB_HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
+#ifndef MEDIADB_HAVE_XXHASH
+static constexpr std::uint64_t P1 = 11400714785074694791ull;
+static constexpr std::uint64_t P2 = 14029467366897019727ull;
+static constexpr std::uint64_t P3 = 1609587929392839161ull;
+static constexpr std::uint64_t P4 = 9650029242287828579ull;
+static constexpr std::uint64_t P5 = 2870177450012600261ull;
+
+static inline std::uint64_t rotl64(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline std::uint64_t read64(const std::uint8_t* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+static inline std::uint32_t read32(const std::uint8_t* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static inline std::uint64_t round64(std::uint64_t acc, std::uint64_t in) {
+    acc += in * P2;
+    acc = rotl64(acc, 31);
+    return acc * P1;
+}
+
+static inline std::uint64_t merge64(std::uint64_t acc, std::uint64_t v) {
+    acc ^= round64(0, v);
+    return acc * P1 + P4;
+}
+
+// XXH64 with seed 0 (little-endian hosts)
+static std::uint64_t xxh64(const std::uint8_t* p, std::size_t n) {
+    const std::uint8_t* end = p + n;
+    std::uint64_t h;
+    if (n >= 32) {
+        std::uint64_t v1 = P1 + P2, v2 = P2, v3 = 0, v4 = 0 - P1;
+        const std::uint8_t* limit = end - 32;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = merge64(h, v1);
+        h = merge64(h, v2);
+        h = merge64(h, v3);
+        h = merge64(h, v4);
+    } else {
+        h = P5;
+    }
+    h += (std::uint64_t)n;
+
+    for (; p + 8 <= end; p += 8) h = rotl64(h ^ round64(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end) {
+        h = rotl64(h ^ ((std::uint64_t)read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; p++) h = rotl64(h ^ (*p * P5), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+#endif
+
+std::uint64_t contentHash64(const void* data, std::size_t n) {
+#ifdef MEDIADB_HAVE_XXHASH
+    return XXH3_64bits(data, n);
+#else
+    return xxh64((const std::uint8_t*)data, n);
+#endif
+}
+
+const char* contentHashName() {
+#ifdef MEDIADB_HAVE_XXHASH
+    return "xxh3";
+#else
+    return "xxh64";
+#endif
+}
+
+// maps the file read-only; empty files give a null pointer and size 0
+static const void* mapFile(const std::string& path, std::size_t& size) {
+    size = 0;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return MAP_FAILED;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return MAP_FAILED;
+    }
+    size = (std::size_t)st.st_size;
+    void* p = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    close(fd);
+    return p;
+}
+
+bool hashFile(const std::string& path, std::uint64_t& hash, std::uint64_t* size) {
+    std::size_t n;
+    const void* p = mapFile(path, n);
+    if (p == MAP_FAILED) return false;
+    hash = contentHash64(p, n);
+    if (size) *size = n;
+    if (p) munmap((void*)p, n);
+    return true;
+}
+
+bool sameContent(const std::string& a, const std::string& b) {
+    std::size_t na, nb;
+    const void* pa = mapFile(a, na);
+    if (pa == MAP_FAILED) return false;
+    const void* pb = mapFile(b, nb);
+    bool same = pb != MAP_FAILED && na == nb && (na == 0 || std::memcmp(pa, pb, na) == 0);
+    if (pa) munmap((void*)pa, na);
+    if (pb && pb != MAP_FAILED) munmap((void*)pb, nb);
+    return same;
+}
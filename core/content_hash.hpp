@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit content hash for deduplication: XXH3 when libxxhash is available, otherwise the
+// built-in XXH64 (four independent lanes over 32-byte stripes, several GB/s per core).
+// The two give different values, so the hash index records which one it was built with.
+std::uint64_t contentHash64(const void* data, std::size_t n);
+const char* contentHashName();
+
+// hashes a whole file through mmap; false if it cannot be opened
+bool hashFile(const std::string& path, std::uint64_t& hash, std::uint64_t* size = nullptr);
+
+// byte-for-byte comparison, used before anything is deleted on the strength of a hash
+bool sameContent(const std::string& a, const std::string& b);
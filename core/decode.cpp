@@ -0,0 +1,175 @@
+#include "decode.hpp"
+#include "file_io.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#ifdef MEDIADB_HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+float fitFactor(sf::Vector2u size, sf::Vector2u t) {
+    if (t.x == 0 || size.x == 0 || size.y == 0) return 1.f;
+    return std::min((float)t.x / (float)size.x, (float)t.y / (float)size.y);
+}
+
+// one output row: each pixel averages a 2x2 block, one lane per channel
+static void halveRow(const std::uint8_t* __restrict r0, const std::uint8_t* __restrict r1,
+                     std::uint8_t* __restrict out, unsigned dw) {
+    for (unsigned x = 0; x < dw; x++) {
+        const std::uint8_t* a = r0 + (std::size_t)x * 8;
+        const std::uint8_t* b = r1 + (std::size_t)x * 8;
+        std::uint8_t* o = out + (std::size_t)x * 4;
+        o[0] = (std::uint8_t)((a[0] + a[4] + b[0] + b[4] + 2) >> 2);
+        o[1] = (std::uint8_t)((a[1] + a[5] + b[1] + b[5] + 2) >> 2);
+        o[2] = (std::uint8_t)((a[2] + a[6] + b[2] + b[6] + 2) >> 2);
+        o[3] = (std::uint8_t)((a[3] + a[7] + b[3] + b[7] + 2) >> 2);
+    }
+}
+
+void halveRgba(const std::uint8_t* src, unsigned w, unsigned h, std::vector<std::uint8_t>& dst) {
+    unsigned dw = w / 2, dh = h / 2;
+    dst.resize((std::size_t)dw * dh * 4);
+    for (unsigned y = 0; y < dh; y++) {
+        const std::uint8_t* r0 = src + (std::size_t)(2 * y) * w * 4;
+        halveRow(r0, r0 + (std::size_t)w * 4, dst.data() + (std::size_t)y * dw * 4, dw);
+    }
+}
+
+#ifdef MEDIADB_HAVE_LIBJPEG
+struct JpegErrorMgr {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+// DCT-domain scaling: libjpeg decodes straight to 1/2, 1/4 or 1/8 size
+static bool decodeJpegScaled(const char* data, std::size_t n, sf::Vector2u t, DecodedImage& out) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorMgr err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = [](j_common_ptr c) { std::longjmp(((JpegErrorMgr*)c->err)->jump, 1); };
+
+    std::vector<std::uint8_t> rgba, row;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (const unsigned char*)data, (unsigned long)n);
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    sf::Vector2u full(cinfo.image_width, cinfo.image_height);
+    float f = fitFactor(full, t);
+    unsigned denom = 1;
+    while (denom < 8 && 1.f / (float)(denom * 2) >= f) denom *= 2;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    unsigned w = cinfo.output_width, h = cinfo.output_height;
+    row.resize((std::size_t)w * 3);
+    rgba.resize((std::size_t)w * h * 4);
+    while (cinfo.output_scanline < h) {
+        std::uint8_t* dst = rgba.data() + (std::size_t)cinfo.output_scanline * w * 4;
+        JSAMPROW rp = row.data();
+        jpeg_read_scanlines(&cinfo, &rp, 1);
+        for (unsigned x = 0; x < w; x++) {
+            dst[x * 4 + 0] = row[x * 3 + 0];
+            dst[x * 4 + 1] = row[x * 3 + 1];
+            dst[x * 4 + 2] = row[x * 3 + 2];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    out.image.resize({w, h}, rgba.data());
+    out.fullSize = full;
+    out.target = denom == 1 ? sf::Vector2u(0, 0) : t;
+    return true;
+}
+#endif
+
+bool isJpegData(const char* data, std::size_t n) {
+    return n >= 3 && (unsigned char)data[0] == 0xFF && (unsigned char)data[1] == 0xD8 && (unsigned char)data[2] == 0xFF;
+}
+
+bool decodeForTarget(const char* data, std::size_t n, sf::Vector2u t, DecodedImage& out) {
+#ifdef MEDIADB_HAVE_LIBJPEG
+    if (t.x != 0 && isJpegData(data, n) && decodeJpegScaled(data, n, t, out)) return true;
+#endif
+    if (!out.image.loadFromMemory(data, n)) return false;
+    out.fullSize = out.image.getSize();
+    out.target = {0, 0};
+
+    float f = fitFactor(out.fullSize, t);
+    if (f > 0.5f) return true;
+
+    sf::Vector2u sz = out.fullSize;
+    auto canHalve = [&] {
+        return (float)(sz.x / 2) >= (float)out.fullSize.x * f && (float)(sz.y / 2) >= (float)out.fullSize.y * f;
+    };
+    if (!canHalve()) return true;
+    std::vector<std::uint8_t> a, b;
+    const std::uint8_t* src = out.image.getPixelsPtr();
+    while (canHalve()) {
+        halveRgba(src, sz.x, sz.y, a);
+        sz = {sz.x / 2, sz.y / 2};
+        std::swap(a, b);
+        src = b.data();
+    }
+    out.image.resize(sz, src);
+    out.target = t;
+    return true;
+}
+
+bool decodeFileForTarget(const std::string& path, sf::Vector2u t, DecodedImage& out) {
+    FileBytes bytes;
+    return bytes.open(path) && decodeForTarget(bytes.data(), bytes.size(), t, out);
+}
+
+void makeThumbnail(const sf::Image& src, std::uint8_t* dst, unsigned size) {
+    std::memset(dst, 0, (std::size_t)size * size * 4);
+    auto sz = src.getSize();
+    if (sz.x == 0 || sz.y == 0) return;
+
+    sf::IntRect r = thumbnailRect(sz, size);
+    unsigned w = (unsigned)r.size.x, h = (unsigned)r.size.y;
+    unsigned ox = (unsigned)r.position.x, oy = (unsigned)r.position.y;
+    const std::uint8_t* px = src.getPixelsPtr();
+
+    for (unsigned y = 0; y < h; y++) {
+        unsigned sy0 = (unsigned)((std::uint64_t)y * sz.y / h);
+        unsigned sy1 = std::max(sy0 + 1, (unsigned)((std::uint64_t)(y + 1) * sz.y / h));
+        for (unsigned x = 0; x < w; x++) {
+            unsigned sx0 = (unsigned)((std::uint64_t)x * sz.x / w);
+            unsigned sx1 = std::max(sx0 + 1, (unsigned)((std::uint64_t)(x + 1) * sz.x / w));
+            std::uint32_t acc[4] = {0, 0, 0, 0};
+            for (unsigned sy = sy0; sy < sy1; sy++) {
+                const std::uint8_t* row = px + ((std::size_t)sy * sz.x + sx0) * 4;
+                for (unsigned sx = sx0; sx < sx1; sx++, row += 4) {
+                    acc[0] += row[0]; acc[1] += row[1]; acc[2] += row[2]; acc[3] += row[3];
+                }
+            }
+            std::uint32_t cnt = (sy1 - sy0) * (sx1 - sx0);
+            std::uint8_t* out = dst + ((std::size_t)(oy + y) * size + ox + x) * 4;
+            for (int c = 0; c < 4; c++) out[c] = (std::uint8_t)(acc[c] / cnt);
+        }
+    }
+}
+
+sf::IntRect thumbnailRect(sf::Vector2u imageSize, unsigned size) {
+    if (imageSize.x == 0 || imageSize.y == 0) return {{0, 0}, {(int)size, (int)size}};
+    float scale = std::min(1.f, std::min((float)size / imageSize.x, (float)size / imageSize.y));
+    unsigned w = std::max(1u, (unsigned)(imageSize.x * scale));
+    unsigned h = std::max(1u, (unsigned)(imageSize.y * scale));
+    return {{(int)((size - w) / 2), (int)((size - h) / 2)}, {(int)w, (int)h}};
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Rect.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// an image decoded for display box `decodedFor` is good enough for box `wanted`;
+// {0,0} stands for full resolution on either side
+inline bool levelCovers(sf::Vector2u decodedFor, sf::Vector2u wanted) {
+    return decodedFor.x == 0 || (wanted.x != 0 && decodedFor.x >= wanted.x && decodedFor.y >= wanted.y);
+}
+
+// A decoded image plus the display box it was decoded for.
+struct DecodedImage {
+    sf::Image image;
+    sf::Vector2u fullSize;
+    sf::Vector2u target;
+
+    bool covers(sf::Vector2u t) const { return levelCovers(target, t); }
+};
+
+// fit factor of a w x h image into box t; >= 1 means no reduction is possible
+float fitFactor(sf::Vector2u size, sf::Vector2u t);
+
+// 2x2 box filter, one lane per channel through __restrict row pointers so -O3 vectorizes it;
+// src must not overlap dst
+void halveRgba(const std::uint8_t* src, unsigned w, unsigned h, std::vector<std::uint8_t>& dst);
+
+bool isJpegData(const char* data, std::size_t n);
+
+// Decodes to the smallest power-of-two reduction that still fills box t ({0,0} = full size).
+// JPEGs are reduced in the DCT domain when libjpeg is available; everything else is
+// decoded by SFML and then halved.
+bool decodeForTarget(const char* data, std::size_t n, sf::Vector2u t, DecodedImage& out);
+bool decodeFileForTarget(const std::string& path, sf::Vector2u t, DecodedImage& out);
+
+// Area-average downscale of src into a size x size RGBA square, centered, aspect preserved.
+void makeThumbnail(const sf::Image& src, std::uint8_t* dst, unsigned size);
+
+// the part of the size x size square that makeThumbnail fills for an image of imageSize
+sf::IntRect thumbnailRect(sf::Vector2u imageSize, unsigned size);
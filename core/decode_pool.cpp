@@ -0,0 +1,133 @@
+#include "decode_pool.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+DecodePool::DecodePool(unsigned threads) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this]{ workerLoop(); });
+}
+
+DecodePool::~DecodePool() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cvWork.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void DecodePool::setTarget(sf::Vector2u t) {
+    std::lock_guard<std::mutex> lk(m);
+    if (t == target) return;
+    target = t;
+    for (auto& [path, slot] : slots) {
+        if (slot.state == State::Ready && !slot.image->covers(target)) {
+            slot.state = State::Queued;
+            queue.push_back(path);
+        }
+    }
+    cvWork.notify_all();
+}
+
+void DecodePool::prefetch(const std::vector<std::string>& wanted) {
+    std::lock_guard<std::mutex> lk(m);
+    std::unordered_set<std::string> keep(wanted.begin(), wanted.end());
+
+    for (auto it = slots.begin(); it != slots.end(); ) {
+        if (!keep.count(it->first) && it->second.state != State::Decoding) it = slots.erase(it);
+        else ++it;
+    }
+    queue.clear();
+    for (auto& p : wanted) {
+        auto it = slots.find(p);
+        if (it == slots.end()) it = slots.emplace(p, Slot{}).first;
+        if (it->second.state == State::Queued) queue.push_back(p);
+    }
+    readAhead.request({queue.begin(), queue.end()});
+    cvWork.notify_all();
+}
+
+bool DecodePool::isReady(const std::string& path) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = slots.find(path);
+    return it != slots.end() && isDone(it->second);
+}
+
+void DecodePool::noteRequest(const std::string& path) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = slots.find(path);
+    bool ready = it != slots.end() && isDone(it->second);
+    if (ready) stats.hits++; else stats.misses++;
+    if (it == slots.end()) {
+        slots.emplace(path, Slot{});
+        queue.push_front(path);
+        cvWork.notify_one();
+    }
+}
+
+std::shared_ptr<const DecodedImage> DecodePool::acquire(const std::string& path) {
+    std::unique_lock<std::mutex> lk(m);
+    auto it = slots.find(path);
+    if (it != slots.end() && it->second.state == State::Ready && !isDone(it->second))
+        it->second.state = State::Queued;
+    if (it == slots.end()) {
+        slots.emplace(path, Slot{});
+        queue.push_front(path);
+        cvWork.notify_one();
+    } else if (it->second.state == State::Queued) {
+        queue.erase(std::remove(queue.begin(), queue.end(), path), queue.end());
+        queue.push_front(path);
+    }
+    cvDone.wait(lk, [&]{
+        auto s = slots.find(path);
+        return s == slots.end() || isDone(s->second);
+    });
+    auto s = slots.find(path);
+    return s == slots.end() || s->second.state == State::Failed ? nullptr : s->second.image;
+}
+
+void DecodePool::forget(const std::string& path) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = slots.find(path);
+    if (it != slots.end() && it->second.state != State::Decoding) slots.erase(it);
+    queue.erase(std::remove(queue.begin(), queue.end(), path), queue.end());
+}
+
+void DecodePool::workerLoop() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cvWork.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        std::string path = queue.front();
+        queue.pop_front();
+        auto it = slots.find(path);
+        if (it == slots.end() || it->second.state != State::Queued) continue;
+        it->second.state = State::Decoding;
+        sf::Vector2u t = target;
+
+        lk.unlock();
+        auto img = std::make_shared<DecodedImage>();
+        bool ok;
+        {
+            PROFILE_ZONE("decode");
+            ok = decodeFileForTarget(path, t, *img);
+        }
+        lk.lock();
+
+        auto s = slots.find(path);
+        if (s != slots.end()) {
+            s->second.state = ok ? State::Ready : State::Failed;
+            if (ok) s->second.image = std::move(img);
+            // the target grew while we were decoding
+            if (ok && !s->second.image->covers(target)) {
+                s->second.state = State::Queued;
+                queue.push_front(path);
+            }
+        }
+        cvDone.notify_all();
+    }
+}
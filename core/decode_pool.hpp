@@ -0,0 +1,80 @@
+#pragma once
+
+#include "decode.hpp"
+#include "file_io.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Decodes images on worker threads; the render thread only uploads to the GPU.
+// Only the paths passed to prefetch() are kept, so memory stays bounded by the window.
+// Every decode is sized for the current target box (see setTarget). The files of a prefetch
+// window are read ahead as one batch while the workers decode whatever is already in.
+class DecodePool {
+public:
+    struct Stats { std::uint64_t hits = 0, misses = 0; };
+
+    explicit DecodePool(unsigned threads);
+    ~DecodePool();
+
+    DecodePool(const DecodePool&) = delete;
+    DecodePool& operator=(const DecodePool&) = delete;
+
+    // display box to decode for; images decoded for a smaller box are decoded again
+    void setTarget(sf::Vector2u t);
+
+    // keep exactly these paths decoded (nearest first); everything else is dropped
+    void prefetch(const std::vector<std::string>& wanted);
+
+    bool isReady(const std::string& path);
+
+    // counts a hit if the image is already decoded at the moment the user asks for it
+    void noteRequest(const std::string& path);
+
+    // blocks until the image is decoded (moves it to the front of the queue if needed);
+    // returns nullptr if decoding failed
+    std::shared_ptr<const DecodedImage> acquire(const std::string& path);
+
+    void forget(const std::string& path);
+
+    // the render thread already had the image cached
+    void noteHit() {
+        std::lock_guard<std::mutex> lk(m);
+        stats.hits++;
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lk(m);
+        return stats;
+    }
+
+private:
+    enum class State { Queued, Decoding, Ready, Failed };
+    struct Slot {
+        State state = State::Queued;
+        std::shared_ptr<const DecodedImage> image;
+    };
+
+    bool isDone(const Slot& s) const {
+        return s.state == State::Failed || (s.state == State::Ready && s.image->covers(target));
+    }
+
+    void workerLoop();
+
+    std::mutex m;
+    std::condition_variable cvWork, cvDone;
+    std::unordered_map<std::string, Slot> slots;
+    std::deque<std::string> queue;
+    std::vector<std::thread> workers;
+    Stats stats;
+    sf::Vector2u target;
+    bool stopping = false;
+    ReadAhead readAhead{4};
+};
@@ -0,0 +1,47 @@
+#include "dedupe.hpp"
+#include "content_hash.hpp"
+#include "favorites.hpp"
+#include "hash_index.hpp"
+#include "library_index.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+
+DedupeReport dedupeLibrary(LibraryIndex& library, HashIndex& hashes, FavoritesSet& favorites, unsigned threads,
+                           bool apply) {
+    DedupeReport report;
+    library.reconcile();
+    hashes.sync(library.all(), threads);
+
+    for (auto& group : hashes.duplicateGroups()) {
+        auto keeper = *std::min_element(group.begin(), group.end(), [](const std::string& a, const std::string& b) {
+            std::string na = baseName(a), nb = baseName(b);
+            return na.size() != nb.size() ? na.size() < nb.size() : na < nb;
+        });
+        DedupeGroup done{keeper, {}};
+        for (auto& path : group) {
+            if (path == keeper || !sameContent(keeper, path)) continue;
+            std::error_code ec;
+            auto bytes = fs::file_size(path, ec);
+            if (ec) continue;
+            if (apply) {
+                if (!fs::remove(path, ec) || ec) continue;
+                if (favorites.contains(path)) {
+                    favorites.erase(path);
+                    if (!favorites.contains(keeper)) favorites.toggle(keeper);
+                }
+                library.remove(path);
+                hashes.remove(path);
+            }
+            done.copies.push_back(path);
+            report.removed++;
+            report.bytesFreed += bytes;
+        }
+        if (done.copies.empty()) continue;
+        report.groups++;
+        report.list.push_back(std::move(done));
+    }
+    library.flush();
+    hashes.flush();
+    return report;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class LibraryIndex;
+class HashIndex;
+class FavoritesSet;
+
+struct DedupeGroup {
+    std::string keeper;
+    std::vector<std::string> copies;   // byte-identical to the keeper
+};
+
+struct DedupeReport {
+    std::size_t groups = 0;
+    std::size_t removed = 0;           // or, without apply, would be
+    std::uint64_t bytesFreed = 0;
+    std::vector<DedupeGroup> list;
+};
+
+// Finds byte-identical library files. The keeper of each group is the shortest name (so
+// Era.png wins over Era_1.png); the others match it in a full byte compare. Only with `apply`
+// are they deleted, and a favorite mark on any of them moved to the keeper; otherwise the
+// report just lists what would go.
+DedupeReport dedupeLibrary(LibraryIndex& library, HashIndex& hashes, FavoritesSet& favorites, unsigned threads,
+                           bool apply);
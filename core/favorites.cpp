@@ -0,0 +1,70 @@
+#include "favorites.hpp"
+#include "catalog.hpp"
+#include "util.hpp"
+
+#include <unordered_map>
+
+bool FavoritesSet::contains(const std::string& path) const {
+    return catalog.contains(CatalogTable::Favorites, key(path));
+}
+
+std::size_t FavoritesSet::size() const {
+    return catalog.count(CatalogTable::Favorites);
+}
+
+void FavoritesSet::toggle(const std::string& path) {
+    std::string k = key(path);
+    if (catalog.contains(CatalogTable::Favorites, k)) catalog.erase(CatalogTable::Favorites, k);
+    else catalog.put(CatalogTable::Favorites, k, "");
+}
+
+void FavoritesSet::erase(const std::string& path) {
+    catalog.erase(CatalogTable::Favorites, key(path));
+}
+
+void FavoritesSet::forEach(const std::function<void(std::string_view)>& fn) const {
+    catalog.forEach(CatalogTable::Favorites, [&](std::string_view name, std::string_view) { fn(name); });
+}
+
+void FavoritesSet::upgradeNames(const std::vector<LibraryIndex::Entry>& library) {
+    const std::string DONE_KEY = "favoritesByPath";
+    std::string done;
+    if (catalog.get(CatalogTable::Settings, DONE_KEY, done)) return;
+
+    std::vector<std::string> names;
+    forEach([&](std::string_view k) {
+        if (k.find('/') == std::string_view::npos) names.emplace_back(k);
+    });
+    // file name -> the keys of the library files with that name
+    std::unordered_map<std::string, std::vector<std::string>> matches;
+    for (auto& n : names) matches[n];
+    for (auto& e : library) {
+        auto it = matches.find(baseName(e.path));
+        if (it != matches.end()) it->second.push_back(key(e.path));
+    }
+    for (auto& n : names) {
+        auto& keys = matches[n];
+        if (keys.size() != 1 || keys[0] == n) continue;
+        catalog.erase(CatalogTable::Favorites, n);
+        catalog.put(CatalogTable::Favorites, keys[0], "");
+    }
+    catalog.put(CatalogTable::Settings, DONE_KEY, "1");
+}
+
+void FavoritesSet::importFiles(const std::string& snapshotPath, const std::string& journalPath) {
+    for (auto& n : loadLines(snapshotPath)) catalog.put(CatalogTable::Favorites, n, "");
+    for (auto& line : loadLines(journalPath)) {
+        if (line.size() < 2) continue;
+        if (line[0] == '+') catalog.put(CatalogTable::Favorites, line.substr(1), "");
+        else if (line[0] == '-') catalog.erase(CatalogTable::Favorites, line.substr(1));
+    }
+}
+
+std::vector<std::string> filterFavorites(std::vector<std::string> paths, const FavoritesSet& favorites) {
+    std::vector<std::string> onlyFav;
+    onlyFav.reserve(favorites.size());
+    for (auto& p : paths) {
+        if (favorites.contains(p)) onlyFav.push_back(std::move(p));
+    }
+    return onlyFav;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "library_index.hpp"
+#include "util.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Catalog;
+
+// Favorite photos, kept in the catalog's Favorites table (key -> empty value). Callers pass
+// library paths; the key is the path below `root` (libraryKey). Lookups binary-search the
+// mapped snapshot; every toggle is one log append.
+class FavoritesSet {
+public:
+    FavoritesSet(Catalog& catalog, std::string root) : catalog(catalog), root(std::move(root)) {}
+
+    bool contains(const std::string& path) const;
+    std::size_t size() const;
+
+    void toggle(const std::string& path);
+    void erase(const std::string& path);
+
+    std::string key(const std::string& path) const { return libraryKey(root, path); }
+
+    // every favorite key, in no particular order; fn must not call back into the set
+    void forEach(const std::function<void(std::string_view key)>& fn) const;
+
+    // favorites saved before they were keyed by path are bare file names: once, each that is
+    // not a file at the top of the library but names exactly one file below it moves to that
+    // file's key
+    void upgradeNames(const std::vector<LibraryIndex::Entry>& library);
+
+    // the old favorites.txt snapshot and its "+name" / "-name" journal, read once into a fresh catalog
+    void importFiles(const std::string& snapshotPath, const std::string& journalPath);
+
+private:
+    Catalog& catalog;
+    std::string root;
+};
+
+// keeps the paths that are favorites, in order
+std::vector<std::string> filterFavorites(std::vector<std::string> paths, const FavoritesSet& favorites);
@@ -0,0 +1,151 @@
+#include "file_io.hpp"
+#include "profiler.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MEDIADB_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+// ---------- FileBytes ----------
+bool FileBytes::open(const std::string& path) {
+    reset();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            // decoders walk the file front to back; ask for all of it now
+            madvise(p, (std::size_t)st.st_size, MADV_WILLNEED);
+            map = p;
+            mapped = (std::size_t)st.st_size;
+        }
+    }
+    close(fd);
+    if (map) return true;
+    return readWholeFile(path, buf);
+}
+
+void FileBytes::reset() {
+    if (map) munmap(map, mapped);
+    map = nullptr;
+    mapped = 0;
+    buf.clear();
+}
+
+// ---------- ReadAhead ----------
+ReadAhead::ReadAhead(unsigned threads) {
+#ifdef MEDIADB_HAVE_LIBURING
+    threads = 1;                        // the ring does the fan-out
+#endif
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this]{ workerLoop(); });
+}
+
+ReadAhead::~ReadAhead() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void ReadAhead::request(const std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lk(m);
+    queue.clear();
+    for (auto& p : paths) {
+        if (!recent.count(p)) queue.push_back(p);
+    }
+    if (!queue.empty()) cv.notify_all();
+}
+
+void ReadAhead::workerLoop() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cv.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        // the ring takes everything pending at once; plain threads take one file each
+        std::vector<std::string> batch;
+#ifdef MEDIADB_HAVE_LIBURING
+        batch.assign(queue.begin(), queue.end());
+        queue.clear();
+#else
+        batch.push_back(queue.front());
+        queue.pop_front();
+#endif
+        for (auto& p : batch) {
+            if (!recent.insert(p).second) continue;
+            recentOrder.push_back(p);
+            if (recentOrder.size() > RECENT) {
+                recent.erase(recentOrder.front());
+                recentOrder.pop_front();
+            }
+        }
+
+        lk.unlock();
+        readBatch(batch);
+        lk.lock();
+    }
+}
+
+#ifdef MEDIADB_HAVE_LIBURING
+void ReadAhead::readBatch(const std::vector<std::string>& batch) {
+    PROFILE_ZONE("read ahead");
+    const std::size_t RING = 64;
+    io_uring ring;
+    if (batch.empty() || io_uring_queue_init((unsigned)std::min(batch.size(), RING), &ring, 0) < 0) return;
+
+    for (std::size_t start = 0; start < batch.size(); start += RING) {
+        std::vector<int> fds;
+        for (std::size_t i = start; i < std::min(batch.size(), start + RING); i++) {
+            int fd = ::open(batch[i].c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            struct stat st {};
+            io_uring_sqe* sqe = fstat(fd, &st) == 0 ? io_uring_get_sqe(&ring) : nullptr;
+            if (!sqe) {
+                close(fd);
+                continue;
+            }
+            io_uring_prep_fadvise(sqe, fd, 0, (off_t)st.st_size, POSIX_FADV_WILLNEED);
+            fds.push_back(fd);
+        }
+        io_uring_submit(&ring);
+        for (std::size_t i = 0; i < fds.size(); i++) {
+            io_uring_cqe* cqe;
+            if (io_uring_wait_cqe(&ring, &cqe) < 0) break;
+            io_uring_cqe_seen(&ring, cqe);
+        }
+        for (int fd : fds) close(fd);
+    }
+    io_uring_queue_exit(&ring);
+}
+#else
+void ReadAhead::readBatch(const std::vector<std::string>& batch) {
+    PROFILE_ZONE("read ahead");
+    for (auto& path : batch) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        struct stat st {};
+        // readahead(2) queues the whole file and returns; with several threads the open and
+        // stat round-trips of a network mount overlap as well
+        if (fstat(fd, &st) == 0) {
+#if defined(__linux__)
+            readahead(fd, 0, (std::size_t)st.st_size);
+#elif defined(__APPLE__)
+            radvisory ra{0, (int)std::min<off_t>(st.st_size, INT32_MAX)};
+            fcntl(fd, F_RDADVISE, &ra);
+#endif
+        }
+        close(fd);
+    }
+}
+#endif
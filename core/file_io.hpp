@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Read-only bytes of a whole file. Regular files are memory-mapped, so decoders read straight
+// out of the page cache with no copy; a file that cannot be mapped is read into a buffer.
+class FileBytes {
+public:
+    FileBytes() = default;
+    ~FileBytes() { reset(); }
+
+    FileBytes(const FileBytes&) = delete;
+    FileBytes& operator=(const FileBytes&) = delete;
+
+    bool open(const std::string& path);
+    void reset();
+
+    const char* data() const { return map ? (const char*)map : buf.data(); }
+    std::size_t size() const { return map ? mapped : buf.size(); }
+
+private:
+    void* map = nullptr;
+    std::size_t mapped = 0;
+    std::vector<char> buf;
+};
+
+// Starts reading files into the page cache ahead of the decoders, a whole batch at a time.
+// With liburing the batch goes out as one io_uring submission of WILLNEED advice; otherwise
+// a few threads pull it in with readahead(2), so slow (network) reads overlap instead of
+// running one after another. Nothing is returned: the decoder's FileBytes finds the pages.
+class ReadAhead {
+public:
+    explicit ReadAhead(unsigned threads);
+    ~ReadAhead();
+
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+
+    // replaces the pending batch; files started recently are skipped
+    void request(const std::vector<std::string>& paths);
+
+private:
+    static constexpr std::size_t RECENT = 256;
+
+    void workerLoop();
+    void readBatch(const std::vector<std::string>& batch);
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::string> queue;
+    std::deque<std::string> recentOrder;
+    std::unordered_set<std::string> recent;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
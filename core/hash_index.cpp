@@ -0,0 +1,194 @@
+#include "hash_index.hpp"
+#include "content_hash.hpp"
+#include "profiler.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <thread>
+
+HashIndex::HashIndex(const std::string& indexFile) : indexFile(indexFile) {
+    load();
+}
+
+void HashIndex::sync(const std::vector<LibraryIndex::Entry>& library, unsigned threads) {
+    std::vector<const LibraryIndex::Entry*> todo;
+    std::vector<std::string> unlisted;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        std::unordered_map<std::string, bool> present;
+        present.reserve(library.size());
+        for (auto& e : library) {
+            present.emplace(e.path, true);
+            auto it = byPath.find(e.path);
+            if (it == byPath.end() || it->second.size != e.size || it->second.mtime != e.mtime) todo.push_back(&e);
+        }
+        for (auto& [path, e] : byPath) {
+            if (!present.count(path)) unlisted.push_back(path);
+        }
+    }
+    // `library` may be a snapshot older than the index (an import job recorded files the
+    // listing only learns about in its callback), so an unlisted entry goes only with its file
+    std::vector<std::string> gone;
+    for (auto& p : unlisted) {
+        std::error_code ec;
+        if (!fs::exists(p, ec) && !ec) gone.push_back(p);
+    }
+    if (!gone.empty()) {
+        std::lock_guard<std::mutex> lk(m);
+        for (auto& p : gone) eraseLocked(p);
+        dirty = true;
+    }
+    if (todo.empty()) return;
+
+    if (threads == 0) threads = 1;
+    threads = (unsigned)std::min<std::size_t>(threads, todo.size());
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&]{
+            while (true) {
+                std::size_t i = next.fetch_add(1);
+                if (i >= todo.size()) return;
+                const auto& e = *todo[i];
+                std::uint64_t hash, size;
+                bool ok;
+                {
+                    PROFILE_ZONE("hash");
+                    ok = hashFile(e.path, hash, &size);
+                }
+                if (ok) record(e.path, hash, size, e.mtime);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+}
+
+std::string HashIndex::find(std::uint64_t hash, std::uint64_t size) {
+    std::lock_guard<std::mutex> lk(m);
+    return findLocked(hash, size);
+}
+
+std::string HashIndex::claim(std::uint64_t hash, std::uint64_t size, const std::string& path) {
+    std::lock_guard<std::mutex> lk(m);
+    std::string existing = findLocked(hash, size);
+    if (!existing.empty()) return existing;
+    eraseLocked(path);
+    byPath[path] = Entry{size, 0, hash};
+    byHash.emplace(hash, path);
+    dirty = true;
+    return "";
+}
+
+bool HashIndex::get(const std::string& path, std::uint64_t& hash, std::uint64_t& size, std::int64_t& mtime) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = byPath.find(path);
+    if (it == byPath.end()) return false;
+    hash = it->second.hash;
+    size = it->second.size;
+    mtime = it->second.mtime;
+    return true;
+}
+
+void HashIndex::record(const std::string& path, std::uint64_t hash, std::uint64_t size, std::int64_t mtime) {
+    std::lock_guard<std::mutex> lk(m);
+    eraseLocked(path);
+    byPath[path] = Entry{size, mtime, hash};
+    byHash.emplace(hash, path);
+    dirty = true;
+}
+
+void HashIndex::remove(const std::string& path) {
+    std::lock_guard<std::mutex> lk(m);
+    if (byPath.count(path)) dirty = true;
+    eraseLocked(path);
+}
+
+std::vector<std::vector<std::string>> HashIndex::duplicateGroups() {
+    std::lock_guard<std::mutex> lk(m);
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::vector<std::string>> groups;
+    for (auto& [path, e] : byPath) groups[{e.hash, e.size}].push_back(path);
+
+    std::vector<std::vector<std::string>> out;
+    for (auto& [key, paths] : groups) {
+        if (paths.size() < 2) continue;
+        std::sort(paths.begin(), paths.end());
+        out.push_back(std::move(paths));
+    }
+    return out;
+}
+
+void HashIndex::flush() {
+    std::lock_guard<std::mutex> lk(m);
+    if (dirty) save();
+}
+
+std::size_t HashIndex::size() {
+    std::lock_guard<std::mutex> lk(m);
+    return byPath.size();
+}
+
+std::string HashIndex::findLocked(std::uint64_t hash, std::uint64_t size) const {
+    auto range = byHash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto e = byPath.find(it->second);
+        if (e != byPath.end() && e->second.size == size) return it->second;
+    }
+    return "";
+}
+
+void HashIndex::eraseLocked(const std::string& path) {
+    auto it = byPath.find(path);
+    if (it == byPath.end()) return;
+    auto range = byHash.equal_range(it->second.hash);
+    for (auto h = range.first; h != range.second; ++h) {
+        if (h->second == path) {
+            byHash.erase(h);
+            break;
+        }
+    }
+    byPath.erase(it);
+}
+
+// first line: hash name; then size|mtime|hash|path. An index built with another hash
+// function is ignored and rebuilt by the next sync().
+void HashIndex::load() {
+    std::ifstream in(indexFile);
+    std::string line;
+    if (!std::getline(in, line) || line != contentHashName()) return;
+    while (std::getline(in, line)) {
+        auto a = line.find('|');
+        if (a == std::string::npos) continue;
+        auto b = line.find('|', a + 1);
+        if (b == std::string::npos) continue;
+        auto c = line.find('|', b + 1);
+        if (c == std::string::npos) continue;
+        Entry e;
+        try {
+            e.size  = std::stoull(line.substr(0, a));
+            e.mtime = std::stoll(line.substr(a + 1, b - a - 1));
+            e.hash  = std::stoull(line.substr(b + 1, c - b - 1));
+        } catch (...) {
+            continue;   // damaged line: the file is hashed again by the next sync()
+        }
+        std::string path = line.substr(c + 1);
+        byHash.emplace(e.hash, path);
+        byPath[path] = e;
+    }
+}
+
+// written to a temp file and renamed, so a crash never leaves a half-written index
+void HashIndex::save() {
+    std::string tmp = indexFile + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << contentHashName() << "\n";
+        for (auto& [path, e] : byPath)
+            out << e.size << "|" << e.mtime << "|" << e.hash << "|" << path << "\n";
+    }
+    std::error_code ec;
+    fs::rename(tmp, indexFile, ec);
+    dirty = false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "library_index.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Persistent content hashes of the library files (path -> size, mtime, hash) plus the
+// reverse map used to spot duplicates. A file is only re-hashed when its size or mtime
+// changes. Safe to call from several threads.
+class HashIndex {
+public:
+    explicit HashIndex(const std::string& indexFile);
+
+    // hashes whatever in `library` is new or changed (on `threads` workers) and drops
+    // entries for files that are gone; an entry `library` does not list is kept while its file
+    // exists, so a stale snapshot (taken when a job was submitted) never drops newer files
+    void sync(const std::vector<LibraryIndex::Entry>& library, unsigned threads);
+
+    // a library file with this hash and size, or "" if there is none
+    std::string find(std::uint64_t hash, std::uint64_t size);
+
+    // find(), and if nothing matches records `path` as the owner of the hash (used by the
+    // importer before the copy exists, so two identical sources in one batch collapse too)
+    std::string claim(std::uint64_t hash, std::uint64_t size, const std::string& path);
+
+    // the recorded hash of path and the size and mtime it was taken at; false if none
+    bool get(const std::string& path, std::uint64_t& hash, std::uint64_t& size, std::int64_t& mtime);
+
+    void record(const std::string& path, std::uint64_t hash, std::uint64_t size, std::int64_t mtime);
+    void remove(const std::string& path);
+
+    // groups of two or more paths with the same hash and size, each group sorted by path
+    std::vector<std::vector<std::string>> duplicateGroups();
+
+    void flush();
+    std::size_t size();
+
+private:
+    struct Entry {
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        std::uint64_t hash = 0;
+    };
+
+    std::string findLocked(std::uint64_t hash, std::uint64_t size) const;
+    void eraseLocked(const std::string& path);
+    void load();
+    void save();
+
+    std::mutex m;
+    std::string indexFile;
+    std::unordered_map<std::string, Entry> byPath;
+    std::unordered_multimap<std::uint64_t, std::string> byHash;
+    bool dirty = false;
+};
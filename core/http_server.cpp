@@ -0,0 +1,731 @@
+#include "http_server.hpp"
+#include "metadata.hpp"
+#include "profiler.hpp"
+#include "scanner.hpp"
+#include "thumb_store.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/event.h>
+#include <sys/uio.h>
+#else
+#include <poll.h>
+#endif
+
+namespace {
+
+constexpr std::size_t MAX_REQUEST_BYTES = 64 * 1024;
+constexpr int IDLE_TIMEOUT_S = 30;
+constexpr std::size_t MAX_LISTING = 10000;
+
+// a peer that went away must not kill the process with SIGPIPE; where send() has no flag for
+// that, accepted sockets get SO_NOSIGPIPE instead
+#if defined(MSG_NOSIGNAL)
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+#if defined(MSG_MORE)
+constexpr int SEND_MORE = MSG_MORE;   // the file follows the headers: do not push them alone
+#else
+constexpr int SEND_MORE = 0;
+#endif
+
+const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default:  return "Error";
+    }
+}
+
+const char* contentType(ImageFormat f) {
+    switch (f) {
+        case ImageFormat::Jpeg: return "image/jpeg";
+        case ImageFormat::Png:  return "image/png";
+        case ImageFormat::Gif:  return "image/gif";
+        case ImageFormat::Bmp:  return "image/bmp";
+        default: return "application/octet-stream";
+    }
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if (c < 0x20) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += (char)c;
+        }
+    }
+    return out + "\"";
+}
+
+bool urlDecode(const std::string& in, std::string& out) {
+    out.clear();
+    for (std::size_t i = 0; i < in.size(); i++) {
+        if (in[i] != '%') {
+            out += in[i];
+            continue;
+        }
+        if (i + 2 >= in.size() || !std::isxdigit((unsigned char)in[i + 1]) || !std::isxdigit((unsigned char)in[i + 2]))
+            return false;
+        out += (char)std::stoi(in.substr(i + 1, 2), nullptr, 16);
+        i += 2;
+    }
+    return out.find('\0') == std::string::npos;
+}
+
+std::size_t queryNumber(const std::string& query, const char* key, std::size_t fallback) {
+    std::string k = std::string(key) + "=";
+    std::size_t at = 0;
+    while (at < query.size()) {
+        std::size_t amp = query.find('&', at);
+        if (amp == std::string::npos) amp = query.size();
+        if (query.compare(at, k.size(), k) == 0) {
+            try {
+                return (std::size_t)std::stoull(query.substr(at + k.size(), amp - at - k.size()));
+            } catch (...) {
+                return fallback;
+            }
+        }
+        at = amp + 1;
+    }
+    return fallback;
+}
+
+// BITMAPFILEHEADER + BITMAPV4HEADER for the store's top-down RGBA slots; the channel masks
+// describe the bytes as they are, so the slot is sent unchanged after this header
+std::string thumbnailBmpHeader() {
+    const std::uint32_t side = ThumbStore::SIZE, pixels = (std::uint32_t)ThumbStore::SLOT_BYTES;
+    std::string h(14 + 108, '\0');
+    auto put16 = [&](std::size_t at, std::uint16_t v) { h[at] = (char)(v & 0xFF); h[at + 1] = (char)(v >> 8); };
+    auto put32 = [&](std::size_t at, std::uint32_t v) {
+        for (int i = 0; i < 4; i++) h[at + i] = (char)((v >> (8 * i)) & 0xFF);
+    };
+    h[0] = 'B';
+    h[1] = 'M';
+    put32(2, (std::uint32_t)h.size() + pixels);
+    put32(10, (std::uint32_t)h.size());
+    put32(14, 108);
+    put32(18, side);
+    put32(22, (std::uint32_t)-(std::int32_t)side);   // negative height: rows top to bottom
+    put16(26, 1);
+    put16(28, 32);
+    put32(30, 3);                                      // BI_BITFIELDS
+    put32(34, pixels);
+    put32(38, 2835);
+    put32(42, 2835);
+    put32(54, 0x000000FF);
+    put32(58, 0x0000FF00);
+    put32(62, 0x00FF0000);
+    put32(66, 0xFF000000);
+    put32(70, 0x73524742);                             // 'sRGB'
+    return h;
+}
+
+} // namespace
+
+struct HttpServer::Response {
+    int status = 200;
+    std::string type = "application/json";
+    std::string headers;   // extra header lines, each ending in \r\n
+    std::string body;
+    // optional file range sent after the body with sendfile
+    int fileFd = -1;
+    bool ownFile = false;
+    std::uint64_t fileOff = 0, fileLen = 0;
+
+    void error(int code, const char* message) {
+        status = code;
+        type = "application/json";
+        body = "{\"error\":" + jsonString(message) + "}";
+    }
+};
+
+HttpServer::HttpServer(const Options& opt, MetadataStore& metadata, ThumbStore* thumbs)
+    : opt(opt), metadata(metadata), thumbs(thumbs), current(std::make_shared<Listing>()) {
+    if (this->opt.threads == 0) this->opt.threads = 1;
+}
+
+HttpServer::~HttpServer() {
+    stop();
+}
+
+void HttpServer::publish(const std::string& root, const std::vector<LibraryIndex::Entry>& entries) {
+    auto l = std::make_shared<Listing>();
+    l->root = root;
+    l->entries = entries;
+    l->rel.reserve(entries.size());
+    l->byRel.reserve(entries.size());
+    std::string prefix = root + "/";
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        const std::string& p = entries[i].path;
+        l->rel.push_back(p.compare(0, prefix.size(), prefix) == 0 ? p.substr(prefix.size()) : p);
+        l->byRel.emplace(l->rel.back(), i);
+    }
+    std::lock_guard<std::mutex> lk(listingM);
+    current = std::move(l);
+}
+
+std::shared_ptr<const HttpServer::Listing> HttpServer::listing() const {
+    std::lock_guard<std::mutex> lk(listingM);
+    return current;
+}
+
+HttpServer::Stats HttpServer::stats() const {
+    return Stats{connections.load(), requests.load(), bytesSent.load()};
+}
+
+void HttpServer::handle(const std::string& method, const std::string& target, const std::string& ifNoneMatch,
+                        Response& r) {
+    PROFILE_ZONE("http request");
+    if (method != "GET" && method != "HEAD") return r.error(405, "only GET and HEAD");
+
+    auto q = target.find('?');
+    std::string path, query = q == std::string::npos ? "" : target.substr(q + 1);
+    if (!urlDecode(target.substr(0, q), path)) return r.error(400, "bad path");
+    auto L = listing();
+
+    if (path == "/api/photos") {
+        std::size_t offset = std::min(queryNumber(query, "offset", 0), L->entries.size());
+        std::size_t limit = std::min(queryNumber(query, "limit", 100), MAX_LISTING);
+        std::size_t end = std::min(L->entries.size(), offset + limit);
+        r.body = "{\"total\":" + std::to_string(L->entries.size()) + ",\"offset\":" + std::to_string(offset) + ",\"photos\":[";
+        for (std::size_t i = offset; i < end; i++) {
+            const auto& e = L->entries[i];
+            if (i > offset) r.body += ',';
+            r.body += "{\"path\":" + jsonString(L->rel[i]) + ",\"size\":" + std::to_string(e.size) +
+                      ",\"mtime\":" + std::to_string(e.mtime) + "}";
+        }
+        r.body += "]}";
+        return;
+    }
+
+    auto lookup = [&](std::size_t skip) -> const LibraryIndex::Entry* {
+        auto it = L->byRel.find(path.substr(skip));
+        return it == L->byRel.end() ? nullptr : &L->entries[it->second];
+    };
+
+    if (path.compare(0, 10, "/api/meta/") == 0) {
+        const auto* e = lookup(10);
+        if (!e) return r.error(404, "not in the library");
+        ImageMeta meta;
+        bool known = metadata.get(e->path, meta);
+        r.body = "{\"path\":" + jsonString(path.substr(10)) + ",\"size\":" + std::to_string(e->size) +
+                 ",\"mtime\":" + std::to_string(e->mtime);
+        if (known) {
+            r.body += ",\"width\":" + std::to_string(meta.width) + ",\"height\":" + std::to_string(meta.height) +
+                      ",\"captureDate\":" + jsonString(meta.captureDate) + ",\"camera\":" + jsonString(meta.camera) +
+                      ",\"orientation\":" + std::to_string(meta.orientation);
+        } else {
+            r.body += ",\"pending\":true";
+        }
+        r.body += "}";
+        return;
+    }
+
+    if (path.compare(0, 7, "/thumb/") == 0) {
+        const auto* e = lookup(7);
+        if (!e || !thumbs) return r.error(404, "not in the library");
+        std::uint64_t off;
+        if (!thumbs->locate(e->path, e->mtime, off)) {
+            thumbs->enqueue(*e);
+            r.headers = "Retry-After: 1\r\n";
+            return r.error(503, "thumbnail is being generated");
+        }
+        static const std::string bmp = thumbnailBmpHeader();
+        r.type = "image/bmp";
+        r.headers = "Cache-Control: max-age=60\r\n";
+        r.body = bmp;
+        r.fileFd = thumbs->dataFd();
+        r.fileOff = off;
+        r.fileLen = ThumbStore::SLOT_BYTES;
+        return;
+    }
+
+    if (path.compare(0, 7, "/image/") == 0) {
+        const auto* e = lookup(7);
+        if (!e) return r.error(404, "not in the library");
+        int fd = ::open(e->path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st {};
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) close(fd);
+            return r.error(404, "file is gone");
+        }
+        std::string etag = "\"" + std::to_string(st.st_size) + "-" + std::to_string(st.st_mtime) + "\"";
+        r.headers = "ETag: " + etag + "\r\n";
+        if (ifNoneMatch == etag) {
+            close(fd);
+            r.status = 304;
+            return;
+        }
+        unsigned char head[32];
+        ssize_t n = pread(fd, head, sizeof(head), 0);
+        r.type = contentType(n > 0 ? sniffImageFormat(head, (std::size_t)n) : ImageFormat::Unknown);
+        r.fileFd = fd;
+        r.ownFile = true;
+        r.fileLen = (std::uint64_t)st.st_size;
+        return;
+    }
+
+    r.error(404, "no such endpoint");
+}
+
+namespace {
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+// Up to `left` bytes of file from `off` into the socket; advances off. Like send(): -1 with
+// errno (EAGAIN when the socket is full), 0 when the file has nothing more at off.
+ssize_t sendFileChunk(int sock, int file, off_t& off, std::uint64_t left) {
+#if defined(__linux__)
+    return sendfile(sock, file, &off, (std::size_t)std::min<std::uint64_t>(left, 1u << 30));
+#elif defined(__APPLE__)
+    // len is in/out: what was sent counts even when the call stops early with EAGAIN
+    off_t len = (off_t)std::min<std::uint64_t>(left, 1u << 30);
+    int rc = sendfile(file, sock, off, &len, nullptr, 0);
+    if (len > 0) {
+        off += len;
+        return (ssize_t)len;
+    }
+    return rc < 0 ? -1 : 0;
+#else
+    // no zero-copy path: a bounce buffer, re-read from off if the socket takes only part of it
+    char buf[64 * 1024];
+    ssize_t n = pread(file, buf, (std::size_t)std::min<std::uint64_t>(left, sizeof(buf)), off);
+    if (n <= 0) return n;
+    ssize_t w = send(sock, buf, (std::size_t)n, SEND_FLAGS);
+    if (w > 0) off += w;
+    return w;
+#endif
+}
+
+// Readiness of one event loop's sockets: epoll on Linux, kqueue on macOS and FreeBSD, poll()
+// anywhere else. Level-triggered everywhere, and reading is always watched.
+class Poller {
+public:
+    struct Event {
+        int fd;
+        bool in, out, err;
+    };
+
+#if defined(__linux__)
+    Poller() : ep(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~Poller() { close(ep); }
+
+    void add(int fd) { ctl(fd, EPOLLIN, EPOLL_CTL_ADD); }
+    void setWrite(int fd, bool on) { ctl(fd, on ? EPOLLIN | EPOLLOUT : EPOLLIN, EPOLL_CTL_MOD); }
+    void remove(int) {}   // closing the descriptor takes it out of the set
+
+    int wait(Event* out, int max, int timeoutMs) {
+        epoll_event evs[256];
+        int n = epoll_wait(ep, evs, std::min(max, 256), timeoutMs);
+        for (int i = 0; i < n; i++) {
+            std::uint32_t e = evs[i].events;
+            out[i] = Event{evs[i].data.fd, (e & (EPOLLIN | EPOLLHUP)) != 0, (e & EPOLLOUT) != 0, (e & EPOLLERR) != 0};
+        }
+        return std::max(n, 0);
+    }
+
+private:
+    void ctl(int fd, std::uint32_t events, int op) {
+        epoll_event ev {};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(ep, op, fd, &ev);
+    }
+    int ep;
+
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+    Poller() : kq(kqueue()) {}
+    ~Poller() { close(kq); }
+
+    void add(int fd) { change(fd, EVFILT_READ, EV_ADD); }
+    void setWrite(int fd, bool on) { change(fd, EVFILT_WRITE, on ? EV_ADD : EV_DELETE); }
+    void remove(int) {}   // closing the descriptor drops its filters
+
+    // one kevent per filter, so a socket both readable and writable comes back twice
+    int wait(Event* out, int max, int timeoutMs) {
+        struct kevent evs[256];
+        timespec ts {timeoutMs / 1000, (long)(timeoutMs % 1000) * 1000000L};
+        int n = kevent(kq, nullptr, 0, evs, std::min(max, 256), &ts);
+        for (int i = 0; i < n; i++) {
+            bool err = (evs[i].flags & EV_ERROR) != 0;
+            out[i] = Event{(int)evs[i].ident, !err && evs[i].filter == EVFILT_READ,
+                           !err && evs[i].filter == EVFILT_WRITE, err};
+        }
+        return std::max(n, 0);
+    }
+
+private:
+    void change(int fd, short filter, unsigned short flags) {
+        struct kevent ev;
+        EV_SET(&ev, (uintptr_t)fd, filter, flags, 0, 0, nullptr);
+        kevent(kq, &ev, 1, nullptr, 0, nullptr);
+    }
+    int kq;
+
+#else
+    void add(int fd) {
+        at[fd] = fds.size();
+        fds.push_back(pollfd{fd, POLLIN, 0});
+    }
+    void setWrite(int fd, bool on) { fds[at[fd]].events = on ? POLLIN | POLLOUT : POLLIN; }
+    void remove(int fd) {
+        auto it = at.find(fd);
+        if (it == at.end()) return;
+        fds[it->second] = fds.back();
+        at[fds.back().fd] = it->second;
+        fds.pop_back();
+        at.erase(fd);
+    }
+
+    int wait(Event* out, int max, int timeoutMs) {
+        if (::poll(fds.data(), (nfds_t)fds.size(), timeoutMs) <= 0) return 0;
+        int n = 0;
+        for (auto& p : fds) {
+            if (!p.revents || n == max) continue;
+            out[n++] = Event{p.fd, (p.revents & (POLLIN | POLLHUP)) != 0, (p.revents & POLLOUT) != 0,
+                             (p.revents & (POLLERR | POLLNVAL)) != 0};
+        }
+        return n;
+    }
+
+private:
+    std::vector<pollfd> fds;
+    std::unordered_map<int, std::size_t> at;
+#endif
+};
+
+} // namespace
+
+// One keep-alive connection. Requests are answered one at a time: the next one (pipelined
+// bytes stay in `in`) is parsed only once the current response has gone out.
+struct HttpServer::Conn {
+    int fd = -1;
+    std::string in;
+    std::string out;
+    std::size_t outSent = 0;
+    int fileFd = -1;
+    bool ownFile = false;
+    off_t fileOff = 0;
+    std::uint64_t fileLeft = 0;
+    bool closeAfter = false;
+    bool wantWrite = false, watchingWrite = false;
+    std::chrono::steady_clock::time_point lastActive;
+
+    bool idle() const { return outSent == out.size() && fileLeft == 0; }
+
+    void closeFile() {
+        if (ownFile && fileFd >= 0) close(fileFd);
+        fileFd = -1;
+        ownFile = false;
+        fileLeft = 0;
+    }
+
+    // false: the peer closed or the socket failed
+    bool readIn() {
+        char buf[16384];
+        while (in.size() <= MAX_REQUEST_BYTES) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                in.append(buf, (std::size_t)n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        return true;
+    }
+
+    void begin(Response& r, bool headOnly, bool keepAlive) {
+        std::uint64_t length = r.body.size() + r.fileLen;
+        out = "HTTP/1.1 " + std::to_string(r.status) + " " + statusText(r.status) + "\r\n";
+        if (r.status != 304) {
+            out += "Content-Type: " + r.type + "\r\nContent-Length: " + std::to_string(length) + "\r\n";
+        }
+        out += r.headers;
+        out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        outSent = 0;
+        closeAfter = !keepAlive;
+        if (headOnly || r.status == 304) {
+            if (r.ownFile && r.fileFd >= 0) close(r.fileFd);
+            return;
+        }
+        out += r.body;
+        fileFd = r.fileFd;
+        ownFile = r.ownFile;
+        fileOff = (off_t)r.fileOff;
+        fileLeft = r.fileLen;
+    }
+
+    // sends as much as the socket takes; false on a hard error
+    bool flush(std::atomic<std::uint64_t>& sent) {
+        wantWrite = false;
+        while (outSent < out.size()) {
+            ssize_t n = send(fd, out.data() + outSent, out.size() - outSent, SEND_FLAGS | (fileLeft ? SEND_MORE : 0));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                wantWrite = true;
+                return true;
+            }
+            outSent += (std::size_t)n;
+            sent += (std::uint64_t)n;
+        }
+        out.clear();
+        outSent = 0;
+        while (fileLeft > 0) {
+            ssize_t n = sendFileChunk(fd, fileFd, fileOff, fileLeft);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                wantWrite = true;
+                return true;
+            }
+            if (n == 0) return false;   // the file shrank under us
+            fileLeft -= (std::uint64_t)n;
+            sent += (std::uint64_t)n;
+        }
+        closeFile();
+        return true;
+    }
+};
+
+bool HttpServer::start() {
+    in_addr ip {};
+    if (inet_pton(AF_INET, opt.address.c_str(), &ip) != 1) {
+        std::cout << "HTTP server: not an IPv4 address: " << opt.address << "\n";
+        return false;
+    }
+#if !defined(SO_NOSIGPIPE)
+    // sendfile(2) takes no MSG_NOSIGNAL: a client leaving mid-body would raise SIGPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    if (pipe(stopFds) != 0) {
+        std::cout << "HTTP server: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    setNonBlocking(stopFds[0]);
+    setNonBlocking(stopFds[1]);
+    // Linux spreads connections over SO_REUSEPORT sockets bound to the same port; elsewhere
+    // that option does not balance, so every loop waits on the one socket instead
+#if defined(__linux__)
+    unsigned sockets = opt.threads;
+#else
+    unsigned sockets = 1;
+#endif
+    for (unsigned i = 0; i < sockets; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((std::uint16_t)opt.port);
+        addr.sin_addr = ip;
+        if (fd < 0 || !setNonBlocking(fd) || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            (sockets > 1 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) ||
+            bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+            std::cout << "HTTP server: cannot listen on " << opt.address << ":" << opt.port << ": "
+                      << std::strerror(errno) << "\n";
+            if (fd >= 0) close(fd);
+            stop();
+            return false;
+        }
+        listenFds.push_back(fd);
+    }
+    for (unsigned i = 0; i < opt.threads; i++) {
+        int fd = listenFds[i % listenFds.size()];
+        loops.emplace_back([this, fd]{ loop(fd); });
+    }
+    return true;
+}
+
+void HttpServer::stop() {
+    if (stopFds[1] >= 0) {
+        char one = 1;
+        (void)!write(stopFds[1], &one, 1);
+    }
+    for (auto& t : loops) t.join();
+    loops.clear();
+    for (int fd : listenFds) close(fd);
+    listenFds.clear();
+    for (int& fd : stopFds) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+}
+
+void HttpServer::loop(int listenFd) {
+    Poller poller;
+    poller.add(listenFd);
+    poller.add(stopFds[0]);   // never read, so it wakes every loop
+
+    std::unordered_map<int, Conn> conns;
+    auto drop = [&](int fd) {
+        conns[fd].closeFile();
+        poller.remove(fd);
+        close(fd);
+        conns.erase(fd);
+    };
+
+    // answers every complete request in `in` for as long as the socket keeps taking the output
+    auto serve = [&](Conn& c) -> bool {
+        while (c.idle()) {
+            if (c.closeAfter) return false;
+            auto end = c.in.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                if (c.in.size() <= MAX_REQUEST_BYTES) return true;
+                Response r;
+                r.error(431, "request too large");
+                c.begin(r, false, false);
+                return c.flush(bytesSent);
+            }
+            std::string head = c.in.substr(0, end);
+            c.in.erase(0, end + 4);
+
+            auto lineEnd = head.find("\r\n");
+            std::string requestLine = head.substr(0, lineEnd);
+            auto sp1 = requestLine.find(' '), sp2 = requestLine.rfind(' ');
+            Response r;
+            bool keepAlive = false, headOnly = false;
+            if (sp1 == std::string::npos || sp2 == sp1) {
+                r.error(400, "bad request line");
+            } else {
+                std::string method = requestLine.substr(0, sp1);
+                std::string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+                std::string version = requestLine.substr(sp2 + 1);
+                std::string connection, ifNoneMatch;
+                bool body = false;
+                std::size_t at = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+                while (at < head.size()) {
+                    auto next = head.find("\r\n", at);
+                    if (next == std::string::npos) next = head.size();
+                    auto colon = head.find(':', at);
+                    if (colon != std::string::npos && colon < next) {
+                        std::string name = toLower(head.substr(at, colon - at));
+                        std::string value = trim(head.substr(colon + 1, next - colon - 1));
+                        if (name == "connection") connection = toLower(value);
+                        if (name == "if-none-match") ifNoneMatch = value;
+                        if ((name == "content-length" && value != "0") || name == "transfer-encoding") body = true;
+                    }
+                    at = next + 2;
+                }
+                keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+                headOnly = method == "HEAD";
+                // nothing here takes a request body; rather than skip one, end the connection
+                if (body) {
+                    r.error(400, "request bodies are not accepted");
+                    keepAlive = false;
+                } else {
+                    handle(method, target, ifNoneMatch, r);
+                }
+            }
+            requests++;
+            c.begin(r, headOnly, keepAlive);
+            if (!c.flush(bytesSent)) return false;
+        }
+        return true;
+    };
+
+    Poller::Event events[256];
+    auto lastSweep = std::chrono::steady_clock::now();
+    bool running = true;
+    while (running) {
+        int n = poller.wait(events, 256, 1000);
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].fd;
+            if (fd == stopFds[0]) {
+                running = false;
+                break;
+            }
+            if (fd == listenFd) {
+                while (true) {
+#if defined(__linux__)
+                    int cfd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+                    int cfd = accept(listenFd, nullptr, nullptr);
+#endif
+                    if (cfd < 0) {
+                        if (errno == EINTR) continue;
+                        break;   // EAGAIN (another loop may have taken it), or out of descriptors
+                    }
+                    int one = 1;
+#if !defined(__linux__)
+                    setNonBlocking(cfd);
+#endif
+#if defined(SO_NOSIGPIPE)
+                    setsockopt(cfd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+                    setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    Conn& c = conns[cfd];
+                    c.fd = cfd;
+                    c.lastActive = now;
+                    poller.add(cfd);
+                    connections++;
+                }
+                continue;
+            }
+
+            auto it = conns.find(fd);
+            if (it == conns.end()) continue;
+            Conn& c = it->second;
+            c.lastActive = now;
+            bool alive = !events[i].err;
+            if (alive && events[i].out) alive = c.flush(bytesSent);
+            if (alive && events[i].in) alive = c.readIn() || !c.in.empty();
+            if (alive) alive = serve(c);
+            if (!alive) {
+                drop(fd);
+                continue;
+            }
+            if (c.wantWrite != c.watchingWrite) {
+                poller.setWrite(fd, c.wantWrite);
+                c.watchingWrite = c.wantWrite;
+            }
+        }
+
+        if (now - lastSweep >= std::chrono::seconds(1)) {
+            lastSweep = now;
+            std::vector<int> idle;
+            for (auto& [fd, c] : conns) {
+                if (now - c.lastActive >= std::chrono::seconds(IDLE_TIMEOUT_S)) idle.push_back(fd);
+            }
+            for (int fd : idle) drop(fd);
+        }
+    }
+
+    std::vector<int> all;
+    for (auto& [fd, c] : conns) all.push_back(fd);
+    for (int fd : all) drop(fd);
+}
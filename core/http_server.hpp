@@ -0,0 +1,83 @@
+#pragma once
+
+#include "library_index.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class MetadataStore;
+class ThumbStore;
+
+// Read-only HTTP/1.1 access to the library for other local tools:
+//   GET /api/photos?offset=N&limit=M   listing as JSON (paths relative to the library)
+//   GET /api/meta/<path>               header metadata as JSON
+//   GET /thumb/<path>                  the grid thumbnail as a 32-bit BMP
+//   GET /image/<path>                  the file itself (ETag / If-None-Match honoured)
+// Only paths in the published listing resolve, so nothing outside the library is reachable.
+//
+// `threads` event loops (epoll on Linux, kqueue on macOS and FreeBSD, poll() elsewhere) serve
+// non-blocking keep-alive sockets. On Linux each loop has its own SO_REUSEPORT listening
+// socket, so the kernel spreads connections across them; elsewhere they share one. Image
+// bodies go out with sendfile(2) (Linux and macOS; a read/send loop elsewhere), and thumbnails
+// straight from the thumbnail store's data file (the pages its mmap writes).
+class HttpServer {
+public:
+    struct Options {
+        std::string address = "127.0.0.1";
+        int port = 8080;
+        unsigned threads = 1;
+    };
+
+    struct Stats {
+        std::uint64_t connections = 0, requests = 0, bytesSent = 0;
+    };
+
+    // thumbs may be null (no /thumb)
+    HttpServer(const Options& opt, MetadataStore& metadata, ThumbStore* thumbs);
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // binds and starts the loops; false (with a message) if that fails
+    bool start();
+    void stop();
+
+    // replaces the listing being served; call again whenever the library changes
+    void publish(const std::string& root, const std::vector<LibraryIndex::Entry>& entries);
+
+    Stats stats() const;
+
+private:
+    struct Listing {
+        std::string root;
+        std::vector<LibraryIndex::Entry> entries;   // sorted by path
+        std::vector<std::string> rel;               // path below root, same order
+        std::unordered_map<std::string, std::size_t> byRel;
+    };
+    struct Conn;
+    struct Response;
+
+    void loop(int listenFd);
+    std::shared_ptr<const Listing> listing() const;
+    void handle(const std::string& method, const std::string& target, const std::string& ifNoneMatch, Response& r);
+
+    Options opt;
+    MetadataStore& metadata;
+    ThumbStore* thumbs;
+
+    mutable std::mutex listingM;
+    std::shared_ptr<const Listing> current;
+
+    int stopFds[2] = {-1, -1};   // pipe; one byte written wakes every loop
+    std::vector<int> listenFds;
+    std::vector<std::thread> loops;
+    std::atomic<std::uint64_t> connections{0}, requests{0}, bytesSent{0};
+};
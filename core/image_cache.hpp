@@ -0,0 +1,136 @@
+#pragma once
+
+#include "decode.hpp"
+#include "util.hpp"
+
+#include <SFML/Graphics/Texture.hpp>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// One LRU tier keyed by path; an entry is only valid for the mtime it was stored with (the
+// listing's, see LibraryIndex::Entry, so a lookup never touches the disk).
+template <class T>
+class LruTier {
+public:
+    explicit LruTier(std::uint64_t budgetBytes) : budget(budgetBytes) {}
+
+    std::shared_ptr<T> get(const std::string& path, std::int64_t mtime) {
+        auto it = entries.find(path);
+        if (it == entries.end()) return nullptr;
+        if (it->second.mtime != mtime) {
+            erase(path);
+            return nullptr;
+        }
+        order.splice(order.begin(), order, it->second.pos);
+        return it->second.value;
+    }
+
+    // like get() but without touching the LRU order
+    std::shared_ptr<T> peek(const std::string& path, std::int64_t mtime) const {
+        auto it = entries.find(path);
+        return it != entries.end() && it->second.mtime == mtime ? it->second.value : nullptr;
+    }
+
+    void put(const std::string& path, std::int64_t mtime, std::shared_ptr<T> value, std::uint64_t bytes) {
+        erase(path);
+        order.push_front(path);
+        entries[path] = Entry{mtime, std::move(value), bytes, order.begin()};
+        used += bytes;
+        evict();
+    }
+
+    void erase(const std::string& path) {
+        auto it = entries.find(path);
+        if (it == entries.end()) return;
+        used -= it->second.bytes;
+        order.erase(it->second.pos);
+        entries.erase(it);
+    }
+
+    void setBudget(std::uint64_t bytes) { budget = bytes; evict(); }
+    std::uint64_t usedBytes() const { return used; }
+    std::size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        std::int64_t mtime;
+        std::shared_ptr<T> value;
+        std::uint64_t bytes = 0;
+        std::list<std::string>::iterator pos;
+    };
+
+    // the most recent entry always stays, even if it alone exceeds the budget
+    void evict() {
+        while (used > budget && entries.size() > 1) erase(order.back());
+    }
+
+    std::uint64_t budget;
+    std::uint64_t used = 0;
+    std::list<std::string> order;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+// An uploaded texture plus the decode level it came from.
+struct ViewTexture {
+    sf::Texture tex;
+    sf::Vector2u fullSize;
+    sf::Vector2u target;
+
+    bool covers(sf::Vector2u t) const { return levelCovers(target, t); }
+};
+
+// Decoded images (RAM) and uploaded textures (VRAM), each with its own byte budget.
+// Lookups take the display box the caller needs; a smaller cached level counts as a miss.
+// Used from the render thread only.
+class ImageCache {
+public:
+    ImageCache(std::uint64_t ramBytes, std::uint64_t vramBytes) : ram(ramBytes), vram(vramBytes) {}
+
+    std::shared_ptr<const DecodedImage> image(const std::string& path, std::int64_t mtime, sf::Vector2u t) {
+        auto v = ram.get(path, mtime);
+        return v && v->covers(t) ? v : nullptr;
+    }
+
+    std::shared_ptr<ViewTexture> texture(const std::string& path, std::int64_t mtime, sf::Vector2u t) {
+        auto v = vram.get(path, mtime);
+        return v && v->covers(t) ? v : nullptr;
+    }
+
+    bool has(const std::string& path, std::int64_t mtime, sf::Vector2u t) const {
+        auto tx = vram.peek(path, mtime);
+        if (tx && tx->covers(t)) return true;
+        auto im = ram.peek(path, mtime);
+        return im && im->covers(t);
+    }
+
+    void putImage(const std::string& path, std::int64_t mtime, std::shared_ptr<const DecodedImage> img) {
+        auto sz = img->image.getSize();
+        ram.put(path, mtime, std::move(img), (std::uint64_t)sz.x * sz.y * 4);
+    }
+
+    void putTexture(const std::string& path, std::int64_t mtime, std::shared_ptr<ViewTexture> t) {
+        auto sz = t->tex.getSize();
+        vram.put(path, mtime, std::move(t), (std::uint64_t)sz.x * sz.y * 4);
+    }
+
+    void erase(const std::string& path) {
+        ram.erase(path);
+        vram.erase(path);
+    }
+
+    void setBudgets(std::uint64_t ramBytes, std::uint64_t vramBytes) {
+        ram.setBudget(ramBytes);
+        vram.setBudget(vramBytes);
+    }
+
+    std::uint64_t ramBytes() const { return ram.usedBytes(); }
+    std::uint64_t vramBytes() const { return vram.usedBytes(); }
+
+private:
+    LruTier<const DecodedImage> ram;
+    LruTier<ViewTexture> vram;
+};
@@ -0,0 +1,291 @@
+#include "import.hpp"
+#include "content_hash.hpp"
+#include "hash_index.hpp"
+#include "scanner.hpp"
+#include "util.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#elif defined(__APPLE__)
+#include <copyfile.h>
+#include <sys/clonefile.h>
+#endif
+
+static std::string suffixedName(const fs::path& name, int n) {
+    return name.stem().string() + "_" + std::to_string(n) + name.extension().string();
+}
+
+static bool copyReadWrite(int in, int out) {
+    std::vector<char> buf(1 << 20);
+    while (true) {
+        ssize_t n = read(in, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true;
+        for (ssize_t off = 0; off < n; ) {
+            ssize_t w = write(out, buf.data() + off, (std::size_t)(n - off));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            off += w;
+        }
+    }
+}
+
+bool copyFileFast(const std::string& src, const std::string& dst, CopyMethod* method) {
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    struct stat st {};
+    if (fstat(in, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(in);
+        return false;
+    }
+
+#if defined(__APPLE__)
+    if (fclonefileat(in, AT_FDCWD, dst.c_str(), 0) == 0) {
+        close(in);
+        if (method) *method = CopyMethod::Clone;
+        return true;
+    }
+#endif
+
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777);
+    if (out < 0) {
+        int err = errno;   // callers look for EEXIST
+        close(in);
+        errno = err;
+        return false;
+    }
+
+    CopyMethod used = CopyMethod::ReadWrite;
+    bool ok = false;
+#if defined(__linux__)
+    if (ioctl(out, FICLONE, in) == 0) {
+        used = CopyMethod::Clone;
+        ok = true;
+    } else {
+        // copy_file_range: the kernel moves the data (or shares extents on NFS/XFS/btrfs);
+        // EXDEV/ENOSYS/EINVAL on the first call mean this pair of filesystems cannot do it
+        off_t left = st.st_size;
+        bool first = true;
+        ok = true;
+        while (left > 0) {
+            ssize_t n = copy_file_range(in, nullptr, out, nullptr, (std::size_t)left, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            left -= n;
+            first = false;
+        }
+        if (ok) used = CopyMethod::Kernel;
+        else if (first) {
+            ok = lseek(in, 0, SEEK_SET) == 0 && ftruncate(out, 0) == 0 && copyReadWrite(in, out);
+        }
+    }
+#elif defined(__APPLE__)
+    if (fcopyfile(in, out, nullptr, COPYFILE_DATA) == 0) {
+        used = CopyMethod::Kernel;
+        ok = true;
+    } else {
+        ok = lseek(in, 0, SEEK_SET) == 0 && ftruncate(out, 0) == 0 && copyReadWrite(in, out);
+    }
+#else
+    ok = copyReadWrite(in, out);
+#endif
+
+    if (close(out) != 0) ok = false;
+    close(in);
+    if (!ok) {
+        unlink(dst.c_str());
+        return false;
+    }
+    if (method) *method = used;
+    return true;
+}
+
+bool copyToFolderUnique(const std::string& srcPath, const std::string& dstFolder, std::string& outFinalName) {
+    fs::path src(srcPath);
+    std::error_code ec;
+    if (!fs::is_regular_file(src, ec)) return false;
+
+    fs::create_directories(dstFolder, ec);
+
+    // the exclusive create inside copyFileFast is the existence check
+    std::string name = src.filename().string();
+    for (int n = 1; ; n++) {
+        std::string dst = (fs::path(dstFolder) / name).string();
+        if (copyFileFast(srcPath, dst)) {
+            outFinalName = name;
+            return true;
+        }
+        if (errno != EEXIST || n > 100000) return false;
+        name = suffixedName(src.filename(), n);
+    }
+}
+
+UniqueNamer::UniqueNamer(const std::string& folder) {
+    DIR* d = opendir(folder.c_str());
+    if (!d) return;
+    while (dirent* e = readdir(d)) used.insert(e->d_name);
+    closedir(d);
+}
+
+std::string UniqueNamer::claim(const std::string& fileName) {
+    fs::path name(fileName);
+    std::string candidate = fileName;
+    for (int n = 1; used.count(candidate); n++) candidate = suffixedName(name, n);
+    used.insert(candidate);
+    return candidate;
+}
+
+ImportResult importFiles(const std::vector<std::string>& sources, const std::string& dstFolder, unsigned threads,
+                         const std::function<void(const ImportProgress&)>& onProgress, HashIndex* hashes,
+                         const std::atomic<bool>* cancel) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+
+    ImportResult result;
+    std::error_code ec;
+    fs::create_directories(dstFolder, ec);
+
+    std::vector<std::string> targets;
+    std::vector<std::uint64_t> sizes;
+    targets.reserve(sources.size());
+    sizes.reserve(sources.size());
+    UniqueNamer namer(dstFolder);
+    std::atomic<std::uint64_t> bytesTotal{0};
+    for (auto& s : sources) {
+        targets.push_back((fs::path(dstFolder) / namer.claim(baseName(s))).string());
+        auto sz = fs::file_size(s, ec);
+        sizes.push_back(ec ? 0 : (std::uint64_t)sz);
+        bytesTotal += sizes.back();
+    }
+
+    std::vector<char> status(sources.size(), 0);   // 0 pending, 1 ok, 2 failed, 3 duplicate
+    std::vector<CopyMethod> methods(sources.size(), CopyMethod::ReadWrite);
+    std::vector<std::string> duplicateOf(sources.size());
+    std::atomic<std::size_t> next{0}, done{0}, failed{0}, duplicates{0};
+    std::atomic<std::uint64_t> bytesDone{0};
+    std::mutex m;
+    std::condition_variable cv;
+
+    if (threads == 0) threads = 1;
+    threads = (unsigned)std::min<std::size_t>(threads, std::max<std::size_t>(1, sources.size()));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&]{
+            while (true) {
+                std::size_t i = next.fetch_add(1);
+                if (i >= sources.size()) return;
+                if (cancel && cancel->load()) {
+                    bytesTotal -= sizes[i];
+                    if (++done == sources.size()) {
+                        std::lock_guard<std::mutex> lk(m);
+                        cv.notify_all();
+                    }
+                    continue;
+                }
+                std::uint64_t hash = 0, size = 0;
+                bool claimed = false;
+                if (hashes && hashFile(sources[i], hash, &size)) {
+                    std::string existing = hashes->claim(hash, size, targets[i]);
+                    claimed = existing.empty();
+                    duplicateOf[i] = std::move(existing);
+                }
+
+                bool ok = true;
+                if (duplicateOf[i].empty()) {
+                    PROFILE_ZONE("import");
+                    ok = copyFileFast(sources[i], targets[i], &methods[i]);
+                }
+                if (claimed) {
+                    struct stat st {};
+                    if (ok && stat(targets[i].c_str(), &st) == 0) hashes->record(targets[i], hash, size, (std::int64_t)st.st_mtime);
+                    else hashes->remove(targets[i]);
+                }
+
+                status[i] = !duplicateOf[i].empty() ? 3 : ok ? 1 : 2;
+                if (status[i] == 1) bytesDone += sizes[i];
+                if (status[i] == 2) failed++;
+                if (status[i] == 3) {
+                    duplicates++;
+                    bytesTotal -= sizes[i];
+                }
+                if (++done == sources.size()) {
+                    std::lock_guard<std::mutex> lk(m);
+                    cv.notify_all();
+                }
+            }
+        });
+    }
+
+    auto snapshot = [&] {
+        ImportProgress p;
+        p.filesTotal = sources.size();
+        p.filesDone = done;
+        p.failed = failed;
+        p.duplicates = duplicates;
+        p.bytesTotal = bytesTotal;
+        p.bytesDone = bytesDone;
+        p.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return p;
+    };
+
+    {
+        std::unique_lock<std::mutex> lk(m);
+        while (!cv.wait_for(lk, std::chrono::milliseconds(200), [&]{ return done == sources.size(); })) {
+            if (onProgress) {
+                lk.unlock();
+                onProgress(snapshot());
+                lk.lock();
+            }
+        }
+    }
+    for (auto& w : workers) w.join();
+
+    for (std::size_t i = 0; i < sources.size(); i++) {
+        if (status[i] == 0) {
+            result.skipped++;
+            continue;
+        }
+        if (status[i] == 3) {
+            result.duplicates.emplace_back(sources[i], duplicateOf[i]);
+            continue;
+        }
+        if (status[i] != 1) {
+            result.failed.push_back(sources[i]);
+            continue;
+        }
+        result.imported.push_back(targets[i]);
+        if (methods[i] == CopyMethod::Clone) result.cloned++;
+        if (methods[i] == CopyMethod::Kernel) result.kernelCopied++;
+    }
+    result.totals = snapshot();
+    if (onProgress) onProgress(result.totals);
+    return result;
+}
+
+ImportResult importFolder(const std::string& srcFolder, const std::string& dstFolder, unsigned threads,
+                          const std::function<void(const ImportProgress&)>& onProgress, HashIndex* hashes,
+                          const std::atomic<bool>* cancel) {
+    std::vector<std::string> sources;
+    TreeScanner scan(srcFolder, threads);
+    scan.wait();
+    for (auto& e : scan.take().files) sources.push_back(std::move(e.path));
+    std::sort(sources.begin(), sources.end());
+    return importFiles(sources, dstFolder, threads, onProgress, hashes, cancel);
+}
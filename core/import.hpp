@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class HashIndex;
+
+// copies srcPath into dstFolder, appending _1, _2, ... to the stem if the name is taken
+bool copyToFolderUnique(const std::string& srcPath, const std::string& dstFolder, std::string& outFinalName);
+
+enum class CopyMethod { Clone, Kernel, ReadWrite };
+
+// Copies src to a new file dst (fails if dst exists). Tries a copy-on-write clone first
+// (FICLONE / clonefile), then an in-kernel copy (copy_file_range / fcopyfile), then plain
+// read/write. A partial dst is removed on failure.
+bool copyFileFast(const std::string& src, const std::string& dst, CopyMethod* method = nullptr);
+
+// Hands out file names that are free in one folder. The folder is listed once; after that
+// collisions are resolved against the in-memory set instead of probing the disk.
+class UniqueNamer {
+public:
+    explicit UniqueNamer(const std::string& folder);
+
+    // fileName itself if free, otherwise stem_1.ext, stem_2.ext, ...; the result is marked used
+    std::string claim(const std::string& fileName);
+
+private:
+    std::unordered_set<std::string> used;
+};
+
+struct ImportProgress {
+    std::size_t filesDone = 0, filesTotal = 0, failed = 0, duplicates = 0;
+    // bytesDone counts copies only; duplicates and files skipped on cancel leave bytesTotal
+    // as they are found, so the rate is copy throughput
+    std::uint64_t bytesDone = 0, bytesTotal = 0;
+    double seconds = 0.0;
+
+    double mbPerSec() const { return seconds > 0.0 ? (double)bytesDone / (1024.0 * 1024.0) / seconds : 0.0; }
+};
+
+struct ImportResult {
+    std::vector<std::string> imported;   // destination paths, in source order
+    std::vector<std::string> failed;     // source paths
+    std::vector<std::pair<std::string, std::string>> duplicates;   // source, library file it matches
+    ImportProgress totals;
+    std::size_t cloned = 0, kernelCopied = 0;
+    std::size_t skipped = 0;   // not started because the import was cancelled
+};
+
+// Copies every source into dstFolder on `threads` workers. Names are reserved up front, so
+// the result does not depend on scheduling. onProgress runs on the calling thread about
+// five times a second and once more at the end.
+// With `hashes`, each source is hashed first and skipped if the library (or an earlier file
+// of the same batch) already has identical content; new copies are recorded in the index.
+// Once *cancel is set no further file is started; the ones not reached are counted in skipped.
+ImportResult importFiles(const std::vector<std::string>& sources, const std::string& dstFolder, unsigned threads,
+                         const std::function<void(const ImportProgress&)>& onProgress = {},
+                         HashIndex* hashes = nullptr, const std::atomic<bool>* cancel = nullptr);
+
+// importFiles() over the images anywhere under srcFolder (recognized by content), sorted by
+// path; subfolders are flattened, name clashes get the usual _1, _2 suffix
+ImportResult importFolder(const std::string& srcFolder, const std::string& dstFolder, unsigned threads,
+                          const std::function<void(const ImportProgress&)>& onProgress = {},
+                          HashIndex* hashes = nullptr, const std::atomic<bool>* cancel = nullptr);
@@ -0,0 +1,104 @@
+#include "job_queue.hpp"
+#include "profiler.hpp"
+
+JobQueue::JobQueue() {
+    worker = std::thread([this]{ workerLoop(); });
+}
+
+JobQueue::~JobQueue() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+        if (running) running->cancel = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void JobQueue::Job::progress(std::size_t done, std::size_t total, const std::string& detail) {
+    std::lock_guard<std::mutex> lk(q.m);
+    q.current.done = done;
+    q.current.total = total;
+    q.current.detail = detail;
+}
+
+void JobQueue::submit(const std::string& label, Work work) {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        queue.emplace_back(label, std::move(work));
+        current.queued = queue.size();
+    }
+    cv.notify_one();
+}
+
+void JobQueue::cancel() {
+    std::lock_guard<std::mutex> lk(m);
+    if (!running) return;
+    running->cancel = true;
+    current.cancelling = true;
+}
+
+bool JobQueue::poll() {
+    std::vector<Finish> done;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        done.swap(finished);
+    }
+    for (auto& f : done)
+        if (f) f();
+    return !done.empty();
+}
+
+JobQueue::Status JobQueue::status() {
+    std::lock_guard<std::mutex> lk(m);
+    return current;
+}
+
+bool JobQueue::busy() {
+    std::lock_guard<std::mutex> lk(m);
+    return current.running || !queue.empty() || !finished.empty();
+}
+
+void JobQueue::shutdown() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+        if (running) running->cancel = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+    poll();
+}
+
+void JobQueue::workerLoop() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cv.wait(lk, [&]{ return stopping || !queue.empty(); });
+        // on the way out queued jobs still run, cancelled, so their callbacks can tidy up
+        if (queue.empty()) return;
+
+        auto [label, work] = std::move(queue.front());
+        queue.pop_front();
+        Job job(*this);
+        job.cancel = stopping;
+        running = &job;
+        current = Status{};
+        current.running = true;
+        current.cancelling = stopping;
+        current.label = label;
+        current.queued = queue.size();
+
+        lk.unlock();
+        Finish finish;
+        {
+            PROFILE_ZONE("job");
+            finish = work(job);
+        }
+        lk.lock();
+
+        running = nullptr;
+        finished.push_back(std::move(finish));
+        current = Status{};
+        current.queued = queue.size();
+    }
+}
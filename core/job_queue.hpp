@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Long library operations (imports, deletes) run here one at a time on a background thread,
+// so the window keeps drawing while they work. A job reports progress and checks cancelled()
+// between files; the callback it returns runs on the UI thread in poll(), and only that part
+// may touch state the UI owns (the library listing, the photo list).
+class JobQueue {
+public:
+    class Job {
+    public:
+        bool cancelled() const { return cancel.load(std::memory_order_relaxed); }
+        // for code that polls the flag itself (importFiles)
+        const std::atomic<bool>* cancelFlag() const { return &cancel; }
+        // total 0: no count yet, only the detail line
+        void progress(std::size_t done, std::size_t total, const std::string& detail = {});
+
+    private:
+        friend class JobQueue;
+        explicit Job(JobQueue& q) : q(q) {}
+        JobQueue& q;
+        std::atomic<bool> cancel{false};
+    };
+
+    using Finish = std::function<void()>;
+    using Work = std::function<Finish(Job&)>;
+
+    struct Status {
+        bool running = false;
+        bool cancelling = false;
+        std::string label, detail;
+        std::size_t done = 0, total = 0;
+        std::size_t queued = 0;   // waiting behind the running one
+    };
+
+    JobQueue();
+    ~JobQueue();
+
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+
+    void submit(const std::string& label, Work work);
+
+    // asks the running job to stop; queued jobs still run (a delete the UI already showed
+    // must happen)
+    void cancel();
+
+    // runs the callbacks of finished jobs; true if any ran
+    bool poll();
+
+    Status status();
+    bool busy();
+
+    // for exit: the running job is cancelled, queued ones start cancelled, and their callbacks
+    // run before this returns
+    void shutdown();
+
+private:
+    void workerLoop();
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::pair<std::string, Work>> queue;
+    std::vector<Finish> finished;
+    Status current;
+    Job* running = nullptr;
+    std::thread worker;
+    bool stopping = false;
+};
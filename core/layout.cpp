@@ -0,0 +1,34 @@
+#include "layout.hpp"
+
+#include <algorithm>
+
+FitResult computeFit(sf::Vector2u size, sf::Vector2u win, float bottomBarH, float zoom, sf::Vector2f pan) {
+    FitResult r;
+    if (size.x == 0 || size.y == 0) return r;
+
+    float padding = 30.f;
+    float maxW = (float)win.x - padding * 2.f;
+    float maxH = (float)win.y - bottomBarH - padding * 2.f;
+
+    r.scale = std::min(maxW / (float)size.x, maxH / (float)size.y) * zoom;
+    sf::Vector2f shown((float)size.x * r.scale, (float)size.y * r.scale);
+    sf::Vector2f room((float)win.x, (float)win.y - bottomBarH);
+    auto clampPan = [](float p, float over) { return over > 0.f ? std::clamp(p, -over / 2.f, over / 2.f) : 0.f; };
+    r.pan = {clampPan(pan.x, shown.x - room.x), clampPan(pan.y, shown.y - room.y)};
+    r.position = {
+        (room.x - shown.x) / 2.f + r.pan.x,
+        (room.y - shown.y) / 2.f + r.pan.y
+    };
+    return r;
+}
+
+FitResult fitSprite(sf::Sprite& s, sf::Vector2u win, float bottomBarH, float zoom, sf::Vector2f pan) {
+    auto r = s.getTextureRect();
+    if (r.size.x <= 0 || r.size.y <= 0) return {};
+    sf::Vector2u sz((unsigned)r.size.x, (unsigned)r.size.y);
+
+    FitResult f = computeFit(sz, win, bottomBarH, zoom, pan);
+    s.setScale({f.scale, f.scale});
+    s.setPosition(f.position);
+    return f;
+}
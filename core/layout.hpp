@@ -0,0 +1,18 @@
+#pragma once
+
+#include <SFML/Graphics/Sprite.hpp>
+
+// Placement of an image of `size` pixels centered in the window area above the bottom bar,
+// moved by `pan` (screen pixels) when zoomed in. The pan is clamped so the image never leaves
+// a gap at an edge it overflows; along an axis where it fits, it stays centered.
+struct FitResult {
+    float scale = 1.f;
+    sf::Vector2f position;
+    sf::Vector2f pan;   // the pan actually applied
+};
+
+FitResult computeFit(sf::Vector2u size, sf::Vector2u win, float bottomBarH, float zoom = 1.f,
+                     sf::Vector2f pan = {});
+
+// fits the sprite's texture rect, so a cropped preview fills the same box as the full photo
+FitResult fitSprite(sf::Sprite& s, sf::Vector2u win, float bottomBarH, float zoom = 1.f, sf::Vector2f pan = {});
@@ -0,0 +1,262 @@
+#include "library_index.hpp"
+#include "scanner.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <sys/stat.h>
+
+namespace {
+
+bool byPath(const LibraryIndex::Entry& a, const LibraryIndex::Entry& b) { return a.path < b.path; }
+
+bool sameEntry(const LibraryIndex::Entry& a, const LibraryIndex::Entry& b) {
+    return a.path == b.path && a.size == b.size && a.mtime == b.mtime && a.inode == b.inode;
+}
+
+std::string parentOf(const std::string& path) {
+    auto slash = path.rfind('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+} // namespace
+
+LibraryIndex::LibraryIndex(const std::string& folder, const std::string& indexFile, unsigned threads, MediaKind kind)
+    : folder(folder), indexFile(indexFile), threads(threads ? threads : std::thread::hardware_concurrency()), kind(kind) {
+    while (this->folder.size() > 1 && this->folder.back() == '/') this->folder.pop_back();
+    if (this->threads == 0) this->threads = 2;
+    load();
+}
+
+LibraryIndex::~LibraryIndex() = default;
+
+bool LibraryIndex::reconcile() {
+    startScan();
+    scanner->wait();
+    return pollScan();
+}
+
+void LibraryIndex::startScan() {
+    if (scanner) return;
+
+    // what the last scan saw, grouped by directory
+    auto known = std::make_shared<TreeScanner::Known>();
+    for (auto& [dir, mtime] : dirs) known->dirs[dir].mtime = mtime;
+    for (auto& [dir, mtime] : dirs) {
+        if (dir == folder) continue;
+        auto it = known->dirs.find(parentOf(dir));
+        if (it != known->dirs.end()) it->second.subdirs.push_back(dir);
+    }
+    for (auto& e : entries) {
+        auto it = known->dirs.find(parentOf(e.path));
+        if (it != known->dirs.end()) it->second.files.push_back(e);
+    }
+
+    scanFiles.clear();
+    scanDirs.clear();
+    scanRemoved.clear();
+    lastMerge = {};
+    scanner = std::make_unique<TreeScanner>(folder, threads, std::move(known), kind);
+}
+
+bool LibraryIndex::pollScan() {
+    if (!scanner) return false;
+    bool done = scanner->done();
+    auto now = std::chrono::steady_clock::now();
+    // an empty listing takes the first images at once, so something can be shown early
+    if (!done && !entries.empty() && now - lastMerge < std::chrono::milliseconds(SCAN_MERGE_MS)) return false;
+    lastMerge = now;
+
+    auto batch = scanner->take();
+    for (auto& d : batch.dirs) scanDirs[d.path] = d.mtime;
+    bool changed = mergeFound(batch.files);
+    if (done) changed = finishScan() || changed;
+    return changed;
+}
+
+// only adds files the listing does not have yet; changed and vanished ones wait for the end
+bool LibraryIndex::mergeFound(std::vector<Entry>& batch) {
+    std::vector<Entry> fresh;
+    for (auto& e : batch) {
+        if (scanRemoved.count(e.path)) continue;
+        auto it = std::lower_bound(entries.begin(), entries.end(), e, byPath);
+        if (it == entries.end() || it->path != e.path) fresh.push_back(e);
+    }
+    scanFiles.insert(scanFiles.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    if (fresh.empty()) return false;
+
+    std::sort(fresh.begin(), fresh.end(), byPath);
+    std::size_t mid = entries.size();
+    entries.insert(entries.end(), std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+    std::inplace_merge(entries.begin(), entries.begin() + (std::ptrdiff_t)mid, entries.end(), byPath);
+    gen++;
+    return true;
+}
+
+LibraryIndex::ScanReport LibraryIndex::scanProgress() const {
+    if (!scanner) return report;
+    auto s = scanner->stats();
+    return {s.dirs, s.listed, s.files, s.opened, s.images, s.mislabeled, s.unsupported, s.seconds, report.count};
+}
+
+bool LibraryIndex::finishScan() {
+    auto s = scanner->stats();
+    report = {s.dirs, s.listed, s.files, s.opened, s.images, s.mislabeled, s.unsupported, s.seconds, report.count + 1};
+    scanner.reset();
+
+    // app adds are appended after the scanner's copy of the same path, so the last one wins
+    std::stable_sort(scanFiles.begin(), scanFiles.end(), byPath);
+    std::vector<Entry> next;
+    next.reserve(scanFiles.size());
+    for (std::size_t i = 0; i < scanFiles.size(); i++) {
+        if (i + 1 < scanFiles.size() && scanFiles[i + 1].path == scanFiles[i].path) continue;
+        if (scanRemoved.count(scanFiles[i].path)) continue;
+        next.push_back(std::move(scanFiles[i]));
+    }
+    scanFiles.clear();
+    scanRemoved.clear();
+
+    bool changed = next.size() != entries.size() || !std::equal(next.begin(), next.end(), entries.begin(), sameEntry);
+    bool dirsChanged = scanDirs != dirs;
+    entries = std::move(next);
+    dirs = std::move(scanDirs);
+    scanDirs.clear();
+    if (changed || dirsChanged || dirty) save();
+    if (changed) gen++;
+    return changed;
+}
+
+std::vector<std::string> LibraryIndex::paths() const {
+    std::vector<std::string> v;
+    v.reserve(entries.size());
+    for (auto& e : entries) v.push_back(e.path);
+    return v;
+}
+
+const LibraryIndex::Entry* LibraryIndex::find(const std::string& path) const {
+    auto it = std::lower_bound(entries.begin(), entries.end(), path,
+                               [](const Entry& a, const std::string& p){ return a.path < p; });
+    return it != entries.end() && it->path == path ? &*it : nullptr;
+}
+
+void LibraryIndex::add(const std::string& path) {
+    Entry e;
+    if (!statEntry(path, e)) return;
+    if (scanner) {
+        scanFiles.push_back(e);
+        scanRemoved.erase(path);
+    }
+    auto it = std::lower_bound(entries.begin(), entries.end(), path,
+                               [](const Entry& a, const std::string& p){ return a.path < p; });
+    if (it != entries.end() && it->path == path) *it = std::move(e);
+    else entries.insert(it, std::move(e));
+    noteOwnChange(parentOf(path));
+}
+
+void LibraryIndex::add(const std::vector<std::string>& paths) {
+    std::unordered_map<std::string, std::size_t> known;
+    for (std::size_t i = 0; i < entries.size(); i++) known[entries[i].path] = i;
+    std::unordered_set<std::string> touched;
+    bool any = false;
+    for (auto& p : paths) {
+        Entry e;
+        if (!statEntry(p, e)) continue;
+        if (scanner) {
+            scanFiles.push_back(e);
+            scanRemoved.erase(p);
+        }
+        touched.insert(parentOf(p));
+        auto it = known.find(p);
+        if (it != known.end()) {
+            entries[it->second] = std::move(e);
+        } else {
+            known[p] = entries.size();
+            entries.push_back(std::move(e));
+        }
+        any = true;
+    }
+    if (!any) return;
+    std::sort(entries.begin(), entries.end(), byPath);
+    for (auto& dir : touched) noteOwnChange(dir);
+}
+
+void LibraryIndex::remove(const std::string& path) {
+    auto it = std::lower_bound(entries.begin(), entries.end(), path,
+                               [](const Entry& a, const std::string& p){ return a.path < p; });
+    if (it == entries.end() || it->path != path) return;
+    entries.erase(it);
+    if (scanner) scanRemoved.insert(path);
+    noteOwnChange(parentOf(path));
+}
+
+void LibraryIndex::noteOwnChange(const std::string& dir) {
+    // a directory no scan has recorded yet must stay unknown, or the next scan would skip it
+    std::int64_t mtime = dirMtimeNanos(dir);
+    auto it = dirs.find(dir);
+    if (it != dirs.end()) it->second = mtime;
+    auto sit = scanDirs.find(dir);
+    if (sit != scanDirs.end()) sit->second = mtime;
+    dirty = true;
+    gen++;
+}
+
+bool LibraryIndex::statEntry(const std::string& path, Entry& e) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    e.path = path;
+    e.size = (std::uint64_t)st.st_size;
+    e.mtime = (std::int64_t)st.st_mtime;
+    e.inode = (std::uint64_t)st.st_ino;
+    return true;
+}
+
+// first line: format version; then D|mtime|dir per directory and size|mtime|inode|path per
+// image. An index without the version line listed one folder only and is rebuilt by a scan.
+void LibraryIndex::load() {
+    std::ifstream in(indexFile);
+    std::string line;
+    if (!std::getline(in, line) || line != "v2") return;
+    while (std::getline(in, line)) {
+        auto a = line.find('|');
+        if (a == std::string::npos) continue;
+        auto b = line.find('|', a + 1);
+        if (b == std::string::npos) continue;
+        // a damaged line (torn write, hand edit) is skipped; the next scan puts the file back
+        if (line.compare(0, a, "D") == 0) {
+            try {
+                dirs[line.substr(b + 1)] = std::stoll(line.substr(a + 1, b - a - 1));
+            } catch (...) {
+            }
+            continue;
+        }
+        auto c = line.find('|', b + 1);
+        if (c == std::string::npos) continue;
+        Entry e;
+        try {
+            e.size  = std::stoull(line.substr(0, a));
+            e.mtime = std::stoll(line.substr(a + 1, b - a - 1));
+            e.inode = std::stoull(line.substr(b + 1, c - b - 1));
+        } catch (...) {
+            continue;
+        }
+        e.path  = line.substr(c + 1);
+        entries.push_back(std::move(e));
+    }
+    std::sort(entries.begin(), entries.end(), byPath);
+}
+
+// written to a temp file and renamed, so a crash never leaves a half-written index
+void LibraryIndex::save() {
+    std::string tmp = indexFile + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "v2\n";
+        for (auto& [dir, mtime] : dirs) out << "D|" << mtime << "|" << dir << "\n";
+        for (auto& e : entries)
+            out << e.size << "|" << e.mtime << "|" << e.inode << "|" << e.path << "\n";
+    }
+    std::error_code ec;
+    fs::rename(tmp, indexFile, ec);
+    dirty = false;
+}
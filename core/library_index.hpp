@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class TreeScanner;
+
+// what a listing holds: decodable images, or videos (see sniffVideoFormat)
+enum class MediaKind { Images, Videos };
+
+// Persistent listing of the images (or videos) under one folder, subfolders included (path,
+// size, mtime, inode). Files are recognized by content (see TreeScanner), not by extension.
+// A directory is only re-listed when its own mtime changes; known files are stat'ed rather than
+// opened, and only one whose inode, size or mtime changed is read again. Adds and deletes made
+// by the app update the index in memory.
+class LibraryIndex {
+public:
+    struct Entry {
+        std::string path;
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        std::uint64_t inode = 0;
+    };
+
+    // threads: scanner workers (0 = one per core)
+    LibraryIndex(const std::string& folder, const std::string& indexFile, unsigned threads = 0,
+                 MediaKind kind = MediaKind::Images);
+    ~LibraryIndex();
+
+    // brings the index in line with the folder; returns true if anything changed
+    bool reconcile();
+
+    // Starts the same re-scan in the background (nothing happens if one is running). Until it
+    // is done the listing keeps what it had and grows as new images turn up; pollScan() merges
+    // them (at most SCAN_MERGE_MS apart, so derived indexes are not rebuilt every frame) and,
+    // once the scan is finished, drops files that are gone and saves. True if anything changed.
+    void startScan();
+    bool pollScan();
+    bool scanning() const { return scanner != nullptr; }
+
+    struct ScanReport {
+        std::size_t dirs = 0, listed = 0, files = 0, opened = 0, images = 0, mislabeled = 0, unsupported = 0;
+        double seconds = 0.0;
+        std::size_t count = 0;   // scans finished so far
+    };
+    // totals of the last finished scan
+    const ScanReport& lastScan() const { return report; }
+    // counts of the running scan so far (lastScan() when none runs)
+    ScanReport scanProgress() const;
+
+    // sorted by path
+    std::vector<std::string> paths() const;
+
+    void add(const std::string& path);
+    // bulk form for imports: one sort and one folder stat for the whole batch
+    void add(const std::vector<std::string>& paths);
+    void remove(const std::string& path);
+
+    // writes pending in-memory changes (called on exit; a crash just means one extra re-list)
+    void flush() {
+        if (dirty) save();
+    }
+
+    std::size_t size() const { return entries.size(); }
+    const std::vector<Entry>& all() const { return entries; }
+    // binary search of the listing, no disk access; null if the path is not in it
+    const Entry* find(const std::string& path) const;
+
+    // bumped on every change to the listing, so derived indexes know when to rebuild
+    std::uint64_t generation() const { return gen; }
+
+private:
+    static constexpr int SCAN_MERGE_MS = 500;
+
+    static bool statEntry(const std::string& path, Entry& e);
+
+    // our own add/delete bumps the directory's mtime; remember it so it does not force a re-list
+    void noteOwnChange(const std::string& dir);
+
+    bool mergeFound(std::vector<Entry>& batch);
+    bool finishScan();
+
+    void load();
+    void save();
+
+    std::string folder;
+    std::string indexFile;
+    unsigned threads;
+    MediaKind kind;
+    std::unordered_map<std::string, std::int64_t> dirs;   // every directory under folder -> mtime (ns)
+    std::vector<Entry> entries;
+    bool dirty = false;
+    std::uint64_t gen = 0;
+
+    // state of the running scan: everything it reported (the next listing), plus what the app
+    // added or removed meanwhile, which the scanner may or may not have seen
+    std::unique_ptr<TreeScanner> scanner;
+    std::vector<Entry> scanFiles;
+    std::unordered_map<std::string, std::int64_t> scanDirs;
+    std::unordered_set<std::string> scanRemoved;
+    std::chrono::steady_clock::time_point lastMerge;
+    ScanReport report;
+};
@@ -0,0 +1,362 @@
+#include "metadata.hpp"
+#include "catalog.hpp"
+#include "profiler.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------- header parsing ----------
+namespace {
+
+// Reads byte ranges of an open file; every parser below goes through it, so nothing reads
+// more than the headers it asks for.
+struct HeaderReader {
+    int fd = -1;
+    std::uint64_t size = 0;
+
+    bool read(std::uint64_t off, void* dst, std::size_t n) const {
+        if (off + n > size) return false;
+        return pread(fd, dst, n, (off_t)off) == (ssize_t)n;
+    }
+};
+
+std::uint16_t be16(const std::uint8_t* p) { return (std::uint16_t)(p[0] << 8 | p[1]); }
+std::uint32_t be32(const std::uint8_t* p) { return (std::uint32_t)p[0] << 24 | (std::uint32_t)p[1] << 16 | (std::uint32_t)p[2] << 8 | p[3]; }
+std::uint16_t le16(const std::uint8_t* p) { return (std::uint16_t)(p[1] << 8 | p[0]); }
+std::uint32_t le32(const std::uint8_t* p) { return (std::uint32_t)p[3] << 24 | (std::uint32_t)p[2] << 16 | (std::uint32_t)p[1] << 8 | p[0]; }
+
+// TIFF structure inside an Exif APP1 segment (or a PNG eXIf chunk)
+struct Tiff {
+    const std::uint8_t* data;
+    std::size_t size;
+    bool little;
+
+    std::uint16_t u16(std::size_t off) const { return off + 2 <= size ? (little ? le16(data + off) : be16(data + off)) : 0; }
+    std::uint32_t u32(std::size_t off) const { return off + 4 <= size ? (little ? le32(data + off) : be32(data + off)) : 0; }
+
+    // ASCII value of an IFD entry (inline when it fits in 4 bytes)
+    std::string ascii(std::size_t entry) const {
+        std::uint32_t count = u32(entry + 4);
+        std::size_t off = count <= 4 ? entry + 8 : u32(entry + 8);
+        if (count == 0 || off + count > size) return "";
+        std::string s((const char*)data + off, count);
+        s.erase(std::find(s.begin(), s.end(), '\0'), s.end());
+        return trim(s);
+    }
+};
+
+void parseIfd(const Tiff& t, std::size_t ifd, ImageMeta& out, std::string& make, std::string& model,
+              std::string& dateTime, bool exifIfd) {
+    std::uint16_t n = t.u16(ifd);
+    if (ifd + 2 + (std::size_t)n * 12 > t.size) return;
+    for (std::uint16_t i = 0; i < n; i++) {
+        std::size_t e = ifd + 2 + (std::size_t)i * 12;
+        std::uint16_t tag = t.u16(e);
+        if (!exifIfd) {
+            if (tag == 0x010F) make = t.ascii(e);
+            else if (tag == 0x0110) model = t.ascii(e);
+            else if (tag == 0x0112) out.orientation = std::clamp<std::uint16_t>(t.u16(e + 8), 1, 8);
+            else if (tag == 0x0132) dateTime = t.ascii(e);
+            else if (tag == 0x8769) {
+                std::uint32_t sub = t.u32(e + 8);
+                if (sub > ifd && sub < t.size) parseIfd(t, sub, out, make, model, dateTime, true);
+            }
+        } else if (tag == 0x9003) {
+            out.captureDate = t.ascii(e);
+        }
+    }
+}
+
+void parseExif(const std::uint8_t* p, std::size_t n, ImageMeta& out) {
+    if (n < 8) return;
+    Tiff t{p, n, p[0] == 'I' && p[1] == 'I'};
+    if (!t.little && !(p[0] == 'M' && p[1] == 'M')) return;
+    if (t.u16(2) != 42) return;
+
+    std::string make, model, dateTime;
+    parseIfd(t, t.u32(4), out, make, model, dateTime, false);
+    if (out.captureDate.empty()) out.captureDate = dateTime;
+    // many makers repeat the make in the model ("Canon" + "Canon EOS R6")
+    if (!make.empty() && model.compare(0, make.size(), make) == 0) make.clear();
+    out.camera = trim(make + " " + model);
+}
+
+bool parseJpeg(const HeaderReader& r, ImageMeta& out) {
+    std::uint64_t off = 2;
+    std::uint8_t h[4];
+    while (r.read(off, h, 4)) {
+        if (h[0] != 0xFF) return false;
+        std::uint8_t marker = h[1];
+        if (marker == 0xFF) { off++; continue; }             // fill byte
+        if (marker == 0xD8 || (marker >= 0xD0 && marker <= 0xD7)) { off += 2; continue; }
+        if (marker == 0xD9 || marker == 0xDA) break;           // EOI / SOS: pixel data follows
+        std::uint16_t len = be16(h + 2);
+        if (len < 2) return false;
+
+        if (marker == 0xE1 && len >= 16 && out.camera.empty() && out.captureDate.empty()) {
+            std::vector<std::uint8_t> seg(len - 2);
+            if (r.read(off + 4, seg.data(), seg.size()) && std::memcmp(seg.data(), "Exif\0\0", 6) == 0)
+                parseExif(seg.data() + 6, seg.size() - 6, out);
+        } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            std::uint8_t sof[5];
+            if (!r.read(off + 4, sof, 5)) return false;
+            out.height = be16(sof + 1);
+            out.width = be16(sof + 3);
+            return true;
+        }
+        off += 2 + (std::uint64_t)len;
+    }
+    return out.width != 0;
+}
+
+bool parsePng(const HeaderReader& r, ImageMeta& out) {
+    std::uint8_t ihdr[8];
+    if (!r.read(16, ihdr, 8)) return false;
+    out.width = be32(ihdr);
+    out.height = be32(ihdr + 4);
+
+    // eXIf is allowed anywhere before IDAT; only chunk headers are read on the way
+    std::uint64_t off = 8;
+    std::uint8_t h[8];
+    while (r.read(off, h, 8)) {
+        std::uint32_t len = be32(h);
+        if (std::memcmp(h + 4, "IDAT", 4) == 0 || std::memcmp(h + 4, "IEND", 4) == 0) break;
+        if (std::memcmp(h + 4, "eXIf", 4) == 0 && len < (1u << 20)) {
+            std::vector<std::uint8_t> exif(len);
+            if (r.read(off + 8, exif.data(), len)) parseExif(exif.data(), len, out);
+            break;
+        }
+        off += 12 + (std::uint64_t)len;
+    }
+    return true;
+}
+
+bool parseBmp(const HeaderReader& r, ImageMeta& out) {
+    std::uint8_t h[12];
+    if (!r.read(14, h, 12)) return false;
+    std::uint32_t headerSize = le32(h);
+    if (headerSize == 12) {                                    // OS/2 BITMAPCOREHEADER
+        out.width = le16(h + 4);
+        out.height = le16(h + 6);
+    } else {
+        out.width = le32(h + 4);
+        std::int32_t height = (std::int32_t)le32(h + 8);       // negative = top-down
+        out.height = (std::uint32_t)(height < 0 ? -(std::int64_t)height : height);
+    }
+    return true;
+}
+
+bool parseGif(const HeaderReader& r, ImageMeta& out) {
+    std::uint8_t h[4];
+    if (!r.read(6, h, 4)) return false;
+    out.width = le16(h);
+    out.height = le16(h + 2);
+    return true;
+}
+
+} // namespace
+
+bool readImageMeta(const std::string& path, ImageMeta& out) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    out = ImageMeta{};
+    out.fileSize = (std::uint64_t)st.st_size;
+    out.mtime = (std::int64_t)st.st_mtime;
+    HeaderReader r{fd, out.fileSize};
+
+    std::uint8_t sig[8] = {};
+    bool ok = false;
+    if (r.read(0, sig, 8)) {
+        if (sig[0] == 0xFF && sig[1] == 0xD8) ok = parseJpeg(r, out);
+        else if (std::memcmp(sig, "\x89PNG\r\n\x1a\n", 8) == 0) ok = parsePng(r, out);
+        else if (sig[0] == 'B' && sig[1] == 'M') ok = parseBmp(r, out);
+        else if (std::memcmp(sig, "GIF8", 4) == 0) ok = parseGif(r, out);
+    }
+    close(fd);
+    return ok;
+}
+
+bool readExifPreview(const std::string& path, std::vector<char>& jpeg) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    std::vector<std::uint8_t> seg;
+    if (fstat(fd, &st) == 0) {
+        HeaderReader r{fd, (std::uint64_t)st.st_size};
+        std::uint8_t h[4];
+        std::uint64_t off = 2;
+        if (r.read(0, h, 2) && h[0] == 0xFF && h[1] == 0xD8) {
+            while (r.read(off, h, 4) && h[0] == 0xFF) {
+                std::uint8_t marker = h[1];
+                if (marker == 0xFF) { off++; continue; }
+                if (marker == 0xD9 || marker == 0xDA) break;
+                std::uint16_t len = be16(h + 2);
+                if (len < 2) break;
+                if (marker == 0xE1 && len >= 16) {
+                    seg.resize(len - 2);
+                    if (r.read(off + 4, seg.data(), seg.size()) && std::memcmp(seg.data(), "Exif\0\0", 6) == 0) break;
+                    seg.clear();
+                }
+                off += 2 + (std::uint64_t)len;
+            }
+        }
+    }
+    close(fd);
+    if (seg.size() < 6 + 8) return false;
+
+    // IFD1 follows IFD0; its JPEGInterchangeFormat(Length) tags locate the preview
+    const std::uint8_t* p = seg.data() + 6;
+    Tiff t{p, seg.size() - 6, p[0] == 'I' && p[1] == 'I'};
+    if (t.u16(2) != 42) return false;
+    std::size_t ifd0 = t.u32(4);
+    std::size_t ifd1 = t.u32(ifd0 + 2 + (std::size_t)t.u16(ifd0) * 12);
+    if (ifd1 <= ifd0 || ifd1 >= t.size) return false;
+    std::uint32_t at = 0, len = 0;
+    std::uint16_t n = t.u16(ifd1);
+    for (std::uint16_t i = 0; i < n; i++) {
+        std::size_t e = ifd1 + 2 + (std::size_t)i * 12;
+        if (t.u16(e) == 0x0201) at = t.u32(e + 8);
+        else if (t.u16(e) == 0x0202) len = t.u32(e + 8);
+    }
+    if (len < 4 || (std::size_t)at + len > t.size || p[at] != 0xFF || p[at + 1] != 0xD8) return false;
+    jpeg.assign((const char*)p + at, (const char*)p + at + len);
+    return true;
+}
+
+// ---------- store ----------
+namespace {
+
+// catalog value: size(8) | mtime(8) | width(4) | height(4) | orientation(2) | date length(2) | date | camera
+constexpr std::size_t META_HEAD = 28;
+
+std::string encodeMeta(const ImageMeta& e) {
+    std::string out(META_HEAD, '\0');
+    std::uint16_t dateLen = (std::uint16_t)std::min<std::size_t>(e.captureDate.size(), 0xFFFF);
+    std::memcpy(&out[0], &e.fileSize, 8);
+    std::memcpy(&out[8], &e.mtime, 8);
+    std::memcpy(&out[16], &e.width, 4);
+    std::memcpy(&out[20], &e.height, 4);
+    std::memcpy(&out[24], &e.orientation, 2);
+    std::memcpy(&out[26], &dateLen, 2);
+    out.append(e.captureDate, 0, dateLen);
+    out += e.camera;
+    return out;
+}
+
+bool decodeMeta(const std::string& v, ImageMeta& e) {
+    if (v.size() < META_HEAD) return false;
+    std::uint16_t dateLen;
+    std::memcpy(&e.fileSize, &v[0], 8);
+    std::memcpy(&e.mtime, &v[8], 8);
+    std::memcpy(&e.width, &v[16], 4);
+    std::memcpy(&e.height, &v[20], 4);
+    std::memcpy(&e.orientation, &v[24], 2);
+    std::memcpy(&dateLen, &v[26], 2);
+    if (v.size() < META_HEAD + dateLen) return false;
+    e.captureDate = v.substr(META_HEAD, dateLen);
+    e.camera = v.substr(META_HEAD + dateLen);
+    return true;
+}
+
+} // namespace
+
+MetadataStore::MetadataStore(Catalog& catalog, unsigned threads) : catalog(catalog) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this]{ workerLoop(); });
+}
+
+MetadataStore::~MetadataStore() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void MetadataStore::sync(const std::vector<LibraryIndex::Entry>& library) {
+    std::unordered_set<std::string_view> present;
+    present.reserve(library.size());
+    std::deque<Job> todo;
+    std::string value;
+    ImageMeta meta;
+    for (auto& e : library) {
+        present.insert(e.path);
+        if (!catalog.get(CatalogTable::Metadata, e.path, value) || !decodeMeta(value, meta) ||
+            meta.fileSize != e.size || meta.mtime != e.mtime)
+            todo.push_back(Job{e.path, e.size, e.mtime});
+    }
+    std::vector<std::string> gone;
+    catalog.forEach(CatalogTable::Metadata, [&](std::string_view path, std::string_view) {
+        if (!present.count(path)) gone.emplace_back(path);
+    });
+    for (auto& path : gone) catalog.erase(CatalogTable::Metadata, path);
+
+    std::lock_guard<std::mutex> lk(m);
+    queue = std::move(todo);
+    cv.notify_all();
+}
+
+bool MetadataStore::get(const std::string& path, ImageMeta& out) {
+    std::string value;
+    return catalog.get(CatalogTable::Metadata, path, value) && decodeMeta(value, out);
+}
+
+void MetadataStore::forget(const std::string& path) {
+    catalog.erase(CatalogTable::Metadata, path);
+}
+
+void MetadataStore::forEach(const std::function<void(std::string_view, const ImageMeta&)>& fn) {
+    ImageMeta meta;
+    std::string value;
+    catalog.forEach(CatalogTable::Metadata, [&](std::string_view path, std::string_view v) {
+        value.assign(v.data(), v.size());
+        if (decodeMeta(value, meta)) fn(path, meta);
+    });
+}
+
+std::size_t MetadataStore::pending() {
+    std::lock_guard<std::mutex> lk(m);
+    return queue.size() + inFlight;
+}
+
+void MetadataStore::workerLoop() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cv.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        inFlight++;
+
+        lk.unlock();
+        ImageMeta meta;
+        bool ok;
+        {
+            PROFILE_ZONE("metadata");
+            ok = readImageMeta(job.path, meta);
+        }
+        // unreadable files still get a record (0 x 0), so they are not retried every sync
+        meta.fileSize = job.size;
+        meta.mtime = job.mtime;
+        if (!ok) meta.width = meta.height = 0;
+        catalog.put(CatalogTable::Metadata, job.path, encodeMeta(meta));
+        lk.lock();
+
+        inFlight--;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "library_index.hpp"
+
+class Catalog;
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// What the info panel, sorting and filtering need to know about a photo without decoding it.
+struct ImageMeta {
+    std::uint32_t width = 0, height = 0;
+    std::uint64_t fileSize = 0;
+    std::int64_t mtime = 0;             // file mtime (seconds) the record belongs to
+    std::string captureDate;            // EXIF DateTimeOriginal (or DateTime), "YYYY:MM:DD HH:MM:SS"
+    std::string camera;                 // EXIF Make + Model
+    std::uint16_t orientation = 1;      // EXIF orientation, 1..8
+};
+
+// Reads dimensions and EXIF from the file headers only (JPEG markers up to SOS, PNG chunks
+// up to IDAT, the BMP info header, the GIF screen descriptor); pixel data is never read.
+bool readImageMeta(const std::string& path, ImageMeta& out);
+
+// The small JPEG most cameras embed in the EXIF block (IFD1), copied out of a JPEG's
+// headers; false when there is none.
+bool readExifPreview(const std::string& path, std::vector<char>& jpeg);
+
+// Persistent ImageMeta for every library file, filled in by background workers and kept in the
+// catalog's Metadata table. Records are keyed by path and redone when the library reports a
+// different size or mtime, so lookups never touch the file system.
+class MetadataStore {
+public:
+    MetadataStore(Catalog& catalog, unsigned threads);
+    ~MetadataStore();
+
+    MetadataStore(const MetadataStore&) = delete;
+    MetadataStore& operator=(const MetadataStore&) = delete;
+
+    // queues new or changed files and drops records of files that are gone
+    void sync(const std::vector<LibraryIndex::Entry>& library);
+
+    // false while the file has not been read yet
+    bool get(const std::string& path, ImageMeta& out);
+
+    void forget(const std::string& path);
+
+    // every stored record, in no particular order; fn must not call back into the store
+    void forEach(const std::function<void(std::string_view path, const ImageMeta&)>& fn);
+
+    std::size_t pending();
+
+private:
+    struct Job {
+        std::string path;
+        std::uint64_t size;
+        std::int64_t mtime;
+    };
+
+    void workerLoop();
+
+    Catalog& catalog;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    std::size_t inFlight = 0;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
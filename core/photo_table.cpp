@@ -0,0 +1,233 @@
+#include "photo_table.hpp"
+#include "favorites.hpp"
+#include "metadata.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <sstream>
+#include <unordered_set>
+
+namespace {
+
+// days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's days_from_civil)
+std::int64_t daysFromCivil(std::int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (std::int64_t)doe - 719468;
+}
+
+std::int64_t yearStart(int year) { return daysFromCivil(year, 1, 1) * 86400; }
+
+// "YYYY:MM:DD HH:MM:SS" (EXIF) -> unix seconds
+bool parseExifDate(const std::string& s, std::int64_t& out) {
+    int y, mo, d, h = 0, mi = 0, sec = 0;
+    if (std::sscanf(s.c_str(), "%d:%d:%d %d:%d:%d", &y, &mo, &d, &h, &mi, &sec) < 3) return false;
+    if (y < 1800 || mo < 1 || mo > 12 || d < 1 || d > 31) return false;
+    out = daysFromCivil(y, (unsigned)mo, (unsigned)d) * 86400 + h * 3600 + mi * 60 + sec;
+    return true;
+}
+
+// "12mp", "1.5mb", "300kb" -> pixels or bytes
+bool parseAmount(const std::string& s, bool& isPixels, std::uint64_t& out) {
+    char* end = nullptr;
+    double v = std::strtod(s.c_str(), &end);
+    if (end == s.c_str() || v < 0) return false;
+    std::string unit = end;
+    isPixels = unit == "mp";
+    if (unit == "mp" || unit == "mb") v *= 1e6;
+    else if (unit == "kb") v *= 1e3;
+    else if (unit == "gb") v *= 1e9;
+    else if (unit != "b") return false;
+    out = (std::uint64_t)v;
+    return true;
+}
+
+} // namespace
+
+std::string parsePhotoFilter(const std::string& query, PhotoFilter& f) {
+    std::vector<std::string> words;
+    std::istringstream in(query);
+    for (std::string w; in >> w; ) words.push_back(w);
+
+    std::string rest;
+    for (std::size_t i = 0; i < words.size(); i++) {
+        std::string w = foldCase(words[i]);
+        // "> 12mp" and "taken 2025" are the spaced forms of ">12mp" and "taken:2025"
+        if ((w == ">" || w == "<") && i + 1 < words.size()) w += foldCase(words[++i]);
+        if (w == "taken" && i + 1 < words.size()) w = "taken:" + words[++i];
+
+        bool isPixels;
+        std::uint64_t amount;
+        if (w == "fav" || w == "favorites" || w == "★") f.favoritesOnly = true;
+        else if (w == "landscape") f.shape = Shape::Landscape;
+        else if (w == "portrait") f.shape = Shape::Portrait;
+        else if (w == "square") f.shape = Shape::Square;
+        else if ((w[0] == '>' || w[0] == '<') && parseAmount(w.substr(1), isPixels, amount)) {
+            auto& lo = isPixels ? f.minPixels : f.minBytes;
+            auto& hi = isPixels ? f.maxPixels : f.maxBytes;
+            if (w[0] == '>') lo = amount + 1;
+            else hi = amount;
+        } else if (w.rfind("taken:", 0) == 0) {
+            int from = 0, to = 0;
+            int n = std::sscanf(w.c_str() + 6, "%d-%d", &from, &to);
+            if (n < 1) continue;
+            if (n == 1) to = from;
+            f.takenFrom = yearStart(from);
+            f.takenTo = yearStart(to + 1);
+        } else if (w.rfind("sort:", 0) == 0) {
+            std::string k = w.substr(5);
+            f.descending = !k.empty() && k[0] == '-';
+            if (f.descending) k.erase(0, 1);
+            if (k == "name") f.sort = SortKey::Name;
+            else if (k == "date") f.sort = SortKey::Date;
+            else if (k == "size") f.sort = SortKey::Size;
+            else if (k == "res") f.sort = SortKey::Resolution;
+        } else {
+            if (!rest.empty()) rest += ' ';
+            rest += words[i];
+        }
+    }
+    return rest;
+}
+
+void PhotoTable::build(const std::vector<LibraryIndex::Entry>& library, MetadataStore& metadata, const FavoritesSet& favorites) {
+    std::size_t n = library.size();
+    paths.resize(n);
+    bytes.resize(n);
+    pixels.assign(n, 0);
+    taken.resize(n);
+    flags.assign(n, 0);
+    for (auto& o : orders) o.clear();
+
+    std::unordered_set<std::string> favKeys;
+    favorites.forEach([&](std::string_view key) { favKeys.emplace(key); });
+    for (std::size_t i = 0; i < n; i++) {
+        paths[i] = library[i].path;
+        bytes[i] = library[i].size;
+        taken[i] = library[i].mtime;
+        if (!favKeys.empty() && favKeys.count(favorites.key(paths[i]))) flags[i] |= FAVORITE;
+    }
+
+    // most records come out of the catalog snapshot in path order, so each lookup gallops
+    // forward from the previous hit instead of searching all rows
+    std::size_t cursor = 0;
+    auto locate = [&](std::string_view p) -> int {
+        std::size_t lo = cursor < n && std::string_view(paths[cursor]) <= p ? cursor : 0, hi = lo, step = 1;
+        while (hi < n && std::string_view(paths[hi]) < p) {
+            lo = hi;
+            hi += step;
+            step *= 2;
+        }
+        auto end = paths.begin() + (std::ptrdiff_t)std::min(hi + 1, n);
+        auto it = std::lower_bound(paths.begin() + (std::ptrdiff_t)lo, end, p,
+                                   [](const std::string& a, std::string_view b) { return std::string_view(a) < b; });
+        if (it == end || *it != p) return -1;
+        cursor = (std::size_t)(it - paths.begin());
+        return (int)cursor;
+    };
+    metadata.forEach([&](std::string_view path, const ImageMeta& meta) {
+        int row = locate(path);
+        if (row < 0 || meta.fileSize != bytes[row]) return;
+        // orientations 5..8 are stored rotated by 90 degrees
+        std::uint32_t w = meta.orientation >= 5 ? meta.height : meta.width;
+        std::uint32_t h = meta.orientation >= 5 ? meta.width : meta.height;
+        pixels[row] = (std::uint64_t)w * h;
+        if (w && h) flags[row] |= w > h ? LANDSCAPE : w < h ? PORTRAIT : SQUARE;
+        std::int64_t t;
+        if (parseExifDate(meta.captureDate, t)) taken[row] = t;
+    });
+}
+
+void PhotoTable::setFavorite(const std::string& path, bool on) {
+    int row = rowOf(path);
+    if (row < 0) return;
+    if (on) flags[row] |= FAVORITE;
+    else flags[row] &= (std::uint8_t)~FAVORITE;
+}
+
+std::vector<std::uint32_t> PhotoTable::select(const PhotoFilter& f, const std::vector<std::uint32_t>* within) {
+    std::size_t n = paths.size();
+    std::uint8_t* mk;
+    if (within) {
+        mask.assign(n, 0);
+        mk = mask.data();
+        for (std::uint32_t row : *within) {
+            if (row < n) mk[row] = 1;
+        }
+    } else {
+        mask.assign(n, 1);
+        mk = mask.data();
+    }
+
+    // one pass per active predicate; each is a branch-free loop over one column
+    std::uint8_t need = (f.favoritesOnly ? FAVORITE : 0) |
+                        (f.shape == Shape::Landscape ? LANDSCAPE : f.shape == Shape::Portrait ? PORTRAIT :
+                         f.shape == Shape::Square ? SQUARE : 0);
+    if (need) {
+        const std::uint8_t* fl = flags.data();
+        for (std::size_t i = 0; i < n; i++) mk[i] &= (std::uint8_t)((fl[i] & need) == need);
+    }
+    if (f.minPixels > 0 || f.maxPixels != std::numeric_limits<std::uint64_t>::max()) {
+        const std::uint64_t* px = pixels.data();
+        std::uint64_t lo = f.minPixels, hi = f.maxPixels;
+        for (std::size_t i = 0; i < n; i++) mk[i] &= (std::uint8_t)((px[i] >= lo) & (px[i] <= hi));
+    }
+    if (f.minBytes > 0 || f.maxBytes != std::numeric_limits<std::uint64_t>::max()) {
+        const std::uint64_t* b = bytes.data();
+        std::uint64_t lo = f.minBytes, hi = f.maxBytes;
+        for (std::size_t i = 0; i < n; i++) mk[i] &= (std::uint8_t)((b[i] >= lo) & (b[i] <= hi));
+    }
+    if (f.takenFrom != std::numeric_limits<std::int64_t>::min() || f.takenTo != std::numeric_limits<std::int64_t>::max()) {
+        const std::int64_t* t = taken.data();
+        std::int64_t lo = f.takenFrom, hi = f.takenTo;
+        for (std::size_t i = 0; i < n; i++) mk[i] &= (std::uint8_t)((t[i] >= lo) & (t[i] < hi));
+    }
+
+    std::vector<std::uint32_t> out;
+    if (f.sort == SortKey::Name) {
+        // rows are already in path order
+        out.reserve(within ? within->size() : n);
+        for (std::uint32_t i = 0; i < (std::uint32_t)n; i++) {
+            if (mk[i]) out.push_back(i);
+        }
+        if (f.descending) std::reverse(out.begin(), out.end());
+        return out;
+    }
+    const auto& perm = order(f.sort);
+    out.reserve(within ? within->size() : n);
+    if (f.descending) {
+        for (auto it = perm.rbegin(); it != perm.rend(); ++it) {
+            if (mk[*it]) out.push_back(*it);
+        }
+    } else {
+        for (std::uint32_t row : perm) {
+            if (mk[row]) out.push_back(row);
+        }
+    }
+    return out;
+}
+
+int PhotoTable::rowOf(const std::string& path) const {
+    auto it = std::lower_bound(paths.begin(), paths.end(), path);
+    return it == paths.end() || *it != path ? -1 : (int)(it - paths.begin());
+}
+
+const std::vector<std::uint32_t>& PhotoTable::order(SortKey k) {
+    auto& perm = orders[(std::size_t)k];
+    if (perm.size() == paths.size()) return perm;
+    perm.resize(paths.size());
+    std::iota(perm.begin(), perm.end(), 0u);
+    auto by = [&](const auto& col) {
+        std::stable_sort(perm.begin(), perm.end(), [&](std::uint32_t a, std::uint32_t b) { return col[a] < col[b]; });
+    };
+    if (k == SortKey::Date) by(taken);
+    else if (k == SortKey::Size) by(bytes);
+    else if (k == SortKey::Resolution) by(pixels);
+    return perm;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "library_index.hpp"
+#include "settings.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+class FavoritesSet;
+class MetadataStore;
+
+enum class Shape : std::uint8_t { Any, Landscape, Portrait, Square };
+
+// What the grid and viewer show: a conjunction of predicates plus an order.
+struct PhotoFilter {
+    bool favoritesOnly = false;
+    Shape shape = Shape::Any;
+    std::uint64_t minPixels = 0, maxPixels = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t minBytes = 0, maxBytes = std::numeric_limits<std::uint64_t>::max();
+    std::int64_t takenFrom = std::numeric_limits<std::int64_t>::min();     // unix seconds, [from, to)
+    std::int64_t takenTo = std::numeric_limits<std::int64_t>::max();
+    SortKey sort = SortKey::Name;
+    bool descending = false;
+};
+
+// Pulls filter tokens out of a search-box query and returns the words that are left for the
+// text search: fav, landscape / portrait / square, >12mp / <2mp, >5mb / <300kb, taken:2025
+// (or taken:2024-2025), sort:date / size / res / name (sort:-date for descending).
+std::string parsePhotoFilter(const std::string& query, PhotoFilter& f);
+
+// The library as a struct-of-arrays table, one row per file in path order, for filtering and
+// sorting without touching strings. Predicates run column by column into a byte mask (plain
+// loops the compiler vectorizes); each sort order is a row permutation computed on first use
+// and kept until the next build().
+class PhotoTable {
+public:
+    // files whose metadata has not been read yet have 0 x 0 and their mtime as capture time
+    void build(const std::vector<LibraryIndex::Entry>& library, MetadataStore& metadata, const FavoritesSet& favorites);
+
+    void setFavorite(const std::string& path, bool on);
+
+    // matching rows in f's order; `within` (ascending rows, e.g. text search hits) narrows the set
+    std::vector<std::uint32_t> select(const PhotoFilter& f, const std::vector<std::uint32_t>* within = nullptr);
+
+    std::size_t size() const { return paths.size(); }
+    const std::string& path(std::uint32_t row) const { return paths[row]; }
+    const std::vector<std::string>& allPaths() const { return paths; }
+
+private:
+    enum : std::uint8_t { FAVORITE = 1, LANDSCAPE = 2, PORTRAIT = 4, SQUARE = 8 };
+    static constexpr std::size_t SORT_KEYS = 4;
+
+    int rowOf(const std::string& path) const;
+    const std::vector<std::uint32_t>& order(SortKey k);
+
+    std::vector<std::string> paths;
+    std::vector<std::uint64_t> bytes;
+    std::vector<std::uint64_t> pixels;      // width * height
+    std::vector<std::int64_t> taken;        // capture time, unix seconds
+    std::vector<std::uint8_t> flags;
+
+    std::vector<std::uint32_t> orders[SORT_KEYS];
+    std::vector<std::uint8_t> mask;
+};
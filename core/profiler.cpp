@@ -0,0 +1,73 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+Profiler& Profiler::instance() {
+    static Profiler p;
+    return p;
+}
+
+void Profiler::enableTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lk(m);
+    tracePath = path;
+}
+
+void Profiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::lock_guard<std::mutex> lk(m);
+    auto& z = zones[name];
+    z.totalMs += ms;
+    z.calls++;
+    if (!tracePath.empty() && trace.size() < MAX_TRACE_EVENTS) {
+        trace.push_back(TraceEvent{name, threadId(), micros(start), micros(end) - micros(start)});
+    }
+}
+
+void Profiler::endFrame() {
+    auto end = Clock::now();
+    record("frame", frameStart, end);
+    std::lock_guard<std::mutex> lk(m);
+    frameMs[frameCount++ % FRAME_HISTORY] = std::chrono::duration<double, std::milli>(end - frameStart).count();
+    framesSinceReport++;
+}
+
+Profiler::Report Profiler::takeReport() {
+    std::lock_guard<std::mutex> lk(m);
+    Report r;
+    std::size_t n = std::min<std::uint64_t>(frameCount, FRAME_HISTORY);
+    std::vector<double> v(frameMs.begin(), frameMs.begin() + n);
+    std::sort(v.begin(), v.end());
+    auto pct = [&](double q) { return v.empty() ? 0.0 : v[std::min(v.size() - 1, (std::size_t)(q * (double)v.size()))]; };
+    r.p50 = pct(0.50);
+    r.p95 = pct(0.95);
+    r.p99 = pct(0.99);
+    r.maxMs = v.empty() ? 0.0 : v.back();
+    r.frames = framesSinceReport;
+    for (auto& [name, z] : zones) r.zones.push_back(ZoneStat{name, z.totalMs, z.calls});
+    std::sort(r.zones.begin(), r.zones.end(), [](const ZoneStat& a, const ZoneStat& b){ return a.totalMs > b.totalMs; });
+    zones.clear();
+    framesSinceReport = 0;
+    return r;
+}
+
+bool Profiler::writeTrace() {
+    std::lock_guard<std::mutex> lk(m);
+    if (tracePath.empty()) return false;
+    std::ofstream out(tracePath, std::ios::trunc);
+    out << "{\"traceEvents\":[\n";
+    for (std::size_t i = 0; i < trace.size(); i++) {
+        auto& e = trace[i];
+        out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+            << ",\"ts\":" << e.ts << ",\"dur\":" << e.dur << "}" << (i + 1 < trace.size() ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+    return (bool)out;
+}
+
+int Profiler::threadId() {
+    static std::atomic<int> next{1};
+    thread_local int id = next++;
+    return id;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Scoped timing zones (any thread) aggregated for the on-screen overlay, plus render-thread
+// frame times for percentiles. With enableTrace() every zone is also kept as a Chrome
+// trace_event ("ph":"X") and written out by writeTrace().
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct ZoneStat {
+        std::string name;
+        double totalMs = 0.0;
+        std::uint64_t calls = 0;
+    };
+    struct Report {
+        double p50 = 0, p95 = 0, p99 = 0, maxMs = 0;
+        std::uint64_t frames = 0;
+        std::vector<ZoneStat> zones;
+    };
+
+    static Profiler& instance();
+
+    void enableTrace(const std::string& path);
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+
+    void beginFrame() { frameStart = Clock::now(); }
+    void endFrame();
+
+    // frame percentiles over the recent history; zone totals since the previous report
+    Report takeReport();
+
+    bool writeTrace();
+
+private:
+    static constexpr std::size_t FRAME_HISTORY = 240;
+    static constexpr std::size_t MAX_TRACE_EVENTS = 2000000;
+
+    struct ZoneAcc {
+        double totalMs = 0.0;
+        std::uint64_t calls = 0;
+    };
+    struct TraceEvent {
+        const char* name;
+        int tid;
+        std::int64_t ts, dur;
+    };
+
+    Profiler() : origin(Clock::now()) {}
+
+    std::int64_t micros(Clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - origin).count();
+    }
+
+    static int threadId();
+
+    std::mutex m;
+    Clock::time_point origin;
+    Clock::time_point frameStart;
+    std::unordered_map<std::string, ZoneAcc> zones;
+    std::vector<double> frameMs = std::vector<double>(FRAME_HISTORY, 0.0);
+    std::uint64_t frameCount = 0;
+    std::uint64_t framesSinceReport = 0;
+    std::string tracePath;
+    std::vector<TraceEvent> trace;
+};
+
+struct ProfileZone {
+    const char* name;
+    Profiler::Clock::time_point start = Profiler::Clock::now();
+    explicit ProfileZone(const char* n) : name(n) {}
+    ~ProfileZone() { Profiler::instance().record(name, start, Profiler::Clock::now()); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
@@ -0,0 +1,133 @@
+#include "render_batch.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// ---------- atlas ----------
+TextureAtlas::TextureAtlas(unsigned slotSize, unsigned maxPages, RenderStats& stats)
+    : slotSize(slotSize), maxPages(std::max(1u, maxPages)), stats(stats) {
+    pageSize = std::min(2048u, sf::Texture::getMaximumSize()) / slotSize * slotSize;
+    slotsPerRow = pageSize / slotSize;
+    slotsPerPage = slotsPerRow * slotsPerRow;
+    if (!addPage()) return;
+
+    std::vector<std::uint8_t> white((std::size_t)slotSize * slotSize * 4, 255);
+    freeSlots.erase(std::find(freeSlots.begin(), freeSlots.end(), WHITE_SLOT));
+    upload(WHITE_SLOT, white.data());
+}
+
+int TextureAtlas::acquire() {
+    if (freeSlots.empty() && !addPage()) return -1;
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+}
+
+void TextureAtlas::release(int slot) {
+    if (slot > WHITE_SLOT) freeSlots.push_back(slot);
+}
+
+void TextureAtlas::upload(int slot, const std::uint8_t* rgba) {
+    unsigned i = (unsigned)slot % slotsPerPage;
+    pages[(std::size_t)pageOf(slot)]->update(rgba, {slotSize, slotSize},
+                                             {i % slotsPerRow * slotSize, i / slotsPerRow * slotSize});
+    stats.uploadBytes += (std::uint64_t)slotSize * slotSize * 4;
+}
+
+// inset by half a texel so smoothing never picks up the neighbouring slot
+sf::FloatRect TextureAtlas::texRect(int slot) const {
+    unsigned i = (unsigned)slot % slotsPerPage;
+    sf::Vector2f origin((float)(i % slotsPerRow * slotSize), (float)(i / slotsPerRow * slotSize));
+    if (slot == WHITE_SLOT) return {origin + sf::Vector2f((float)slotSize / 2.f, (float)slotSize / 2.f), {0.f, 0.f}};
+    return {origin + sf::Vector2f(0.5f, 0.5f), sf::Vector2f((float)slotSize - 1.f, (float)slotSize - 1.f)};
+}
+
+bool TextureAtlas::addPage() {
+    if (pages.size() >= maxPages || slotsPerPage == 0) return false;
+    auto page = std::make_unique<sf::Texture>();
+    if (!page->resize({pageSize, pageSize})) {
+        std::cout << "Texture atlas page unavailable (" << pageSize << " px)\n";
+        return false;
+    }
+    page->setSmooth(true);
+    int first = (int)(pages.size() * slotsPerPage);
+    pages.push_back(std::move(page));
+    for (int s = first + (int)slotsPerPage - 1; s >= first; s--) freeSlots.push_back(s);
+    return true;
+}
+
+// ---------- batch ----------
+void QuadBatch::rect(sf::FloatRect r, sf::Color c) {
+    sf::Vector2f a = r.position, b = r.position + r.size;
+    solid({a, {b.x, a.y}, b, {a.x, b.y}}, c);
+}
+
+void QuadBatch::outline(sf::FloatRect r, float thickness, sf::Color c) {
+    sf::Vector2f a = r.position - sf::Vector2f(thickness, thickness);
+    sf::Vector2f b = r.position + r.size + sf::Vector2f(thickness, thickness);
+    rect({a, {b.x - a.x, thickness}}, c);
+    rect({{a.x, b.y - thickness}, {b.x - a.x, thickness}}, c);
+    rect({{a.x, r.position.y}, {thickness, r.size.y}}, c);
+    rect({{b.x - thickness, r.position.y}, {thickness, r.size.y}}, c);
+}
+
+void QuadBatch::image(int slot, sf::FloatRect dst, sf::Color tint) {
+    sf::Vector2f a = dst.position, b = dst.position + dst.size;
+    quad(atlas.pageOf(slot), {a, {b.x, a.y}, b, {a.x, b.y}}, atlas.texRect(slot), tint);
+}
+
+void QuadBatch::add(const sf::RectangleShape& s) {
+    const sf::Transform& t = s.getTransform();
+    sf::Vector2f size = s.getSize();
+    auto pt = [&](float x, float y) { return t.transformPoint({x, y}); };
+    if (s.getFillColor().a > 0) solid({pt(0, 0), pt(size.x, 0), pt(size.x, size.y), pt(0, size.y)}, s.getFillColor());
+
+    // SFML draws a positive outline outside the shape: four strips around it
+    float o = s.getOutlineThickness();
+    sf::Color oc = s.getOutlineColor();
+    if (o <= 0.f || oc.a == 0) return;
+    solid({pt(-o, -o), pt(size.x + o, -o), pt(size.x + o, 0), pt(-o, 0)}, oc);
+    solid({pt(-o, size.y), pt(size.x + o, size.y), pt(size.x + o, size.y + o), pt(-o, size.y + o)}, oc);
+    solid({pt(-o, 0), pt(0, 0), pt(0, size.y), pt(-o, size.y)}, oc);
+    solid({pt(size.x, 0), pt(size.x + o, 0), pt(size.x + o, size.y), pt(size.x, size.y)}, oc);
+}
+
+// fill only, as a fan of triangles around the centre
+void QuadBatch::add(const sf::CircleShape& s) {
+    const sf::Transform& t = s.getTransform();
+    std::size_t n = s.getPointCount();
+    if (n < 3 || s.getFillColor().a == 0) return;
+    sf::Vector2f uv = atlas.whiteRect().position;
+    sf::Vector2f centre = t.transformPoint({s.getRadius(), s.getRadius()});
+    auto& va = layer(0);
+    for (std::size_t i = 0; i < n; i++) {
+        va.append({centre, s.getFillColor(), uv});
+        va.append({t.transformPoint(s.getPoint(i)), s.getFillColor(), uv});
+        va.append({t.transformPoint(s.getPoint((i + 1) % n)), s.getFillColor(), uv});
+    }
+}
+
+void QuadBatch::flush(sf::RenderTarget& target) {
+    for (std::size_t p = 0; p < layers.size(); p++) {
+        auto& va = layers[p];
+        if (va.getVertexCount() == 0) continue;
+        sf::RenderStates states;
+        states.texture = &atlas.page(p);
+        target.draw(va, states);
+        stats.drawCalls++;
+        stats.vertices += va.getVertexCount();
+        va.clear();
+    }
+}
+
+sf::VertexArray& QuadBatch::layer(int page) {
+    while (layers.size() <= (std::size_t)page) layers.emplace_back(sf::PrimitiveType::Triangles);
+    return layers[(std::size_t)page];
+}
+
+void QuadBatch::quad(int page, const sf::Vector2f (&p)[4], sf::FloatRect uv, sf::Color c) {
+    sf::Vector2f t0 = uv.position, t1 = uv.position + uv.size;
+    sf::Vector2f t[4] = {t0, {t1.x, t0.y}, t1, {t0.x, t1.y}};
+    auto& va = layer(page);
+    for (int i : {0, 1, 2, 0, 2, 3}) va.append({p[i], c, t[i]});
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <SFML/Graphics/CircleShape.hpp>
+#include <SFML/Graphics/RectangleShape.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// What one frame cost the GPU side: draw calls issued, vertices submitted, texel bytes uploaded.
+struct RenderStats {
+    std::uint64_t drawCalls = 0;
+    std::uint64_t vertices = 0;
+    std::uint64_t uploadBytes = 0;
+};
+
+// Square slots of slotSize pixels packed onto a few large textures ("pages"), so the grid's
+// thumbnails share textures instead of owning one each. Pages are added on demand up to
+// maxPages. The first slot of page 0 is solid white: untextured quads sample it, which lets
+// chrome rectangles and thumbnails go out in the same draw call.
+class TextureAtlas {
+public:
+    TextureAtlas(unsigned slotSize, unsigned maxPages, RenderStats& stats);
+
+    // -1 when every page is full
+    int acquire();
+    void release(int slot);
+    // slotSize x slotSize RGBA
+    void upload(int slot, const std::uint8_t* rgba);
+
+    int pageOf(int slot) const { return slot / (int)slotsPerPage; }
+    sf::FloatRect texRect(int slot) const;
+    sf::FloatRect whiteRect() const { return texRect(WHITE_SLOT); }
+
+    std::size_t pageCount() const { return pages.size(); }
+    const sf::Texture& page(std::size_t i) const { return *pages[i]; }
+
+private:
+    static constexpr int WHITE_SLOT = 0;
+
+    bool addPage();
+
+    unsigned slotSize;
+    unsigned pageSize;
+    unsigned slotsPerRow;
+    unsigned slotsPerPage;
+    unsigned maxPages;
+    RenderStats& stats;
+    std::vector<std::unique_ptr<sf::Texture>> pages;
+    std::vector<int> freeSlots;             // lowest id at the back
+};
+
+// Collects textured and solid quads and submits them as one vertex array per atlas page.
+// Quads on the same page keep the order they were added in; flush() between layers that
+// overlap (e.g. the grid, then the bar on top of it).
+class QuadBatch {
+public:
+    QuadBatch(TextureAtlas& atlas, RenderStats& stats) : atlas(atlas), stats(stats) {}
+
+    void rect(sf::FloatRect r, sf::Color c);
+    // a border `thickness` wide just outside r, where sf::Shape draws a positive outline
+    void outline(sf::FloatRect r, float thickness, sf::Color c);
+    void image(int slot, sf::FloatRect dst, sf::Color tint = sf::Color::White);
+    // fill and outline of a retained shape, with its transform applied
+    void add(const sf::RectangleShape& s);
+    void add(const sf::CircleShape& s);
+
+    void flush(sf::RenderTarget& target);
+
+private:
+    sf::VertexArray& layer(int page);
+    void quad(int page, const sf::Vector2f (&p)[4], sf::FloatRect uv, sf::Color c);
+    void solid(const sf::Vector2f (&p)[4], sf::Color c) { quad(0, p, atlas.whiteRect(), c); }
+
+    TextureAtlas& atlas;
+    RenderStats& stats;
+    std::vector<sf::VertexArray> layers;    // one per atlas page
+};
@@ -0,0 +1,350 @@
+#include "scanner.hpp"
+#include "profiler.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+bool startsWith(const unsigned char* p, std::size_t n, const char* sig, std::size_t len) {
+    return n >= len && std::memcmp(p, sig, len) == 0;
+}
+
+// ISO base media file: the ftyp box's major brand, then the compatible brands after it
+ImageFormat isoBrand(const unsigned char* p, std::size_t n) {
+    if (n < 12 || std::memcmp(p + 4, "ftyp", 4) != 0) return ImageFormat::Unknown;
+    std::size_t box = ((std::size_t)p[0] << 24) | ((std::size_t)p[1] << 16) | ((std::size_t)p[2] << 8) | p[3];
+    std::size_t end = std::min(n, std::max<std::size_t>(box, 12));
+    ImageFormat found = ImageFormat::Unknown;
+    for (std::size_t at = 8; at + 4 <= end; at += at == 8 ? 8 : 4) {   // skip minor_version
+        const char* b = (const char*)p + at;
+        if (!std::memcmp(b, "avif", 4) || !std::memcmp(b, "avis", 4)) return ImageFormat::Avif;
+        if (!std::memcmp(b, "heic", 4) || !std::memcmp(b, "heix", 4) || !std::memcmp(b, "hevc", 4) ||
+            !std::memcmp(b, "hevx", 4) || !std::memcmp(b, "heim", 4) || !std::memcmp(b, "heis", 4) ||
+            !std::memcmp(b, "mif1", 4) || !std::memcmp(b, "msf1", 4))
+            found = ImageFormat::Heif;
+    }
+    return found;
+}
+
+bool isoBrandIs(const unsigned char* p, std::size_t n, const char* brand) {
+    return n >= 12 && std::memcmp(p + 4, "ftyp", 4) == 0 && std::memcmp(p + 8, brand, 4) == 0;
+}
+
+std::int64_t mtimeNanos(const struct stat& st) {
+#if defined(__APPLE__)
+    return (std::int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (std::int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+// a file from the last scan is still the one listed: same inode, size and mtime (stat'ed the
+// way sniffFiles does, through symlinks); an edit in place changes neither the directory's
+// mtime nor the inode
+bool stillListed(int dfd, const char* name, const LibraryIndex::Entry& e) {
+    struct stat st {};
+    return fstatat(dfd, name, &st, 0) == 0 && S_ISREG(st.st_mode) && (std::uint64_t)st.st_ino == e.inode &&
+           (std::uint64_t)st.st_size == e.size && (std::int64_t)st.st_mtime == e.mtime;
+}
+
+} // namespace
+
+ImageFormat sniffImageFormat(const unsigned char* p, std::size_t n) {
+    if (startsWith(p, n, "\xFF\xD8\xFF", 3)) return ImageFormat::Jpeg;
+    if (startsWith(p, n, "\x89PNG\r\n\x1A\n", 8)) return ImageFormat::Png;
+    if (startsWith(p, n, "GIF87a", 6) || startsWith(p, n, "GIF89a", 6)) return ImageFormat::Gif;
+    // "BM" alone is too weak; the two reserved header words are zero in every real bitmap
+    if (startsWith(p, n, "BM", 2) && n >= 14 && !p[6] && !p[7] && !p[8] && !p[9]) return ImageFormat::Bmp;
+    if (startsWith(p, n, "RIFF", 4) && n >= 12 && !std::memcmp(p + 8, "WEBP", 4)) return ImageFormat::WebP;
+    return isoBrand(p, n);
+}
+
+ImageFormat sniffImageFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return ImageFormat::Unknown;
+    unsigned char head[32];
+    ssize_t n = pread(fd, head, sizeof(head), 0);
+    close(fd);
+    return n > 0 ? sniffImageFormat(head, (std::size_t)n) : ImageFormat::Unknown;
+}
+
+bool isDecodableFormat(ImageFormat f) {
+    return f == ImageFormat::Jpeg || f == ImageFormat::Png || f == ImageFormat::Gif || f == ImageFormat::Bmp;
+}
+
+bool extensionMatches(const std::string& path, ImageFormat f) {
+    auto dot = path.find_last_of("./");
+    if (dot == std::string::npos || path[dot] != '.') return false;
+    std::string ext = toLower(path.substr(dot + 1));
+    switch (f) {
+        case ImageFormat::Jpeg: return ext == "jpg" || ext == "jpeg" || ext == "jpe" || ext == "jfif";
+        case ImageFormat::Png:  return ext == "png";
+        case ImageFormat::Gif:  return ext == "gif";
+        case ImageFormat::Bmp:  return ext == "bmp" || ext == "dib";
+        case ImageFormat::WebP: return ext == "webp";
+        case ImageFormat::Heif: return ext == "heic" || ext == "heif" || ext == "hif";
+        case ImageFormat::Avif: return ext == "avif";
+        default: return false;
+    }
+}
+
+const char* formatName(ImageFormat f) {
+    switch (f) {
+        case ImageFormat::Jpeg: return "JPEG";
+        case ImageFormat::Png:  return "PNG";
+        case ImageFormat::Gif:  return "GIF";
+        case ImageFormat::Bmp:  return "BMP";
+        case ImageFormat::WebP: return "WebP";
+        case ImageFormat::Heif: return "HEIF";
+        case ImageFormat::Avif: return "AVIF";
+        default: return "unknown";
+    }
+}
+
+VideoFormat sniffVideoFormat(const unsigned char* p, std::size_t n) {
+    if (startsWith(p, n, "\x1A\x45\xDF\xA3", 4)) return VideoFormat::Matroska;
+    if (startsWith(p, n, "RIFF", 4) && n >= 12 && !std::memcmp(p + 8, "AVI ", 4)) return VideoFormat::Avi;
+    if (n < 12 || std::memcmp(p + 4, "ftyp", 4) != 0 || isoBrand(p, n) != ImageFormat::Unknown) {
+        // old QuickTime files may start with the movie box itself
+        if (n >= 8 && (!std::memcmp(p + 4, "moov", 4) || !std::memcmp(p + 4, "mdat", 4) ||
+                       !std::memcmp(p + 4, "wide", 4))) return VideoFormat::QuickTime;
+        return VideoFormat::Unknown;
+    }
+    return isoBrandIs(p, n, "qt  ") ? VideoFormat::QuickTime : VideoFormat::Mp4;
+}
+
+std::int64_t dirMtimeNanos(const std::string& dir) {
+    struct stat st {};
+    return stat(dir.c_str(), &st) == 0 ? mtimeNanos(st) : -1;
+}
+
+// ---------- TreeScanner ----------
+TreeScanner::TreeScanner(const std::string& root, unsigned threads, std::shared_ptr<const Known> known, MediaKind kind)
+    : known(std::move(known)), kind(kind), started(std::chrono::steady_clock::now()) {
+    if (threads == 0) threads = 1;
+    std::string dir = root;
+    while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+
+    for (unsigned i = 0; i < threads; i++) queues.push_back(std::make_unique<Queue>());
+    pending = 1;
+    queues[0]->tasks.push_back(Task{dir, {}});
+    running = threads;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this, i]{ workerLoop(i); });
+}
+
+TreeScanner::~TreeScanner() {
+    stopping = true;
+    idleCv.notify_all();
+    wait();
+}
+
+void TreeScanner::wait() {
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+}
+
+TreeScanner::Batch TreeScanner::take() {
+    std::lock_guard<std::mutex> lk(resultM);
+    Batch b = std::move(found);
+    found = {};
+    return b;
+}
+
+TreeScanner::Stats TreeScanner::stats() const {
+    std::lock_guard<std::mutex> lk(resultM);
+    return totals;
+}
+
+void TreeScanner::workerLoop(unsigned self) {
+    Task t;
+    while (!stopping) {
+        if (next(self, t)) {
+            if (t.names.empty()) listDir(self, t.dir);
+            else sniffFiles(t.dir, t.names);
+            if (--pending == 0) idleCv.notify_all();
+            continue;
+        }
+        // nothing to steal: either everything is done, or the others are still listing
+        std::unique_lock<std::mutex> lk(idleM);
+        if (pending == 0) break;
+        idleCv.wait_for(lk, std::chrono::milliseconds(2));
+    }
+    if (--running == 0) {
+        std::lock_guard<std::mutex> lk(resultM);
+        totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        finished = true;
+    }
+}
+
+// own deque from the back; otherwise steal from the front of the next non-empty one
+bool TreeScanner::next(unsigned self, Task& t) {
+    for (std::size_t i = 0; i < queues.size(); i++) {
+        Queue& q = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lk(q.m);
+        if (q.tasks.empty()) continue;
+        if (i == 0) {
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void TreeScanner::push(unsigned self, Task t) {
+    pending++;
+    {
+        std::lock_guard<std::mutex> lk(queues[self]->m);
+        queues[self]->tasks.push_back(std::move(t));
+    }
+    idleCv.notify_one();
+}
+
+void TreeScanner::publish(Batch& b, const Stats& s) {
+    std::lock_guard<std::mutex> lk(resultM);
+    found.files.insert(found.files.end(), std::make_move_iterator(b.files.begin()), std::make_move_iterator(b.files.end()));
+    found.dirs.insert(found.dirs.end(), std::make_move_iterator(b.dirs.begin()), std::make_move_iterator(b.dirs.end()));
+    totals.dirs += s.dirs;
+    totals.listed += s.listed;
+    totals.files += s.files;
+    totals.opened += s.opened;
+    totals.images += s.images;
+    totals.mislabeled += s.mislabeled;
+    totals.unsupported += s.unsupported;
+    b = {};
+}
+
+void TreeScanner::listDir(unsigned self, const std::string& dir) {
+    PROFILE_ZONE("scan dir");
+    struct stat st {};
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return;
+
+    Batch out;
+    Stats s;
+    s.dirs = 1;
+    const Known::Dir* prev = nullptr;
+    if (known) {
+        auto it = known->dirs.find(dir);
+        if (it != known->dirs.end()) prev = &it->second;
+    }
+    std::vector<std::string> run;
+    auto queueSniff = [&](const char* name) {
+        run.push_back(name);
+        if (run.size() == SNIFF_RUN) {
+            push(self, Task{dir, std::move(run)});
+            run.clear();
+        }
+    };
+    if (prev && prev->mtime == mtimeNanos(st)) {
+        for (auto& sub : prev->subdirs) push(self, Task{sub, {}});
+        out.dirs.push_back({dir, prev->mtime});
+        // nothing was added or removed, but each file is still stat'ed (not opened)
+        int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        for (auto& e : prev->files) {
+            const char* name = e.path.c_str() + e.path.rfind('/') + 1;
+            if (dfd >= 0 && stillListed(dfd, name, e)) {
+                out.files.push_back(e);
+                s.images++;
+            } else {
+                queueSniff(name);
+            }
+        }
+        if (dfd >= 0) close(dfd);
+        publish(out, s);
+        if (!run.empty()) sniffFiles(dir, run);
+        return;
+    }
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    s.listed = 1;
+    std::unordered_map<std::string, const LibraryIndex::Entry*> prevFiles;
+    if (prev) {
+        for (auto& e : prev->files) prevFiles[e.path] = &e;
+    }
+
+    int dfd = dirfd(d);
+    while (dirent* de = readdir(d)) {
+        if (de->d_name[0] == '.') continue;   // ".", ".." and hidden entries
+        unsigned char type = de->d_type;
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            struct stat lst {};
+            if (fstatat(dfd, de->d_name, &lst, type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW) != 0) continue;
+            // a symlinked directory could lead back up the tree
+            if (S_ISDIR(lst.st_mode) && type == DT_LNK) continue;
+            type = S_ISDIR(lst.st_mode) ? DT_DIR : S_ISREG(lst.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        std::string path = dir + "/" + de->d_name;
+        if (type == DT_DIR) {
+            push(self, Task{std::move(path), {}});
+            continue;
+        }
+        if (type != DT_REG) continue;
+        s.files++;
+
+        // d_ino rules out a replaced file without a stat; a match is confirmed by one
+        auto it = prevFiles.find(path);
+        if (it != prevFiles.end() && (de->d_type == DT_LNK || it->second->inode == (std::uint64_t)de->d_ino) &&
+            stillListed(dfd, de->d_name, *it->second)) {
+            out.files.push_back(*it->second);
+            s.images++;
+            continue;
+        }
+        queueSniff(de->d_name);
+    }
+    closedir(d);
+
+    out.dirs.push_back({dir, mtimeNanos(st)});
+    publish(out, s);
+    // the last short run stays on this thread
+    if (!run.empty()) sniffFiles(dir, run);
+}
+
+void TreeScanner::sniffFiles(const std::string& dir, const std::vector<std::string>& names) {
+    PROFILE_ZONE("sniff files");
+    Batch out;
+    Stats s;
+    unsigned char head[32];
+    for (auto& name : names) {
+        if (stopping) break;
+        std::string path = dir + "/" + name;
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        struct stat st {};
+        ssize_t n = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? pread(fd, head, sizeof(head), 0) : -1;
+        close(fd);
+        s.opened++;
+        if (n <= 0) continue;
+
+        if (kind == MediaKind::Videos) {
+            if (sniffVideoFormat(head, (std::size_t)n) == VideoFormat::Unknown) continue;
+        } else {
+            ImageFormat f = sniffImageFormat(head, (std::size_t)n);
+            if (f == ImageFormat::Unknown) continue;
+            if (!extensionMatches(path, f)) s.mislabeled++;
+            if (!isDecodableFormat(f)) {
+                s.unsupported++;
+                continue;
+            }
+        }
+        LibraryIndex::Entry e;
+        e.path = std::move(path);
+        e.size = (std::uint64_t)st.st_size;
+        e.mtime = (std::int64_t)st.st_mtime;
+        e.inode = (std::uint64_t)st.st_ino;
+        out.files.push_back(std::move(e));
+        s.images++;
+    }
+    publish(out, s);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "library_index.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum class ImageFormat { Unknown, Jpeg, Png, Gif, Bmp, WebP, Heif, Avif };
+enum class VideoFormat { Unknown, Mp4, QuickTime, Matroska, Avi };
+
+// Format from the first bytes of a file; 12 are enough for every signature below.
+ImageFormat sniffImageFormat(const unsigned char* head, std::size_t n);
+ImageFormat sniffImageFile(const std::string& path);
+// formats the decoder can open (SFML's loaders); HEIF, AVIF and WebP are only recognized
+bool isDecodableFormat(ImageFormat f);
+// true if the file name's extension (any case) is one used for f
+bool extensionMatches(const std::string& path, ImageFormat f);
+const char* formatName(ImageFormat f);
+
+// MP4/M4V/3GP, QuickTime, Matroska/WebM and AVI containers; HEIF and AVIF stills are not videos
+VideoFormat sniffVideoFormat(const unsigned char* head, std::size_t n);
+
+// a directory's mtime in nanoseconds, the unit scans record; -1 if it cannot be read
+std::int64_t dirMtimeNanos(const std::string& dir);
+
+// Walks a directory tree on several threads and reports every decodable image (or, for
+// MediaKind::Videos, every video) in it, judged by content rather than by extension. Each worker keeps its own deque of tasks (a directory
+// to list, or a run of new files in one to sniff): it takes the newest from the back (depth
+// first, warm dentries), and an idle worker steals the oldest from the front of another's,
+// which is usually the biggest untouched subtree. A flat folder of 100k files is split into
+// sniff runs, so it spreads over the cores as well.
+// Results are handed out in batches while the walk runs (take()), so callers can show the
+// first images long before a large tree is finished. Hidden entries and symlinked
+// directories are skipped.
+class TreeScanner {
+public:
+    // what an earlier scan found: a directory whose mtime is unchanged is not listed again
+    // (its files and subdirectories are taken from here), and a file whose inode, size and
+    // mtime are unchanged is not opened again (it is only stat'ed)
+    struct Known {
+        struct Dir {
+            std::int64_t mtime = 0;
+            std::vector<std::string> subdirs;
+            std::vector<LibraryIndex::Entry> files;
+        };
+        std::unordered_map<std::string, Dir> dirs;
+    };
+
+    struct DirRecord {
+        std::string path;
+        std::int64_t mtime = 0;   // nanoseconds
+    };
+
+    struct Batch {
+        std::vector<LibraryIndex::Entry> files;
+        std::vector<DirRecord> dirs;
+    };
+
+    struct Stats {
+        std::size_t dirs = 0, listed = 0;   // seen / actually read with readdir
+        std::size_t files = 0, opened = 0;  // regular files seen / headers read
+        std::size_t images = 0;             // files reported (videos, when scanning for those)
+        std::size_t mislabeled = 0;         // extension disagrees with the content
+        std::size_t unsupported = 0;        // recognized image formats we cannot decode
+        double seconds = 0.0;
+    };
+
+    // starts right away; `known` may be null (everything is listed and sniffed)
+    TreeScanner(const std::string& root, unsigned threads, std::shared_ptr<const Known> known = nullptr,
+                MediaKind kind = MediaKind::Images);
+    // stops early if still running
+    ~TreeScanner();
+
+    TreeScanner(const TreeScanner&) = delete;
+    TreeScanner& operator=(const TreeScanner&) = delete;
+
+    // everything found since the last call, in no particular order
+    Batch take();
+    bool done() const { return finished.load(); }
+    void wait();
+    Stats stats() const;
+
+private:
+    static constexpr std::size_t SNIFF_RUN = 256;
+
+    struct Task {
+        std::string dir;
+        std::vector<std::string> names;   // empty: list dir; otherwise sniff these files in it
+    };
+
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned self);
+    bool next(unsigned self, Task& t);
+    void push(unsigned self, Task t);
+    void listDir(unsigned self, const std::string& dir);
+    void sniffFiles(const std::string& dir, const std::vector<std::string>& names);
+    void publish(Batch& b, const Stats& s);
+
+    std::shared_ptr<const Known> known;
+    MediaKind kind;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<std::size_t> pending{0};   // tasks queued or running
+    std::atomic<unsigned> running{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> finished{false};
+
+    std::mutex idleM;
+    std::condition_variable idleCv;
+
+    mutable std::mutex resultM;
+    Batch found;
+    Stats totals;
+    std::chrono::steady_clock::time_point started;
+
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,99 @@
+#include "search_index.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+void SearchIndex::build(const std::vector<std::string>& input) {
+    blob.clear();
+    offsets.assign(1, 0);
+    grams.clear();
+    haveLast = false;
+
+    for (std::uint32_t id = 0; id < (std::uint32_t)input.size(); id++) {
+        std::string t = foldCase(input[id]);
+        blob += t;
+        offsets.push_back((std::uint32_t)blob.size());
+        for (int n = 1; n <= 3; n++) {
+            for (std::size_t i = 0; i + n <= t.size(); i++) {
+                auto& list = grams[gramKey(t.data() + i, n)];
+                // ids arrive in order, so a repeat within one text is always at the back
+                if (list.empty() || list.back() != id) list.push_back(id);
+            }
+        }
+    }
+}
+
+void SearchIndex::filterTerm(const std::string& term, std::vector<std::uint32_t>& ids, bool fromAll) const {
+    int n = (int)std::min<std::size_t>(term.size(), 3);
+    std::vector<const std::vector<std::uint32_t>*> lists;
+    for (std::size_t i = 0; i + n <= term.size(); i++) {
+        auto it = grams.find(gramKey(term.data() + i, n));
+        if (it == grams.end()) {
+            ids.clear();
+            return;
+        }
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](auto* a, auto* b){ return a->size() < b->size(); });
+
+    // start from the rarest gram; intersect further lists only while they are not much
+    // longer than what is left, after that a direct check of the survivors is cheaper
+    std::vector<std::uint32_t> out, tmp;
+    if (fromAll) out = *lists[0];
+    else std::set_intersection(ids.begin(), ids.end(), lists[0]->begin(), lists[0]->end(), std::back_inserter(out));
+    for (std::size_t k = 1; k < lists.size() && !out.empty() && lists[k]->size() <= out.size() * 4; k++) {
+        tmp.clear();
+        std::set_intersection(out.begin(), out.end(), lists[k]->begin(), lists[k]->end(), std::back_inserter(tmp));
+        out.swap(tmp);
+    }
+
+    // a term of at most 3 bytes is its own gram, so the posting list is exact
+    if ((int)term.size() > n) {
+        tmp.clear();
+        for (std::uint32_t id : out) {
+            if (text(id).find(term) != std::string_view::npos) tmp.push_back(id);
+        }
+        out.swap(tmp);
+    }
+    ids.swap(out);
+}
+
+const std::vector<std::uint32_t>& SearchIndex::query(const std::string& q) {
+    std::string folded = foldCase(q);
+    std::vector<std::string> terms;
+    {
+        std::istringstream ss(folded);
+        std::string t;
+        while (ss >> t) terms.push_back(t);
+    }
+
+    // typing more characters only narrows: reuse the last result and re-check the terms
+    // that are new or grew
+    std::size_t firstChanged = 0;
+    bool incremental = haveLast && folded.compare(0, lastQuery.size(), lastQuery) == 0 && !lastTerms.empty();
+    if (incremental) {
+        firstChanged = lastTerms.size() - 1;
+        if (firstChanged < terms.size() && terms[firstChanged] == lastTerms[firstChanged]) firstChanged++;
+    } else {
+        lastResult.clear();
+    }
+
+    if (terms.empty()) {
+        lastResult.resize(size());
+        for (std::uint32_t i = 0; i < (std::uint32_t)lastResult.size(); i++) lastResult[i] = i;
+    } else if (!incremental) {
+        // the longest term is usually the most selective, so it goes first
+        std::vector<std::string> order = terms;
+        std::sort(order.begin(), order.end(), [](const std::string& a, const std::string& b){ return a.size() > b.size(); });
+        filterTerm(order[0], lastResult, true);
+        for (std::size_t i = 1; i < order.size() && !lastResult.empty(); i++) filterTerm(order[i], lastResult, false);
+    } else {
+        for (std::size_t i = firstChanged; i < terms.size() && !lastResult.empty(); i++) filterTerm(terms[i], lastResult, false);
+    }
+
+    lastQuery = folded;
+    lastTerms = std::move(terms);
+    haveLast = true;
+    return lastResult;
+}
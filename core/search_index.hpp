@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Substring search over a fixed list of texts (file name + caption per photo). Every text is
+// case-folded and broken into 1-, 2- and 3-byte grams; a query term is answered by intersecting
+// the posting lists of its grams and then checking the few survivors with a plain find().
+// Query terms are separated by spaces and must all match. A query that extends the previous
+// one (the usual case while typing) starts from the previous results and only checks the
+// terms that changed.
+class SearchIndex {
+public:
+    void build(const std::vector<std::string>& texts);
+
+    // ids (positions in the build() list) of matching texts, ascending
+    const std::vector<std::uint32_t>& query(const std::string& q);
+
+    std::size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+private:
+    static std::uint32_t gramKey(const char* p, int n) {
+        std::uint32_t k = (std::uint32_t)n << 24;
+        for (int i = 0; i < n; i++) k |= (std::uint32_t)(unsigned char)p[i] << (8 * i);
+        return k;
+    }
+
+    std::string_view text(std::uint32_t id) const {
+        return std::string_view(blob.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    // narrows `ids` (ascending) to the texts containing term
+    void filterTerm(const std::string& term, std::vector<std::uint32_t>& ids, bool fromAll) const;
+
+    std::string blob;                       // all folded texts back to back
+    std::vector<std::uint32_t> offsets;     // text i is blob[offsets[i], offsets[i + 1])
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> grams;
+
+    std::string lastQuery;
+    std::vector<std::string> lastTerms;
+    std::vector<std::uint32_t> lastResult;
+    bool haveLast = false;
+};
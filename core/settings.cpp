@@ -0,0 +1,63 @@
+#include "settings.hpp"
+#include "catalog.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+void apply(Settings& s, const std::string& key, const std::string& val) {
+    if (key == "darkTheme") s.darkTheme = (val == "1");
+    if (key == "fontSizeTitle") s.fontSizeTitle = std::stoi(val);
+    if (key == "fontSizeMenu")  s.fontSizeMenu  = std::stoi(val);
+    if (key == "showFavoritesOnly") s.showFavoritesOnly = (val == "1");
+    if (key == "lang") s.lang = (val == "RU") ? Lang::RU : Lang::EN;
+    if (key == "cacheRamMB")  s.cacheRamMB  = std::stoi(val);
+    if (key == "cacheVramMB") s.cacheVramMB = std::stoi(val);
+    if (key == "sortKey") s.sortKey = (SortKey)std::clamp(std::stoi(val), 0, 3);
+    if (key == "sortDescending") s.sortDescending = (val == "1");
+}
+
+} // namespace
+
+Settings loadSettings(const Catalog& catalog) {
+    Settings s;
+    catalog.forEach(CatalogTable::Settings, [&](std::string_view key, std::string_view val) {
+        // a value that does not parse keeps the default
+        try {
+            apply(s, std::string(key), std::string(val));
+        } catch (...) {
+        }
+    });
+    return s;
+}
+
+void saveSettings(Catalog& catalog, const Settings& s) {
+    auto put = [&](const char* key, const std::string& val) { catalog.put(CatalogTable::Settings, key, val); };
+    put("darkTheme", s.darkTheme ? "1" : "0");
+    put("fontSizeTitle", std::to_string(s.fontSizeTitle));
+    put("fontSizeMenu", std::to_string(s.fontSizeMenu));
+    put("showFavoritesOnly", s.showFavoritesOnly ? "1" : "0");
+    put("lang", s.lang == Lang::RU ? "RU" : "EN");
+    put("cacheRamMB", std::to_string(s.cacheRamMB));
+    put("cacheVramMB", std::to_string(s.cacheVramMB));
+    put("sortKey", std::to_string((int)s.sortKey));
+    put("sortDescending", s.sortDescending ? "1" : "0");
+}
+
+void importSettingsFile(Catalog& catalog, const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return;
+
+    Settings s;
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (line.empty()) continue;
+        auto pos = line.find('=');
+        if (pos == std::string::npos) continue;
+        apply(s, trim(line.substr(0, pos)), trim(line.substr(pos + 1)));
+    }
+    saveSettings(catalog, s);
+}
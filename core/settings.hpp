@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+class Catalog;
+
+enum class Lang { EN, RU };
+enum class SortKey : int { Name, Date, Size, Resolution };
+
+struct Settings {
+    bool darkTheme = true;
+    int  fontSizeTitle = 44;
+    int  fontSizeMenu  = 22;
+    bool showFavoritesOnly = false;
+    Lang lang = Lang::EN;
+    int  cacheRamMB  = 512;
+    int  cacheVramMB = 256;
+    SortKey sortKey = SortKey::Name;
+    bool sortDescending = false;
+};
+
+// one catalog record per field; saving only logs the fields that changed
+Settings loadSettings(const Catalog& catalog);
+void saveSettings(Catalog& catalog, const Settings& s);
+
+// the old settings.txt ("key=value" lines), read once into a fresh catalog
+void importSettingsFile(Catalog& catalog, const std::string& path);
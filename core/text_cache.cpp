@@ -0,0 +1,135 @@
+#include "text_cache.hpp"
+#include "profiler.hpp"
+
+#include <SFML/System/String.hpp>
+
+#include <algorithm>
+
+namespace {
+
+std::u32string decodeUtf8(const std::string& s) {
+    return sf::String::fromUtf8(s.begin(), s.end()).toUtf32();
+}
+
+} // namespace
+
+const TextLayout& TextCache::get(const std::string& utf8, unsigned size) {
+    std::string key = std::to_string(size);
+    key += '\0';
+    key += utf8;
+    auto it = layouts.find(key);
+    if (it != layouts.end()) {
+        recent.splice(recent.begin(), recent, it->second.use);
+        return it->second.layout;
+    }
+
+    PROFILE_ZONE("glyph layout");
+    if (layouts.size() >= MAX_ENTRIES) {
+        layouts.erase(layouts.find(*recent.back()));
+        recent.pop_back();
+        gen++;
+    }
+    it = layouts.emplace(std::move(key), Entry{}).first;
+    recent.push_front(&it->first);
+    it->second.use = recent.begin();
+    layout(decodeUtf8(utf8), size, it->second.layout);
+    return it->second.layout;
+}
+
+void TextCache::prewarm(const std::vector<std::string>& strings, const std::vector<unsigned>& sizes) {
+    std::u32string all;
+    for (auto& s : strings) all += decodeUtf8(s);
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+    for (unsigned size : sizes) {
+        for (char32_t c : all) {
+            if (c != U'\n' && c != U'\r' && c != U'\t') (void)font.getGlyph(c, size, false);
+        }
+    }
+}
+
+void TextCache::clear() {
+    layouts.clear();
+    recent.clear();
+    gen++;
+}
+
+// mirrors sf::Text's geometry update (no style, no outline, default letter and line spacing)
+void TextCache::layout(const std::u32string& text, unsigned size, TextLayout& out) const {
+    out.vertices.clear();
+    out.bounds = {};
+    if (text.empty()) return;
+
+    float whitespace = font.getGlyph(U' ', size, false).advance;
+    float lineSpacing = font.getLineSpacing(size);
+    float x = 0.f, y = (float)size;
+    float minX = (float)size, minY = (float)size, maxX = 0.f, maxY = 0.f;
+    char32_t prev = 0;
+    out.vertices.reserve(text.size() * 6);
+
+    for (char32_t c : text) {
+        if (c == U'\r') continue;
+        x += font.getKerning(prev, c, size, false);
+        prev = c;
+
+        if (c == U' ' || c == U'\n' || c == U'\t') {
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            if (c == U' ') x += whitespace;
+            else if (c == U'\t') x += whitespace * 4.f;
+            else {
+                y += lineSpacing;
+                x = 0.f;
+            }
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+            continue;
+        }
+
+        const sf::Glyph& g = font.getGlyph(c, size, false);
+        // one pixel of padding around each glyph, as sf::Text does, so smoothing has room
+        const float pad = 1.f;
+        float left = g.bounds.position.x - pad, top = g.bounds.position.y - pad;
+        float right = g.bounds.position.x + g.bounds.size.x + pad, bottom = g.bounds.position.y + g.bounds.size.y + pad;
+        float u1 = (float)g.textureRect.position.x - pad, v1 = (float)g.textureRect.position.y - pad;
+        float u2 = (float)(g.textureRect.position.x + g.textureRect.size.x) + pad;
+        float v2 = (float)(g.textureRect.position.y + g.textureRect.size.y) + pad;
+        sf::Vertex quad[4] = {
+            {{x + left, y + top}, sf::Color::White, {u1, v1}},
+            {{x + right, y + top}, sf::Color::White, {u2, v1}},
+            {{x + left, y + bottom}, sf::Color::White, {u1, v2}},
+            {{x + right, y + bottom}, sf::Color::White, {u2, v2}},
+        };
+        for (int i : {0, 1, 2, 2, 1, 3}) out.vertices.push_back(quad[i]);
+
+        minX = std::min(minX, x + g.bounds.position.x);
+        maxX = std::max(maxX, x + g.bounds.position.x + g.bounds.size.x);
+        minY = std::min(minY, y + g.bounds.position.y);
+        maxY = std::max(maxY, y + g.bounds.position.y + g.bounds.size.y);
+        x += g.advance;
+    }
+    out.bounds = {{minX, minY}, {maxX - minX, maxY - minY}};
+}
+
+void TextBatch::add(const TextLayout& t, unsigned size, sf::Vector2f pos, sf::Color color) {
+    if (t.vertices.empty()) return;
+    auto it = bySize.find(size);
+    if (it == bySize.end()) it = bySize.emplace(size, sf::VertexArray(sf::PrimitiveType::Triangles)).first;
+    for (sf::Vertex v : t.vertices) {
+        v.position += pos;
+        v.color = color;
+        it->second.append(v);
+    }
+}
+
+void TextBatch::flush(sf::RenderTarget& target) {
+    for (auto& [size, va] : bySize) {
+        if (va.getVertexCount() == 0) continue;
+        sf::RenderStates states;
+        states.texture = &font.getTexture(size);
+        target.draw(va, states);
+        stats.drawCalls++;
+        stats.vertices += va.getVertexCount();
+        va.clear();
+    }
+}
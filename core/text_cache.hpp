@@ -0,0 +1,116 @@
+#pragma once
+
+#include "render_batch.hpp"
+
+#include <SFML/Graphics/Font.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Glyph quads of one UTF-8 string at one character size, placed the way sf::Text places them
+// (first baseline at y = size, '\n' starts a new line). Vertices are white; the colour is
+// applied when the layout is drawn, so a theme change does not touch the cache.
+struct TextLayout {
+    std::vector<sf::Vertex> vertices;   // triangles, in the font page's pixel coordinates
+    sf::FloatRect bounds;               // what sf::Text::getLocalBounds() would return
+};
+
+// Layouts keyed by (string, size) for one font. Glyphs stay on the font's pages once
+// rasterized, so a layout never goes stale; past MAX_ENTRIES the least recently fetched one
+// is evicted, which is a string that changes (a counter, a file name) rather than a label
+// that is on screen: those are fetched again whenever the generation moves.
+class TextCache {
+public:
+    static constexpr std::size_t MAX_ENTRIES = 2048;
+
+    explicit TextCache(const sf::Font& font) : font(font) {}
+
+    const TextLayout& get(const std::string& utf8, unsigned size);
+
+    // rasterizes every code point of `strings` at every size up front, so the first frame
+    // that shows them (e.g. after switching language) does not stall on FreeType
+    void prewarm(const std::vector<std::string>& strings, const std::vector<unsigned>& sizes);
+
+    void clear();
+
+    // bumped by clear() and by each eviction; holders of a layout pointer re-fetch when it
+    // changes
+    std::uint64_t generation() const { return gen; }
+    std::size_t size() const { return layouts.size(); }
+    const sf::Font& getFont() const { return font; }
+
+private:
+    void layout(const std::u32string& text, unsigned size, TextLayout& out) const;
+
+    struct Entry {
+        TextLayout layout;
+        std::list<const std::string*>::iterator use;
+    };
+
+    const sf::Font& font;
+    std::unordered_map<std::string, Entry> layouts;   // key: size, '\0', string
+    std::list<const std::string*> recent;             // keys, most recently fetched first
+    std::uint64_t gen = 0;
+};
+
+// Collects laid-out strings for a frame and draws them as one vertex array per character
+// size (the font keeps a glyph page per size). flush() between layers that overlap.
+class TextBatch {
+public:
+    TextBatch(const sf::Font& font, RenderStats& stats) : font(font), stats(stats) {}
+
+    void add(const TextLayout& t, unsigned size, sf::Vector2f pos, sf::Color color);
+    void flush(sf::RenderTarget& target);
+
+private:
+    const sf::Font& font;
+    RenderStats& stats;
+    std::map<unsigned, sf::VertexArray> bySize;
+};
+
+// The part of sf::Text the UI uses, drawn from a TextCache instead of owning its geometry.
+class CachedText {
+public:
+    CachedText(TextCache& cache, const std::string& s = "", unsigned size = 30)
+        : cache(&cache), str(s), charSize(size) {}
+
+    void setString(const std::string& s) {
+        if (s == str) return;
+        str = s;
+        cached = nullptr;
+    }
+    void setCharacterSize(unsigned size) {
+        if (size == charSize) return;
+        charSize = size;
+        cached = nullptr;
+    }
+    void setFillColor(sf::Color c) { color = c; }
+    void setPosition(sf::Vector2f p) { pos = p; }
+    sf::Vector2f getPosition() const { return pos; }
+
+    sf::FloatRect getLocalBounds() const { return layout().bounds; }
+    void draw(TextBatch& batch) const { batch.add(layout(), charSize, pos, color); }
+
+private:
+    const TextLayout& layout() const {
+        if (!cached || cachedGen != cache->generation()) {
+            cached = &cache->get(str, charSize);
+            cachedGen = cache->generation();
+        }
+        return *cached;
+    }
+
+    TextCache* cache;
+    std::string str;
+    unsigned charSize;
+    sf::Color color = sf::Color::White;
+    sf::Vector2f pos;
+    mutable const TextLayout* cached = nullptr;
+    mutable std::uint64_t cachedGen = 0;
+};
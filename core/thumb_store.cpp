@@ -0,0 +1,261 @@
+#include "thumb_store.hpp"
+#include "content_hash.hpp"
+#include "decode.hpp"
+#include "hash_index.hpp"
+#include "profiler.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ThumbStore::ThumbStore(const std::string& dataPath, const std::string& indexPath, unsigned threads,
+                       HashIndex* hashes)
+    : indexPath(indexPath), hashes(hashes) {
+    openData(dataPath);
+    loadIndex();
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this]{ workerLoop(); });
+}
+
+ThumbStore::~ThumbStore() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+    if (base) munmap(base, mappedBytes);
+    if (fd >= 0) close(fd);
+}
+
+bool ThumbStore::copyTo(const std::string& path, std::int64_t mtime, std::uint8_t* dst) {
+    std::lock_guard<std::mutex> lk(m);
+    int slot = slotFor(path, mtime);
+    if (slot < 0) return false;
+    std::memcpy(dst, slotPtr(slot), SLOT_BYTES);
+    return true;
+}
+
+int ThumbStore::slotFor(const std::string& path, std::int64_t mtime) {
+    if (!base) return -1;
+    auto it = byPath.find(path);
+    if (it == byPath.end() || it->second.mtime != mtime) return -1;
+    auto h = byHash.find(it->second.hash);
+    return h == byHash.end() ? -1 : h->second;
+}
+
+bool ThumbStore::storeSlot(std::uint64_t hash, const std::uint8_t* rgba) {
+    if (!base) return false;
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        std::size_t used = header()->used;
+        if (used >= capacity()) {
+            std::size_t had = mappedBytes;
+            mapFile(HEADER_BYTES + capacity() * 2 * SLOT_BYTES);
+            if (!base) {
+                mapFile(had);
+                return false;
+            }
+        }
+        slot = (int)used;
+        header()->used = (std::uint32_t)used + 1;
+    }
+    std::memcpy(slotPtr(slot), rgba, SLOT_BYTES);
+    byHash[hash] = slot;
+    return true;
+}
+
+void ThumbStore::link(const std::string& path, std::int64_t mtime, std::uint64_t hash) {
+    auto it = byPath.find(path);
+    if (it != byPath.end() && it->second.hash == hash) {
+        it->second.mtime = mtime;
+        return;
+    }
+    refs[hash]++;
+    unlink(path);
+    byPath[path] = PathEntry{mtime, hash};
+}
+
+bool ThumbStore::unlink(const std::string& path) {
+    auto it = byPath.find(path);
+    if (it == byPath.end()) return false;
+    std::uint64_t hash = it->second.hash;
+    byPath.erase(it);
+    auto r = refs.find(hash);
+    if (r != refs.end() && --r->second > 0) return true;
+    if (r != refs.end()) refs.erase(r);
+    auto h = byHash.find(hash);
+    if (h != byHash.end()) {
+        freeSlots.push_back(h->second);
+        byHash.erase(h);
+    }
+    return true;
+}
+
+void ThumbStore::put(const std::string& path, std::int64_t mtime, std::uint64_t hash, const std::uint8_t* rgba) {
+    std::lock_guard<std::mutex> lk(m);
+    if (hash == 0) hash = 1;
+    if (!base || (!byHash.count(hash) && !storeSlot(hash, rgba))) return;
+    link(path, mtime, hash);
+    appendIndex(mtime, hash, byHash[hash], path);
+    failed.erase(path);
+}
+
+void ThumbStore::mapFile(std::size_t bytes) {
+    if (base) munmap(base, mappedBytes);
+    base = nullptr;
+    mappedBytes = 0;
+    if (ftruncate(fd, (off_t)bytes) != 0) return;
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return;
+    base = p;
+    mappedBytes = bytes;
+}
+
+void ThumbStore::openData(const std::string& path) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cout << "Thumbnail store unavailable: " << path << "\n";
+        return;
+    }
+    struct stat st {};
+    fstat(fd, &st);
+    std::size_t bytes = (std::size_t)st.st_size;
+    bool fresh = bytes < HEADER_BYTES + SLOT_BYTES;
+    mapFile(fresh ? HEADER_BYTES + 64 * SLOT_BYTES : bytes);
+    if (!base) return;
+    if (fresh || std::memcmp(header()->magic, MAGIC, 8) != 0 || header()->thumbSize != SIZE) {
+        std::memset(base, 0, HEADER_BYTES);
+        std::memcpy(header()->magic, MAGIC, 8);
+        header()->thumbSize = SIZE;
+        header()->used = 0;
+        std::ofstream(indexPath, std::ios::trunc);
+    }
+}
+
+void ThumbStore::loadIndex() {
+    std::ifstream in(indexPath);
+    std::string line;
+    std::size_t lines = 0;
+    while (std::getline(in, line)) {
+        lines++;
+        auto a = line.find('|');
+        if (a == std::string::npos) continue;
+        auto b = line.find('|', a + 1);
+        if (b == std::string::npos) continue;
+        auto c = line.find('|', b + 1);
+        if (c == std::string::npos) continue;
+
+        PathEntry e;
+        int slot;
+        try {
+            e.mtime = std::stoll(line.substr(0, a));
+            e.hash = std::stoull(line.substr(a + 1, b - a - 1));
+            slot = std::stoi(line.substr(b + 1, c - b - 1));
+        } catch (...) {
+            continue;   // damaged line: that thumbnail is generated again
+        }
+        std::string path = line.substr(c + 1);
+
+        if (slot < 0) { byPath.erase(path); continue; }
+        if (!base || slot >= (int)header()->used) continue;
+        byHash[e.hash] = slot;
+        byPath[path] = e;
+    }
+    in.close();
+    if (!base) return;
+
+    // the lines only say where each path points; count the paths per hash, drop hashes nothing
+    // points at, and put their slots on the free list (trailing ones just shrink `used`)
+    for (auto& [path, e] : byPath) refs[e.hash]++;
+    for (auto it = byHash.begin(); it != byHash.end();)
+        it = refs.count(it->first) ? std::next(it) : byHash.erase(it);
+    std::uint32_t used = header()->used;
+    std::vector<bool> taken(used, false);
+    for (auto& [hash, slot] : byHash) taken[slot] = true;
+    while (used > 0 && !taken[used - 1]) used--;
+    header()->used = used;
+    for (std::uint32_t slot = used; slot-- > 0;)
+        if (!taken[slot]) freeSlots.push_back((int)slot);
+
+    // the file is only appended to; rewrite it once most of its lines are stale
+    if (lines > 2 * byPath.size() + 64) rewriteIndex();
+}
+
+void ThumbStore::rewriteIndex() {
+    std::ofstream out(indexPath, std::ios::trunc);
+    for (auto& [path, e] : byPath)
+        out << e.mtime << "|" << e.hash << "|" << byHash[e.hash] << "|" << path << "\n";
+}
+
+void ThumbStore::appendIndex(std::int64_t mtime, std::uint64_t hash, int slot, const std::string& path) {
+    std::ofstream out(indexPath, std::ios::app);
+    out << mtime << "|" << hash << "|" << slot << "|" << path << "\n";
+}
+
+void ThumbStore::workerLoop() {
+    FileBytes bytes;
+    std::vector<std::uint8_t> thumb(SLOT_BYTES);
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cv.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        LibraryIndex::Entry file = std::move(queue.front());
+        queue.pop_front();
+        const std::string& path = file.path;
+        std::int64_t mtime = file.mtime;
+        auto f = failed.find(path);
+        bool failedBefore = f != failed.end() && f->second.mtime == mtime && f->second.size == file.size;
+        if (!base || slotFor(path, mtime) >= 0 || inFlight.count(path) || failedBefore) continue;
+        inFlight.insert(path);
+
+        lk.unlock();
+        PROFILE_ZONE("thumbnail");
+        // the hash index usually has this version of the file already; then it is only read
+        // if its content has no thumbnail yet
+        std::uint64_t hash = 0, size = 0;
+        std::int64_t hashedAt = 0;
+        bool ok = true, read = false;
+        if (!hashes || !hashes->get(path, hash, size, hashedAt) || size != file.size || hashedAt != mtime) {
+            ok = read = bytes.open(path);
+            hash = ok ? contentHash64(bytes.data(), bytes.size()) : 0;
+            if (ok && hashes && bytes.size() == file.size) hashes->record(path, hash, file.size, mtime);
+        }
+        if (hash == 0) hash = 1;
+        lk.lock();
+
+        if (ok && !byHash.count(hash)) {
+            lk.unlock();
+            if (!read) ok = bytes.open(path);
+            DecodedImage img;
+            ok = ok && decodeForTarget(bytes.data(), bytes.size(), {SIZE, SIZE}, img);
+            if (ok) makeThumbnail(img.image, thumb.data(), SIZE);
+            bytes.reset();
+            lk.lock();
+
+            if (ok && !byHash.count(hash) && !storeSlot(hash, thumb.data())) {
+                inFlight.erase(path);
+                continue;
+            }
+        }
+        bytes.reset();
+        if (ok) {
+            link(path, mtime, hash);
+            appendIndex(mtime, hash, byHash[hash], path);
+            failed.erase(path);
+        } else {
+            failed[path] = FailedEntry{mtime, file.size};
+        }
+        inFlight.erase(path);
+    }
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "file_io.hpp"
+#include "library_index.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class HashIndex;
+
+// Fixed-size RGBA thumbnails packed into one memory-mapped file (dataPath). Slots are keyed
+// by content hash (contentHash64, taken from the HashIndex when it has this version of the
+// file), so identical files share one; a slot no path refers to any more goes on a free list
+// and is reused. indexPath maps path+mtime to a hash and slot; it is appended to as thumbnails
+// change and rewritten on load once most of its lines are stale. Thumbnails are generated by
+// background workers in request() order.
+// The mtime is the one in the library listing (LibraryIndex::Entry), so nothing here stats.
+class ThumbStore {
+public:
+    static constexpr unsigned SIZE = 128;
+    static constexpr std::size_t SLOT_BYTES = (std::size_t)SIZE * SIZE * 4;
+
+    // hashes: optional; hashes it holds save reading files whose content already has a
+    // thumbnail, and hashes taken here are recorded in it
+    ThumbStore(const std::string& dataPath, const std::string& indexPath, unsigned threads,
+               HashIndex* hashes = nullptr);
+    ~ThumbStore();
+
+    ThumbStore(const ThumbStore&) = delete;
+    ThumbStore& operator=(const ThumbStore&) = delete;
+
+    // copies the SIZE x SIZE RGBA thumbnail into dst; false if it is not generated yet
+    bool copyTo(const std::string& path, std::int64_t mtime, std::uint8_t* dst);
+
+    bool has(const std::string& path, std::int64_t mtime) {
+        std::lock_guard<std::mutex> lk(m);
+        return slotFor(path, mtime) >= 0;
+    }
+
+    // replaces the pending queue; the first path is generated first, and the files are read
+    // ahead as one batch
+    void request(const std::vector<LibraryIndex::Entry>& files) {
+        std::vector<std::string> paths;
+        paths.reserve(files.size());
+        for (auto& f : files) paths.push_back(f.path);
+        {
+            std::lock_guard<std::mutex> lk(m);
+            queue.assign(files.begin(), files.end());
+            cv.notify_all();
+        }
+        readAhead.request(paths);
+    }
+
+    // adds one file behind whatever is pending (the HTTP server asks for thumbnails one by one)
+    void enqueue(const LibraryIndex::Entry& file) {
+        std::lock_guard<std::mutex> lk(m);
+        for (auto& q : queue)
+            if (q.path == file.path) return;
+        queue.push_back(file);
+        cv.notify_one();
+    }
+
+    // where the thumbnail sits in the data file, for sendfile(2) on dataFd(); false if it is
+    // not generated yet. A slot is only rewritten after no path refers to it, so the range holds
+    // this path's thumbnail until the path itself changes.
+    bool locate(const std::string& path, std::int64_t mtime, std::uint64_t& offset) {
+        std::lock_guard<std::mutex> lk(m);
+        int slot = slotFor(path, mtime);
+        if (slot < 0) return false;
+        offset = HEADER_BYTES + (std::uint64_t)slot * SLOT_BYTES;
+        return true;
+    }
+    int dataFd() const { return fd; }
+
+    // stores a thumbnail made elsewhere (a video's poster frame); `hash` stands for the content
+    // the way the file hash does for images, so copies share the slot
+    void put(const std::string& path, std::int64_t mtime, std::uint64_t hash, const std::uint8_t* rgba);
+
+    void forget(const std::string& path) {
+        std::lock_guard<std::mutex> lk(m);
+        failed.erase(path);
+        if (unlink(path)) appendIndex(0, 0, -1, path);
+    }
+
+    // thumbnails in use (slots on the free list are not counted)
+    std::size_t count() {
+        std::lock_guard<std::mutex> lk(m);
+        return byHash.size();
+    }
+
+    bool busy() {
+        std::lock_guard<std::mutex> lk(m);
+        return !queue.empty() || !inFlight.empty();
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        std::uint32_t thumbSize;
+        std::uint32_t used;
+    };
+    struct PathEntry {
+        std::int64_t mtime = 0;
+        std::uint64_t hash = 0;
+    };
+    // the version of a file that could not be read or decoded; a new mtime or size retries it
+    struct FailedEntry {
+        std::int64_t mtime = 0;
+        std::uint64_t size = 0;
+    };
+    static constexpr std::size_t HEADER_BYTES = 64;
+    static constexpr const char* MAGIC = "MDBTHMB1";
+
+    Header* header() { return (Header*)base; }
+    std::uint8_t* slotPtr(int slot) { return (std::uint8_t*)base + HEADER_BYTES + (std::size_t)slot * SLOT_BYTES; }
+    std::size_t capacity() const { return (mappedBytes - HEADER_BYTES) / SLOT_BYTES; }
+
+    int slotFor(const std::string& path, std::int64_t mtime);
+    // fills a free slot, or appends one, for hash (m held); false if the data file cannot grow
+    // (the mapping it had is kept, so the thumbnails already stored stay readable)
+    bool storeSlot(std::uint64_t hash, const std::uint8_t* rgba);
+    // points path at hash / drops path (m held), keeping refs; a hash left with no path frees
+    // its slot. unlink is false if path was not stored.
+    void link(const std::string& path, std::int64_t mtime, std::uint64_t hash);
+    bool unlink(const std::string& path);
+    void mapFile(std::size_t bytes);
+    void openData(const std::string& path);
+
+    // index lines: mtime|hash|slot|path ; slot -1 marks a removed path
+    void loadIndex();
+    void rewriteIndex();
+    void appendIndex(std::int64_t mtime, std::uint64_t hash, int slot, const std::string& path);
+
+    void workerLoop();
+
+    std::string indexPath;
+    HashIndex* hashes;
+    int fd = -1;
+    void* base = nullptr;
+    std::size_t mappedBytes = 0;
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::unordered_map<std::string, PathEntry> byPath;
+    std::unordered_map<std::uint64_t, int> byHash;
+    std::unordered_map<std::uint64_t, std::uint32_t> refs;  // paths per hash
+    std::vector<int> freeSlots;
+    std::unordered_set<std::string> inFlight;
+    std::unordered_map<std::string, FailedEntry> failed;
+    std::deque<LibraryIndex::Entry> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+    ReadAhead readAhead{4};
+};
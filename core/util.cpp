@@ -0,0 +1,143 @@
+#include "util.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+
+std::string trim(std::string s) {
+    auto notSpace = [](unsigned char c){ return !std::isspace(c); };
+    s.erase(s.begin(), std::find_if(s.begin(), s.end(), notSpace));
+    s.erase(std::find_if(s.rbegin(), s.rend(), notSpace).base(), s.end());
+    return s;
+}
+
+std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c){ return (char)std::tolower(c); });
+    return s;
+}
+
+std::string baseName(const std::string& fullPath) {
+    auto pos = fullPath.find_last_of(fs::path::preferred_separator);
+    return pos == std::string::npos ? fullPath : fullPath.substr(pos + 1);
+}
+
+std::string libraryKey(const std::string& root, const std::string& path) {
+    if (path.size() > root.size() + 1 && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/')
+        return path.substr(root.size() + 1);
+    return baseName(path);
+}
+
+std::string foldCase(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (std::size_t i = 0; i < s.size(); i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c < 0x80) {
+            out += (char)std::tolower(c);
+            continue;
+        }
+        unsigned char n = i + 1 < s.size() ? (unsigned char)s[i + 1] : 0;
+        if (c == 0xD0 && n >= 0x90 && n <= 0x9F) {          // А..П -> а..п
+            out += (char)0xD0;
+            out += (char)(n + 0x20);
+            i++;
+        } else if (c == 0xD0 && n >= 0xA0 && n <= 0xAF) {   // Р..Я -> р..я
+            out += (char)0xD1;
+            out += (char)(n - 0x20);
+            i++;
+        } else if (c == 0xD0 && n == 0x81) {                // Ё -> ё
+            out += (char)0xD1;
+            out += (char)0x91;
+            i++;
+        } else {
+            out += (char)c;
+        }
+    }
+    return out;
+}
+
+void appendUtf8(std::string& s, char32_t c) {
+    if (c < 0x80) {
+        s += (char)c;
+    } else if (c < 0x800) {
+        s += (char)(0xC0 | (c >> 6));
+        s += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        s += (char)(0xE0 | (c >> 12));
+        s += (char)(0x80 | ((c >> 6) & 0x3F));
+        s += (char)(0x80 | (c & 0x3F));
+    } else {
+        s += (char)(0xF0 | (c >> 18));
+        s += (char)(0x80 | ((c >> 12) & 0x3F));
+        s += (char)(0x80 | ((c >> 6) & 0x3F));
+        s += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+void popUtf8(std::string& s) {
+    while (!s.empty()) {
+        unsigned char c = (unsigned char)s.back();
+        s.pop_back();
+        if ((c & 0xC0) != 0x80) break;
+    }
+}
+
+std::vector<std::string> loadLines(const std::string& path) {
+    std::vector<std::string> v;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (!line.empty()) v.push_back(line);
+    }
+    return v;
+}
+
+void saveLines(const std::string& path, const std::vector<std::string>& v) {
+    std::ofstream out(path, std::ios::trunc);
+    for (auto& s : v) out << s << "\n";
+}
+
+bool readWholeFile(const std::string& path, std::vector<char>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    in.seekg(0, std::ios::end);
+    auto n = in.tellg();
+    if (n < 0) return false;
+    in.seekg(0, std::ios::beg);
+    out.resize((std::size_t)n);
+    return (bool)in.read(out.data(), n);
+}
+
+fs::file_time_type mtimeOf(const std::string& path) {
+    std::error_code ec;
+    auto t = fs::last_write_time(path, ec);
+    return ec ? fs::file_time_type::min() : t;
+}
+
+std::int64_t mtimeTicks(fs::file_time_type t) {
+    return (std::int64_t)t.time_since_epoch().count();
+}
+
+std::uint64_t fnv1a64(const char* data, std::size_t n, std::uint64_t h) {
+    for (std::size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void openInDefaultApp(const std::string& path) {
+    // single-quoted, so names with spaces, quotes or $ reach the opener unchanged
+    std::string quoted = "'";
+    for (char c : path) quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    quoted += "'";
+#if defined(__APPLE__)
+    std::string cmd = "open " + quoted;
+#else
+    std::string cmd = "xdg-open " + quoted + " >/dev/null 2>&1 &";
+#endif
+    system(cmd.c_str());
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// ---------- string helpers ----------
+std::string trim(std::string s);
+std::string toLower(std::string s);
+
+// plain string split; called per photo when filtering, so it avoids building an fs::path
+std::string baseName(const std::string& fullPath);
+
+// path below the library folder ("trip/cat.jpg"), which is what favorites and captions are
+// keyed by so that two photos with one name in different folders stay apart; the file name
+// for a path outside root
+std::string libraryKey(const std::string& root, const std::string& path);
+
+// lower-cases ASCII and Cyrillic in a UTF-8 string (enough for EN/RU search)
+std::string foldCase(const std::string& s);
+
+// text input helpers for UTF-8 strings
+void appendUtf8(std::string& s, char32_t c);
+void popUtf8(std::string& s);
+
+// ---------- file helpers ----------
+std::vector<std::string> loadLines(const std::string& path);
+void saveLines(const std::string& path, const std::vector<std::string>& v);
+bool readWholeFile(const std::string& path, std::vector<char>& out);
+
+fs::file_time_type mtimeOf(const std::string& path);
+std::int64_t mtimeTicks(fs::file_time_type t);
+
+std::uint64_t fnv1a64(const char* data, std::size_t n, std::uint64_t h = 1469598103934665603ull);
+
+void openInDefaultApp(const std::string& path);
@@ -0,0 +1,300 @@
+#include "video.hpp"
+#include "decode.hpp"
+#include "profiler.hpp"
+#include "thumb_store.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(MEDIADB_HAVE_FFMPEG)
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+namespace {
+
+// posters are scaled to fit this box, then area-averaged down to the thumbnail size
+constexpr unsigned POSTER_BOX = 2 * ThumbStore::SIZE;
+// bytes hashed for the thumbnail store key; hashing whole videos would cost more than the probe
+constexpr std::size_t KEY_BYTES = 64 * 1024;
+
+#if !defined(MEDIADB_HAVE_FFMPEG)
+std::uint64_t readBE(const unsigned char* p, int bytes) {
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+// the movie header (moov/mvhd) of an ISO media file: timescale and duration
+bool mp4Duration(int fd, std::uint32_t& ms) {
+    unsigned char h[32];
+    std::uint64_t at = 0, end = ~0ull;
+    bool inMoov = false;
+    while (at + 8 <= end) {
+        if (pread(fd, h, 16, (off_t)at) < 8) return false;
+        std::uint64_t size = readBE(h, 4), header = 8;
+        if (size == 1) {
+            size = readBE(h + 8, 8);
+            header = 16;
+        }
+        if (size == 0) size = end - at;   // runs to the end of the file (or of moov)
+        if (size < header) return false;
+
+        if (!inMoov && !std::memcmp(h + 4, "moov", 4)) {
+            inMoov = true;
+            end = at + size;
+            at += header;
+            continue;
+        }
+        if (inMoov && !std::memcmp(h + 4, "mvhd", 4)) {
+            if (pread(fd, h, 32, (off_t)(at + header)) < 32) return false;
+            bool v1 = h[0] == 1;
+            std::uint64_t scale = readBE(h + (v1 ? 20 : 12), 4);
+            std::uint64_t duration = v1 ? readBE(h + 24, 8) : readBE(h + 16, 4);
+            if (scale == 0) return false;
+            ms = (std::uint32_t)std::min<std::uint64_t>(duration * 1000 / scale, 0xFFFFFFFFu);
+            return true;
+        }
+        at += size;
+    }
+    return false;
+}
+#else
+struct AvProbe {
+    AVFormatContext* fmt = nullptr;
+    AVCodecContext* codec = nullptr;
+    AVPacket* packet = nullptr;
+    AVFrame* frame = nullptr;
+
+    ~AvProbe() {
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec);
+        avformat_close_input(&fmt);
+    }
+};
+
+bool probeWithFfmpeg(const std::string& path, VideoInfo& out, sf::Image* poster) {
+    AvProbe p;
+    if (avformat_open_input(&p.fmt, path.c_str(), nullptr, nullptr) < 0) return false;
+    if (avformat_find_stream_info(p.fmt, nullptr) < 0) return false;
+    int si = av_find_best_stream(p.fmt, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (si < 0) return false;
+    AVStream* st = p.fmt->streams[si];
+
+    std::int64_t ms = 0;
+    if (p.fmt->duration != AV_NOPTS_VALUE) ms = av_rescale(p.fmt->duration, 1000, AV_TIME_BASE);
+    else if (st->duration != AV_NOPTS_VALUE) ms = av_rescale_q(st->duration, st->time_base, AVRational{1, 1000});
+    out.durationMs = (std::uint32_t)std::clamp<std::int64_t>(ms, 0, 0xFFFFFFFF);
+    out.width = (std::uint32_t)std::max(0, st->codecpar->width);
+    out.height = (std::uint32_t)std::max(0, st->codecpar->height);
+    if (!poster) return true;
+
+    const AVCodec* dec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!dec || !(p.codec = avcodec_alloc_context3(dec))) return true;
+    if (avcodec_parameters_to_context(p.codec, st->codecpar) < 0) return true;
+    p.codec->thread_count = 1;   // the store runs several probes at once instead
+    if (avcodec_open2(p.codec, dec, nullptr) < 0) return true;
+
+    // past fade-ins and black leaders; the key frame before that point is close enough
+    std::int64_t posterMs = std::min<std::int64_t>(ms / 10, 10000);
+    if (posterMs > 0) {
+        std::int64_t ts = av_rescale_q(posterMs, AVRational{1, 1000}, st->time_base);
+        if (st->start_time != AV_NOPTS_VALUE) ts += st->start_time;
+        av_seek_frame(p.fmt, si, ts, AVSEEK_FLAG_BACKWARD);
+    }
+    p.packet = av_packet_alloc();
+    p.frame = av_frame_alloc();
+    if (!p.packet || !p.frame) return true;
+    bool got = false;
+    for (int packets = 0; !got && packets < 1000 && av_read_frame(p.fmt, p.packet) >= 0; packets++) {
+        if (p.packet->stream_index == si && avcodec_send_packet(p.codec, p.packet) >= 0)
+            got = avcodec_receive_frame(p.codec, p.frame) == 0;
+        av_packet_unref(p.packet);
+    }
+    if (!got && avcodec_send_packet(p.codec, nullptr) >= 0) got = avcodec_receive_frame(p.codec, p.frame) == 0;
+    if (!got || p.frame->width <= 0 || p.frame->height <= 0) return true;
+
+    float f = std::min(1.f, fitFactor({(unsigned)p.frame->width, (unsigned)p.frame->height}, {POSTER_BOX, POSTER_BOX}));
+    int w = std::max(1, (int)((float)p.frame->width * f)), h = std::max(1, (int)((float)p.frame->height * f));
+    SwsContext* sws = sws_getContext(p.frame->width, p.frame->height, (AVPixelFormat)p.frame->format,
+                                     w, h, AV_PIX_FMT_RGBA, SWS_AREA, nullptr, nullptr, nullptr);
+    if (!sws) return true;
+    std::vector<std::uint8_t> rgba((std::size_t)w * h * 4);
+    std::uint8_t* dst[4] = {rgba.data(), nullptr, nullptr, nullptr};
+    int stride[4] = {w * 4, 0, 0, 0};
+    sws_scale(sws, p.frame->data, p.frame->linesize, 0, p.frame->height, dst, stride);
+    sws_freeContext(sws);
+    poster->resize({(unsigned)w, (unsigned)h}, rgba.data());
+    return true;
+}
+#endif
+
+// hash of the first KEY_BYTES, seeded with the size
+std::uint64_t contentKey(const std::string& path, std::uint64_t size, std::vector<char>& buf) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = pread(fd, buf.data(), buf.size(), 0);
+    close(fd);
+    return fnv1a64(buf.data(), n > 0 ? (std::size_t)n : 0, 1469598103934665603ull ^ size);
+}
+
+} // namespace
+
+bool probeVideo(const std::string& path, VideoInfo& out, sf::Image* poster) {
+    PROFILE_ZONE("video probe");
+    out = VideoInfo{};
+#if defined(MEDIADB_HAVE_FFMPEG)
+    return probeWithFfmpeg(path, out, poster);
+#else
+    (void)poster;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = mp4Duration(fd, out.durationMs);
+    close(fd);
+    return ok;
+#endif
+}
+
+std::string formatDuration(std::uint32_t ms) {
+    if (ms == 0) return "";
+    std::uint32_t s = (ms + 500) / 1000;
+    char buf[32];
+    if (s >= 3600) std::snprintf(buf, sizeof(buf), "%u:%02u:%02u", s / 3600, s / 60 % 60, s % 60);
+    else std::snprintf(buf, sizeof(buf), "%u:%02u", s / 60, s % 60);
+    return buf;
+}
+
+// ---------- VideoStore ----------
+VideoStore::VideoStore(const std::string& indexPath, ThumbStore& thumbs, unsigned threads)
+    : indexPath(indexPath), thumbs(thumbs) {
+    load();
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this]{ workerLoop(); });
+}
+
+VideoStore::~VideoStore() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void VideoStore::load() {
+    std::ifstream in(indexPath);
+    std::string line;
+    std::size_t lines = 0;
+    while (std::getline(in, line)) {
+        std::size_t bar[5], at = 0;
+        int found = 0;
+        for (; found < 5; found++) {
+            bar[found] = line.find('|', at);
+            if (bar[found] == std::string::npos) break;
+            at = bar[found] + 1;
+        }
+        if (found < 5) continue;
+        lines++;
+        Record r;
+        try {
+            r.size = std::stoull(line.substr(0, bar[0]));
+            r.mtime = std::stoll(line.substr(bar[0] + 1, bar[1] - bar[0] - 1));
+            r.info.durationMs = (std::uint32_t)std::stoul(line.substr(bar[1] + 1, bar[2] - bar[1] - 1));
+            r.info.width = (std::uint32_t)std::stoul(line.substr(bar[2] + 1, bar[3] - bar[2] - 1));
+            r.info.height = (std::uint32_t)std::stoul(line.substr(bar[3] + 1, bar[4] - bar[3] - 1));
+        } catch (...) {
+            continue;
+        }
+        records[line.substr(bar[4] + 1)] = r;
+    }
+    in.close();
+
+    // the file is only appended to; rewrite it once most of its lines are stale
+    if (lines > 2 * records.size() + 64) {
+        std::ofstream(indexPath, std::ios::trunc);
+        for (auto& [path, r] : records) append(path, r);
+    }
+}
+
+void VideoStore::append(const std::string& path, const Record& r) {
+    std::ofstream out(indexPath, std::ios::app);
+    out << r.size << "|" << r.mtime << "|" << r.info.durationMs << "|" << r.info.width << "|" << r.info.height
+        << "|" << path << "\n";
+}
+
+void VideoStore::sync(const std::vector<LibraryIndex::Entry>& videos) {
+    std::unordered_set<std::string> present;
+    present.reserve(videos.size());
+    std::deque<LibraryIndex::Entry> todo;
+    std::lock_guard<std::mutex> lk(m);
+    for (auto& e : videos) {
+        present.insert(e.path);
+        auto it = records.find(e.path);
+        // a video that had a frame size should have a poster; it may be missing if the
+        // thumbnail store was reset
+        if (it == records.end() || it->second.size != e.size || it->second.mtime != e.mtime ||
+            (it->second.info.width && !thumbs.has(e.path, e.mtime)))
+            todo.push_back(e);
+    }
+    for (auto it = records.begin(); it != records.end(); ) {
+        if (present.count(it->first)) ++it;
+        else it = records.erase(it);
+    }
+    queue = std::move(todo);
+    cv.notify_all();
+}
+
+bool VideoStore::get(const std::string& path, VideoInfo& out) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = records.find(path);
+    if (it == records.end()) return false;
+    out = it->second.info;
+    return true;
+}
+
+std::size_t VideoStore::pending() {
+    std::lock_guard<std::mutex> lk(m);
+    return queue.size() + inFlight;
+}
+
+void VideoStore::workerLoop() {
+    std::vector<std::uint8_t> thumb(ThumbStore::SLOT_BYTES);
+    std::vector<char> head(KEY_BYTES);
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cv.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        LibraryIndex::Entry e = std::move(queue.front());
+        queue.pop_front();
+        inFlight++;
+
+        lk.unlock();
+        Record r;
+        r.size = e.size;
+        r.mtime = e.mtime;
+        sf::Image poster;
+        probeVideo(e.path, r.info, &poster);
+        if (poster.getSize().x > 0) {
+            makeThumbnail(poster, thumb.data(), ThumbStore::SIZE);
+            thumbs.put(e.path, e.mtime, contentKey(e.path, e.size, head), thumb.data());
+        }
+        lk.lock();
+
+        // unreadable files still get a record (no duration), so they are not probed every sync
+        records[e.path] = r;
+        append(e.path, r);
+        inFlight--;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "library_index.hpp"
+
+#include <SFML/Graphics/Image.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ThumbStore;
+
+struct VideoInfo {
+    std::uint32_t durationMs = 0;   // 0 when unknown
+    std::uint32_t width = 0, height = 0;
+};
+
+// Reads the container headers and, if poster is given, decodes one frame a tenth of the way in
+// (at most 10 s) to show for the video. With FFmpeg any format it knows works; without it only
+// the duration of MP4/MOV files is read (from the movie header) and there is no poster.
+bool probeVideo(const std::string& path, VideoInfo& out, sf::Image* poster);
+
+// Duration and frame size of every video in a listing, with the poster frames kept in the
+// thumbnail store so the grid shows videos like photos. Background workers probe new or
+// changed files in-process; the results are appended to indexPath (size|mtime|ms|w|h|path).
+class VideoStore {
+public:
+    VideoStore(const std::string& indexPath, ThumbStore& thumbs, unsigned threads);
+    ~VideoStore();
+
+    VideoStore(const VideoStore&) = delete;
+    VideoStore& operator=(const VideoStore&) = delete;
+
+    // queues new or changed videos and forgets the records of files that are gone
+    void sync(const std::vector<LibraryIndex::Entry>& videos);
+
+    // false while the video has not been probed yet
+    bool get(const std::string& path, VideoInfo& out);
+
+    std::size_t pending();
+
+private:
+    struct Record {
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        VideoInfo info;
+    };
+
+    void load();
+    void append(const std::string& path, const Record& r);
+    void workerLoop();
+
+    std::string indexPath;
+    ThumbStore& thumbs;
+    std::mutex m;
+    std::condition_variable cv;
+    std::unordered_map<std::string, Record> records;
+    std::deque<LibraryIndex::Entry> queue;
+    std::size_t inFlight = 0;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+// "1:23" or "1:02:03"; empty for 0
+std::string formatDuration(std::uint32_t ms);
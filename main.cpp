@@ -5,143 +5,46 @@
 #include <algorithm>
 #include <iostream>
 #include <cstdlib>
-#include <cstdio>
-#include <fstream>
 #include <cstdint>
+#include <cstdio>
 #include <unordered_map>
-
-namespace fs = std::filesystem;
-
-// ---------- helpers ----------
-static std::string trim(std::string s) {
-    auto notSpace = [](unsigned char c){ return !std::isspace(c); };
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), notSpace));
-    s.erase(std::find_if(s.rbegin(), s.rend(), notSpace).base(), s.end());
-    return s;
-}
-
-static std::string toLower(std::string s) {
-    std::transform(s.begin(), s.end(), s.begin(),
-                   [](unsigned char c){ return (char)std::tolower(c); });
-    return s;
-}
-
-static bool isImageExt(const fs::path& p) {
-    if (!p.has_extension()) return false;
-    std::string ext = toLower(p.extension().string());
-    return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp";
-}
-
-static std::vector<std::string> loadImagePaths(const std::string& folder) {
-    std::vector<std::string> paths;
-    if (!fs::exists(folder)) return paths;
-
-    for (const auto& e : fs::directory_iterator(folder)) {
-        if (e.is_regular_file() && isImageExt(e.path()))
-            paths.push_back(e.path().string());
-    }
-    std::sort(paths.begin(), paths.end());
-    return paths;
-}
-
-static std::string baseName(const std::string& fullPath) {
-    return fs::path(fullPath).filename().string();
-}
-
-static bool inList(const std::vector<std::string>& v, const std::string& x) {
-    return std::find(v.begin(), v.end(), x) != v.end();
-}
-
-static void toggleInList(std::vector<std::string>& v, const std::string& x) {
-    auto it = std::find(v.begin(), v.end(), x);
-    if (it == v.end()) v.push_back(x);
-    else v.erase(it);
-}
-
-static std::vector<std::string> loadLines(const std::string& path) {
-    std::vector<std::string> v;
-    std::ifstream in(path);
-    std::string line;
-    while (std::getline(in, line)) {
-        line = trim(line);
-        if (!line.empty()) v.push_back(line);
-    }
-    return v;
-}
-
-static void saveLines(const std::string& path, const std::vector<std::string>& v) {
-    std::ofstream out(path, std::ios::trunc);
-    for (auto& s : v) out << s << "\n";
-}
-
-static void openInDefaultApp(const std::string& path) {
-    std::string cmd = "open \"" + path + "\"";
-    system(cmd.c_str());
-}
-
-static bool copyToFolderUnique(const std::string& srcPath, const std::string& dstFolder, std::string& outFinalName) {
-    fs::path src(srcPath);
-    if (!fs::exists(src) || !fs::is_regular_file(src)) return false;
-
-    fs::create_directories(dstFolder);
-
-    fs::path dst = fs::path(dstFolder) / src.filename();
-    int n = 1;
-    while (fs::exists(dst)) {
-        dst = fs::path(dstFolder) / (src.stem().string() + "_" + std::to_string(n++) + src.extension().string());
-    }
-
-    std::error_code ec;
-    fs::copy_file(src, dst, fs::copy_options::overwrite_existing, ec);
-    if (ec) return false;
-
-    outFinalName = dst.filename().string();
-    return true;
-}
-
-// ---------- settings ----------
-enum class Lang { EN, RU };
-
-struct Settings {
-    bool darkTheme = true;
-    int  fontSizeTitle = 44;
-    int  fontSizeMenu  = 22;
-    bool showFavoritesOnly = false;
-    Lang lang = Lang::EN;
-};
-
-static Settings loadSettings(const std::string& path) {
-    Settings s;
-    std::ifstream in(path);
-    if (!in.is_open()) return s;
-
-    std::string line;
-    while (std::getline(in, line)) {
-        line = trim(line);
-        if (line.empty()) continue;
-        auto pos = line.find('=');
-        if (pos == std::string::npos) continue;
-
-        std::string key = trim(line.substr(0, pos));
-        std::string val = trim(line.substr(pos + 1));
-
-        if (key == "darkTheme") s.darkTheme = (val == "1");
-        if (key == "fontSizeTitle") s.fontSizeTitle = std::stoi(val);
-        if (key == "fontSizeMenu")  s.fontSizeMenu  = std::stoi(val);
-        if (key == "showFavoritesOnly") s.showFavoritesOnly = (val == "1");
-        if (key == "lang") s.lang = (val == "RU") ? Lang::RU : Lang::EN;
-    }
-    return s;
-}
-
-static void saveSettings(const std::string& path, const Settings& s) {
-    std::ofstream out(path, std::ios::trunc);
-    out << "darkTheme=" << (s.darkTheme ? "1" : "0") << "\n";
-    out << "fontSizeTitle=" << s.fontSizeTitle << "\n";
-    out << "fontSizeMenu=" << s.fontSizeMenu << "\n";
-    out << "showFavoritesOnly=" << (s.showFavoritesOnly ? "1" : "0") << "\n";
-    out << "lang=" << (s.lang == Lang::RU ? "RU" : "EN") << "\n";
-}
+#include <optional>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cctype>
+#include <functional>
+
+#include "core/util.hpp"
+#include "core/profiler.hpp"
+#include "core/catalog.hpp"
+#include "core/favorites.hpp"
+#include "core/import.hpp"
+#include "core/job_queue.hpp"
+#include "core/library_index.hpp"
+#include "core/scanner.hpp"
+#include "core/hash_index.hpp"
+#include "core/dedupe.hpp"
+#include "core/batch_jobs.hpp"
+#include "core/http_server.hpp"
+#include "core/captions.hpp"
+#include "core/metadata.hpp"
+#include "core/search_index.hpp"
+#include "core/photo_table.hpp"
+#include "core/decode.hpp"
+#include "core/decode_pool.hpp"
+#include "core/image_cache.hpp"
+#include "core/thumb_store.hpp"
+#include "core/settings.hpp"
+#include "core/layout.hpp"
+#include "core/render_batch.hpp"
+#include "core/text_cache.hpp"
+#include "core/video.hpp"
+
+// set by SIGINT/SIGTERM while serving without a window
+static volatile std::sig_atomic_t stopServing = 0;
 
 // ---------- i18n ----------
 enum class Key {
@@ -151,21 +54,25 @@ enum class Key {
     BtnPrev, BtnNext, BtnPlay, BtnPause, BtnInfo, BtnInfoOn,
     BtnStar, BtnUnstar, BtnFavOn, BtnFavOff, BtnDelete, BtnBack,
     HelpTop, HelpBottom,
-    ConsoleSourceFolder, ConsoleEnterImageName, ConsoleEnterVideoName,
+    ConsoleSourceFolder, ConsoleNoVideos,
     ConsoleCanceled, ConsoleNotFound, ConsoleNotImage, ConsoleAddedImage,
-    ConsoleDeleteAsk
+    ConsoleImporting, ConsoleImported, ConsoleImportFailed, ConsoleDuplicate,
+    ConsoleRescan, ConsoleUnknownCommand,
+    PromptImageName, PromptDelete, PromptCommand, PromptTextHint, PromptConfirmHint,
+    JobHashing, JobDelete, JobCancelHint, JobCancelling,
+    ScanPhotos, ScanVideos, ScanFolders
 };
 
 static const std::unordered_map<Key, std::string> EN = {
     {Key::Title, "Media Database"},
     {Key::Subtitle, "Source: Desktop/Photos | Library: assets/images"},
     {Key::MenuPhotos, "Photos (view gallery)"},
-    {Key::MenuVideos, "Videos (open from Desktop/Photos)"},
+    {Key::MenuVideos, "Videos (browse assets/videos)"},
     {Key::MenuAdd,   "Add Photo (from Desktop/Photos by name)"},
     {Key::MenuExit,  "Exit"},
     {Key::DescPhotos,"View images from assets/images"},
-    {Key::DescVideos,"Type video filename and open in system player"},
-    {Key::DescAdd,   "Type only filename, e.g. cat.jpg"},
+    {Key::DescVideos,"Poster-frame grid; ENTER plays in the system player"},
+    {Key::DescAdd,   "Type only filename, e.g. cat.jpg, or * for the whole folder"},
     {Key::DescExit,  "Close the application"},
     {Key::BtnPrev, "Prev"},
     {Key::BtnNext, "Next"},
@@ -180,27 +87,43 @@ static const std::unordered_map<Key, std::string> EN = {
     {Key::BtnDelete, "Delete"},
     {Key::BtnBack, "Back"},
     {Key::HelpTop, "UP/DOWN or mouse - select    ENTER/click - open    ESC - exit"},
-    {Key::HelpBottom, "T theme | L language | In Photos: P play, I info, S star, F filter, D delete"},
+    {Key::HelpBottom, "T theme | L language | G grid | F3 profiler | Ctrl+P commands | In Photos: P play, I info, S star, F filter, D delete"},
     {Key::ConsoleSourceFolder, "Source folder: "},
-    {Key::ConsoleEnterImageName, "Enter image filename (example: cat.jpg)\n> "},
-    {Key::ConsoleEnterVideoName, "Enter video filename (example: clip.mp4)\n> "},
+    {Key::ConsoleNoVideos, "No videos found in assets/videos."},
     {Key::ConsoleCanceled, "Canceled"},
     {Key::ConsoleNotFound, "File not found: "},
     {Key::ConsoleNotImage, "Not an image file (allowed: jpg/jpeg/png/bmp)"},
     {Key::ConsoleAddedImage, "Added image: "},
-    {Key::ConsoleDeleteAsk, "Delete this photo? (y/n): "}
+    {Key::ConsoleImporting, "Importing: "},
+    {Key::ConsoleImported, "Imported files: "},
+    {Key::ConsoleImportFailed, "Failed to copy: "},
+    {Key::ConsoleDuplicate, "Already in library: "},
+    {Key::ConsoleRescan, "Rescanning assets/images and assets/videos"},
+    {Key::ConsoleUnknownCommand, "Unknown command: "},
+    {Key::PromptImageName, "Image file name in Desktop/Photos (example: cat.jpg), or * to import all images"},
+    {Key::PromptDelete, "Delete this photo? "},
+    {Key::PromptCommand, "Command: add <file> | import | rescan | cancel"},
+    {Key::PromptTextHint, "ENTER ok | ESC cancel"},
+    {Key::PromptConfirmHint, "Y/ENTER yes | N/ESC no"},
+    {Key::JobHashing, "hashing the library"},
+    {Key::JobDelete, "Deleting "},
+    {Key::JobCancelHint, "X cancel"},
+    {Key::JobCancelling, "cancelling..."},
+    {Key::ScanPhotos, "Looking for photos"},
+    {Key::ScanVideos, "Looking for videos"},
+    {Key::ScanFolders, " folders"}
 };
 
 static const std::unordered_map<Key, std::string> RU = {
     {Key::Title, "Медиа База"},
     {Key::Subtitle, "Источник: Desktop/Photos | Библиотека: assets/images"},
     {Key::MenuPhotos, "Фото (галерея)"},
-    {Key::MenuVideos, "Видео (открыть из Desktop/Photos)"},
+    {Key::MenuVideos, "Видео (просмотр assets/videos)"},
     {Key::MenuAdd,   "Добавить фото (по имени из Desktop/Photos)"},
     {Key::MenuExit,  "Выход"},
     {Key::DescPhotos,"Просмотр фото из assets/images"},
-    {Key::DescVideos,"Введи имя видеофайла — откроется плеер"},
-    {Key::DescAdd,   "Введи только имя файла, например: cat.jpg"},
+    {Key::DescVideos,"Сетка с кадрами; Enter — открыть в плеере"},
+    {Key::DescAdd,   "Введи только имя файла, например: cat.jpg, или * для всей папки"},
     {Key::DescExit,  "Закрыть приложение"},
     {Key::BtnPrev, "Назад"},
     {Key::BtnNext, "Вперёд"},
@@ -215,15 +138,31 @@ static const std::unordered_map<Key, std::string> RU = {
     {Key::BtnDelete, "Удалить"},
     {Key::BtnBack, "Меню"},
     {Key::HelpTop, "↑/↓ или мышь — выбор    Enter/клик — открыть    Esc — выход"},
-    {Key::HelpBottom, "T тема | L язык | В Фото: P авто, I инфо, S избранное, F фильтр, D удалить"},
+    {Key::HelpBottom, "T тема | L язык | G сетка | F3 профайлер | Ctrl+P команды | В Фото: P авто, I инфо, S избранное, F фильтр, D удалить"},
     {Key::ConsoleSourceFolder, "Папка-источник: "},
-    {Key::ConsoleEnterImageName, "Введи имя фото (пример: cat.jpg)\n> "},
-    {Key::ConsoleEnterVideoName, "Введи имя видео (пример: clip.mp4)\n> "},
+    {Key::ConsoleNoVideos, "В assets/videos нет видео."},
     {Key::ConsoleCanceled, "Отмена"},
     {Key::ConsoleNotFound, "Файл не найден: "},
     {Key::ConsoleNotImage, "Это не фото (jpg/jpeg/png/bmp)"},
     {Key::ConsoleAddedImage, "Добавлено: "},
-    {Key::ConsoleDeleteAsk, "Удалить фото? (y/n): "}
+    {Key::ConsoleImporting, "Импорт: "},
+    {Key::ConsoleImported, "Импортировано файлов: "},
+    {Key::ConsoleImportFailed, "Не удалось скопировать: "},
+    {Key::ConsoleDuplicate, "Уже есть в библиотеке: "},
+    {Key::ConsoleRescan, "Пересканирование assets/images и assets/videos"},
+    {Key::ConsoleUnknownCommand, "Неизвестная команда: "},
+    {Key::PromptImageName, "Имя фото в Desktop/Photos (пример: cat.jpg) или * чтобы импортировать все фото"},
+    {Key::PromptDelete, "Удалить фото? "},
+    {Key::PromptCommand, "Команда: add <файл> | import | rescan | cancel"},
+    {Key::PromptTextHint, "Enter ок | Esc отмена"},
+    {Key::PromptConfirmHint, "Y/Enter да | N/Esc нет"},
+    {Key::JobHashing, "хеширование библиотеки"},
+    {Key::JobDelete, "Удаление "},
+    {Key::JobCancelHint, "X отмена"},
+    {Key::JobCancelling, "отмена..."},
+    {Key::ScanPhotos, "Поиск фото"},
+    {Key::ScanVideos, "Поиск видео"},
+    {Key::ScanFolders, " папок"}
 };
 
 static std::string tr(Key k, Lang lang) {
@@ -235,11 +174,11 @@ static std::string tr(Key k, Lang lang) {
 // ---------- UI Button ----------
 struct UIButton {
     sf::RectangleShape rect;
-    sf::Text text;
+    CachedText text;
     bool hovered = false;
 
-    UIButton(const sf::Font& font, const std::string& label, unsigned int size)
-        : text(font, label, size) {}
+    UIButton(TextCache& texts, const std::string& label, unsigned int size)
+        : text(texts, label, size) {}
 
     bool contains(sf::Vector2f p) const { return rect.getGlobalBounds().contains(p); }
 
@@ -272,45 +211,156 @@ struct UIButton {
         }
     }
 
-    void draw(sf::RenderWindow& w) const { w.draw(rect); w.draw(text); }
+    // the box goes into the frame's quad batch, the label into its text batch
+    void draw(QuadBatch& batch, TextBatch& textBatch) const {
+        batch.add(rect);
+        text.draw(textBatch);
+    }
 };
 
-// ---------- layout helpers ----------
-static void fitSprite(sf::Sprite& s, const sf::Texture& t,
-                      sf::Vector2u win, float bottomBarH) {
-    auto sz = t.getSize();
-    if (sz.x == 0 || sz.y == 0) return;
-
-    float padding = 30.f;
-    float maxW = (float)win.x - padding * 2.f;
-    float maxH = (float)win.y - bottomBarH - padding * 2.f;
-
-    float scale = std::min(maxW / (float)sz.x, maxH / (float)sz.y);
-    s.setScale({scale, scale});
-    s.setPosition({
-        ((float)win.x - (float)sz.x * scale) / 2.f,
-        (((float)win.y - bottomBarH) - (float)sz.y * scale) / 2.f
-    });
-}
-
-enum class Screen { Menu, Photos };
+enum class Screen { Menu, Photos, Grid };
 
-int main() {
+int main(int argc, char** argv) {
     const std::string IMAGES = "assets/images";
     const std::string VIDEOS = "assets/videos";
     const std::string FONT   = "assets/fonts/DejaVuSans.ttf";
+    const std::string CATALOG_FILE   = "assets/catalog.db";
+    const std::string CATALOG_WAL    = "assets/catalog.wal";
     const std::string SETTINGS_FILE  = "assets/settings.txt";
     const std::string FAVORITES_FILE = "assets/favorites.txt";
+    const std::string FAVORITES_JOURNAL = "assets/favorites.journal";
+    const std::string THUMBS_FILE    = "assets/thumbs.bin";
+    const std::string THUMBS_INDEX   = "assets/thumbs.idx";
+    const std::string LIBRARY_INDEX  = "assets/library.idx";
+    const std::string VIDEO_INDEX    = "assets/videos.idx";
+    const std::string VIDEO_INFO     = "assets/videoinfo.idx";
+    const std::string HASH_INDEX     = "assets/hashes.idx";
+    const std::string CAPTIONS_FILE  = "assets/captions.txt";
 
     const std::string SOURCE_PHOTOS = std::string(getenv("HOME")) + "/Desktop/Photos";
 
+    // --trace <file>: write a Chrome trace_event JSON (about:tracing / Perfetto) on exit
+    // --dedupe: list the byte-identical library files and exit; --dedupe --apply deletes all
+    // but one of each group
+    // --scan, --import <dir>, --build-thumbs, --verify: run those jobs in the order given, on
+    // every core and without a window; each prints one JSON line of stats to stdout (problem
+    // files go to stderr) and the exit status is 1 if any of them reported a problem
+    // --serve [port]: also serve the library over HTTP (see core/http_server.hpp), on 127.0.0.1
+    // unless --listen <addr> says otherwise; with --headless there is no window and it runs
+    // until SIGINT/SIGTERM
+    bool dedupe = false, dedupeApply = false, serve = false, headless = false;
+    HttpServer::Options serveOpt;
+    std::vector<std::pair<std::string, std::string>> jobs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) Profiler::instance().enableTrace(argv[++i]);
+        if (arg == "--dedupe") dedupe = true;
+        if (arg == "--apply") dedupeApply = true;
+        if (arg == "--scan" || arg == "--build-thumbs" || arg == "--verify") jobs.emplace_back(arg.substr(2), "");
+        if (arg == "--import" && i + 1 < argc) jobs.emplace_back("import", argv[++i]);
+        if (arg == "--serve") {
+            serve = true;
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) serveOpt.port = std::atoi(argv[++i]);
+        }
+        if (arg == "--listen" && i + 1 < argc) serveOpt.address = argv[++i];
+        if (arg == "--headless") headless = true;
+    }
+
     fs::create_directories(IMAGES);
     fs::create_directories(VIDEOS);
     fs::create_directories("assets/fonts");
     fs::create_directories(SOURCE_PHOTOS);
 
-    Settings settings = loadSettings(SETTINGS_FILE);
-    auto favorites = loadLines(FAVORITES_FILE);
+    // settings, favorites, captions and metadata; the old text files are read once into a new catalog
+    Catalog catalog(CATALOG_FILE, CATALOG_WAL);
+    FavoritesSet favorites(catalog, IMAGES);
+    if (catalog.fresh()) {
+        importSettingsFile(catalog, SETTINGS_FILE);
+        favorites.importFiles(FAVORITES_FILE, FAVORITES_JOURNAL);
+    }
+    syncCaptionsFile(catalog, CAPTIONS_FILE);
+    Settings settings = loadSettings(catalog);
+    LibraryIndex library(IMAGES, LIBRARY_INDEX);
+    favorites.upgradeNames(library.all());
+    LibraryIndex videoLibrary(VIDEOS, VIDEO_INDEX, 0, MediaKind::Videos);
+    HashIndex hashes(HASH_INDEX);
+    unsigned hw = std::thread::hardware_concurrency();
+
+    if (!jobs.empty()) {
+        unsigned threads = hw ? hw : 2;
+        MetadataStore metadata(catalog, threads);
+        std::unique_ptr<ThumbStore> thumbs;
+        bool allOk = true;
+        for (auto& [job, arg] : jobs) {
+            JobReport r(job);
+            if (job == "scan") r = runScanJob(library, metadata, hashes, threads);
+            if (job == "import") r = runImportJob(arg, IMAGES, library, hashes, metadata, threads);
+            if (job == "verify") r = runVerifyJob(library, hashes, threads);
+            if (job == "build-thumbs") {
+                if (!thumbs) thumbs = std::make_unique<ThumbStore>(THUMBS_FILE, THUMBS_INDEX, threads, &hashes);
+                r = runThumbsJob(library, *thumbs);
+            }
+            std::cout << r.json() << std::endl;
+            allOk = allOk && r.ok;
+        }
+        library.flush();
+        hashes.flush();
+        catalog.flush();
+        if (Profiler::instance().writeTrace()) std::cerr << "Trace written\n";
+        return allOk ? 0 : 1;
+    }
+
+    if (dedupe) {
+        auto r = dedupeLibrary(library, hashes, favorites, hw ? hw : 2, dedupeApply);
+        for (auto& g : r.list) {
+            std::cout << "keep   " << g.keeper << "\n";
+            for (auto& c : g.copies) std::cout << (dedupeApply ? "  removed " : "  remove ") << c << "\n";
+        }
+        std::cout << "Duplicate groups: " << r.groups << (dedupeApply ? ", files removed: " : ", files to remove: ")
+                  << r.removed << (dedupeApply ? ", freed: " : ", would free: ") << r.bytesFreed / 1024 << " KB\n";
+        if (!dedupeApply && r.removed) std::cout << "Nothing was deleted; run with --dedupe --apply to remove them.\n";
+        return 0;
+    }
+
+    auto serverReport = [](const HttpServer& server) {
+        auto s = server.stats();
+        std::cout << "HTTP connections: " << s.connections << ", requests: " << s.requests
+                  << ", sent: " << s.bytesSent / 1024 << " KB\n";
+    };
+
+    if (serve && headless) {
+        unsigned workers = hw > 1 ? std::min(hw, 4u) : 1u;
+        MetadataStore metadata(catalog, workers);
+        ThumbStore thumbs(THUMBS_FILE, THUMBS_INDEX, workers, &hashes);
+        serveOpt.threads = workers;
+        HttpServer server(serveOpt, metadata, &thumbs);
+        library.startScan();
+        metadata.sync(library.all());
+        server.publish(IMAGES, library.all());
+        if (!server.start()) return 1;
+        std::cout << "Serving " << IMAGES << " on http://" << serveOpt.address << ":" << serveOpt.port << "\n";
+
+        std::signal(SIGINT, [](int) { stopServing = 1; });
+        std::signal(SIGTERM, [](int) { stopServing = 1; });
+        while (!stopServing) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            if (library.scanning() && library.pollScan()) {
+                metadata.sync(library.all());
+                server.publish(IMAGES, library.all());
+            }
+        }
+        server.stop();
+        serverReport(server);
+        library.flush();
+        hashes.flush();
+        catalog.flush();
+        if (Profiler::instance().writeTrace()) std::cout << "Trace written\n";
+        return 0;
+    }
+
+    // the stored listing is usable at once; a scan of the whole tree catches up in the
+    // background and streams new images in (polled every frame)
+    library.startScan();
 
     sf::RenderWindow window(sf::VideoMode({1000, 650}), "Media Database");
     window.setFramerateLimit(60);
@@ -321,6 +371,20 @@ int main() {
         return 0;
     }
 
+    // laid-out strings shared by every label; the glyphs of both languages are rasterized
+    // here so switching language later does not stall
+    TextCache texts(font);
+    {
+        std::vector<std::string> charset = {
+            " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~",
+            "АБВГДЕЁЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯабвгдеёжзийклмнопрстуфхцчшщъыьэюя",
+            "★←→↑↓—",
+        };
+        for (auto* dict : {&EN, &RU})
+            for (auto& [k, v] : *dict) charset.push_back(v);
+        texts.prewarm(charset, {13, 15, 16, 20, 24, (unsigned)settings.fontSizeTitle, (unsigned)settings.fontSizeMenu});
+    }
+
     // menu data (will be filled by applyLanguage())
     std::vector<std::string> menu(4);
     std::vector<std::string> desc(4);
@@ -330,37 +394,145 @@ int main() {
     // viewer state
     std::vector<std::string> photos;
     int photoIdx = 0;
+    // a menu entry picked before the first scan found anything; the main loop opens it once
+    // the scan has something to show (or is done)
+    enum class Opening { None, Photos, Videos };
+    Opening opening = Opening::None;
+
+    const int PREFETCH_RADIUS = 2;
+    DecodePool decoder(hw > 1 ? std::min(hw - 1, 4u) : 1u);
+    ThumbStore thumbs(THUMBS_FILE, THUMBS_INDEX, hw > 2 ? std::min(hw - 2, 4u) : 1u, &hashes);
+    MetadataStore metadata(catalog, hw > 2 ? std::min(hw - 2, 4u) : 1u);
+    metadata.sync(library.all());
+    // probes videos in-process; their poster frames go into the same thumbnail store
+    VideoStore videoInfo(VIDEO_INFO, thumbs, hw > 2 ? std::min(hw - 2, 2u) : 1u);
+    // imports and deletes run here, off the render thread
+    JobQueue jobQueue;
+
+    // republished whenever the library changes (see the main loop)
+    std::unique_ptr<HttpServer> server;
+    std::uint64_t servedGeneration = 0;
+    if (serve) {
+        serveOpt.threads = hw > 3 ? 2u : 1u;
+        server = std::make_unique<HttpServer>(serveOpt, metadata, &thumbs);
+        server->publish(IMAGES, library.all());
+        servedGeneration = library.generation();
+        if (server->start())
+            std::cout << "Serving " << IMAGES << " on http://" << serveOpt.address << ":" << serveOpt.port << "\n";
+        else
+            server.reset();
+    }
 
+    ImageCache cache((std::uint64_t)settings.cacheRamMB << 20, (std::uint64_t)settings.cacheVramMB << 20);
+
+    // the texture on screen; the cache may evict it, this keeps it alive while shown
     sf::Image dummyImg({1,1}, sf::Color::White);
-    sf::Texture tex;
-    (void)tex.loadFromImage(dummyImg);
-    sf::Sprite spr(tex);
+    auto tex = std::make_shared<ViewTexture>();
+    (void)tex->tex.loadFromImage(dummyImg);
+    tex->fullSize = dummyImg.getSize();
+    sf::Sprite spr(tex->tex);
+    float zoom = 1.f;
+    // offset of the zoomed photo from centre (screen pixels), moved by dragging or the arrows
+    sf::Vector2f pan;
+    bool panning = false;
+
+    // progressive display: a photo the decoder does not have yet is shown from its stored
+    // thumbnail (or the EXIF preview) scaled up, then replaced once the full decode lands
+    auto preview = std::make_shared<ViewTexture>();
+    std::vector<char> exifPreview;
+    const float MAX_ZOOM = 8.f;
 
     float barH = 86.f;
     sf::RectangleShape bar({(float)window.getSize().x, barH});
-    sf::Text caption(font, "", 20);
-    sf::Text counter(font, "", 16);
-
-    float fade = 255.f;
-    bool  fadingOut = false;
-    bool  fadingIn  = false;
+    CachedText caption(texts, "", 20);
+    CachedText counter(texts, "", 16);
+
+    // two live textures: while the crossfade runs (fade 0 -> 1) the photo being replaced
+    // stays on screen under the new one. A photo asked for before it could be shown at all
+    // is pendingIdx; the current one stays up until it is decoded.
+    std::shared_ptr<ViewTexture> fromTex;
+    sf::Sprite fromSpr(tex->tex);
+    float fade = 1.f;
+    const float FADE_TIME = 0.4f;
     int   pendingIdx = -1;
 
+    // slides are due at fixed times on slideClock (start + k * SLIDE_DELAY), so decode time
+    // never adds up; prefetchAround decodes the slides ahead while the current one is up
     bool slideshow = false;
-    float slideTimer = 0.f;
+    sf::Clock slideClock;
+    float slideDue = 0.f;
+    std::uint64_t slidesShown = 0, slidesLate = 0;
     const float SLIDE_DELAY = 2.5f;
     bool showInfo = false;
 
+    // in-window question drawn over the current screen (file name to add, delete confirmation,
+    // command palette); while it is open every key goes to it
+    enum class PromptKind { None, Text, Confirm };
+    PromptKind promptKind = PromptKind::None;
+    std::string promptTitle, promptInput;
+    std::function<void(const std::string&)> promptAccept;
+    bool promptDirty = false;
+    // outcome of the last job or command, shown above the bottom bar for a few seconds
+    std::string notice;
+    sf::Clock noticeClock;
+    const float NOTICE_SECONDS = 4.f;
+
+    // retained scene state: rebuilt right before drawing, only when marked dirty
+    bool menuDirty = true;
+    bool chromeDirty = true;
+    bool infoDirty = true;
+
     sf::Clock dtClock;
 
-    UIButton btnPrev(font, "Prev", 15);
-    UIButton btnNext(font, "Next", 15);
-    UIButton btnPlay(font, "Play", 15);
-    UIButton btnInfo(font, "Info", 15);
-    UIButton btnStar(font, "Star", 15);
-    UIButton btnFav(font,  "Fav: OFF", 15);
-    UIButton btnDel(font,  "Delete", 15);
-    UIButton btnBack(font, "Back", 15);
+    // everything untextured or thumbnail-sized goes through one batch per frame; text and the
+    // viewer photo are drawn directly and counted in the same stats
+    RenderStats renderStats;
+    TextureAtlas atlas(ThumbStore::SIZE, 4, renderStats);
+    QuadBatch batch(atlas, renderStats);
+    TextBatch textBatch(font, renderStats);
+    auto drawDirect = [&](const sf::Drawable& d) {
+        window.draw(d);
+        renderStats.drawCalls++;
+    };
+
+    // grid state: only cells in the viewport own an atlas slot, released when they scroll away
+    const float GRID_CELL = 150.f;
+    const float GRID_PAD  = 20.f;
+    const float GRID_TOP  = 40.f;
+    const int   GRID_UPLOADS_PER_FRAME = 48;
+    struct GridCell {
+        int slot = -1;
+        bool ready = false;
+    };
+    std::unordered_map<int, GridCell> gridCells;
+    std::vector<std::uint8_t> thumbBuf(ThumbStore::SLOT_BYTES);
+    float gridScroll = 0.f;
+    int gridSel = 0;
+    // the grid lists videos (paths in `photos`); search, sort and the viewer are photo-only
+    bool videoGrid = false;
+
+    // columnar copy of the library for sorting and filtering; rebuilt when the listing changes
+    // or more header metadata has arrived since the last build
+    PhotoTable table;
+    std::uint64_t tableGeneration = ~0ull;
+    std::size_t tableMetaPending = 0;
+
+    // search ("/" in the grid): index over file names + captions of the table rows, built on
+    // first use and rebuilt only when the library changes. Filter words (fav, landscape,
+    // >12mp, taken:2025, sort:-date, ...) are taken out of the query first.
+    SearchIndex search;
+    std::uint64_t searchGeneration = ~0ull;
+    std::string searchQuery;
+    bool searchActive = false;
+
+    UIButton btnPrev(texts, "Prev", 15);
+    UIButton btnNext(texts, "Next", 15);
+    UIButton btnPlay(texts, "Play", 15);
+    UIButton btnInfo(texts, "Info", 15);
+    UIButton btnStar(texts, "Star", 15);
+    UIButton btnFav(texts,  "Fav: OFF", 15);
+    UIButton btnDel(texts,  "Delete", 15);
+    UIButton btnBack(texts, "Back", 15);
 
     auto refreshBarColors = [&]() {
         if (settings.darkTheme) {
@@ -374,15 +546,49 @@ int main() {
         }
     };
 
+    auto syncTable = [&]() {
+        std::size_t pending = metadata.pending();
+        if (tableGeneration == library.generation() && (tableMetaPending == 0 || pending == tableMetaPending)) return;
+        PROFILE_ZONE("photo table");
+        table.build(library.all(), metadata, favorites);
+        tableGeneration = library.generation();
+        tableMetaPending = pending;
+    };
+
+    auto syncSearch = [&]() {
+        if (searchGeneration == library.generation()) return;
+        PROFILE_ZONE("search index");
+        std::vector<std::string> texts;
+        texts.reserve(table.size());
+        std::string cap;
+        for (auto& p : table.allPaths()) {
+            std::string name = baseName(p);
+            texts.push_back(catalog.get(CatalogTable::Captions, libraryKey(IMAGES, p), cap) ? name + " " + cap : name);
+        }
+        search.build(texts);
+        searchGeneration = library.generation();
+    };
+
     auto applyFilters = [&]() {
-        auto all = loadImagePaths(IMAGES);
-        if (settings.showFavoritesOnly) {
-            std::vector<std::string> onlyFav;
-            for (auto& p : all) {
-                if (inList(favorites, baseName(p))) onlyFav.push_back(p);
-            }
-            all = std::move(onlyFav);
+        PROFILE_ZONE("applyFilters");
+        syncTable();
+        PhotoFilter f;
+        f.favoritesOnly = settings.showFavoritesOnly;
+        f.sort = settings.sortKey;
+        f.descending = settings.sortDescending;
+        std::string text = parsePhotoFilter(searchQuery, f);
+
+        const std::vector<std::uint32_t>* hits = nullptr;
+        if (!text.empty()) {
+            syncSearch();
+            PROFILE_ZONE("search");
+            hits = &search.query(text);
         }
+        PROFILE_ZONE("select");
+        auto rows = table.select(f, hits);
+        std::vector<std::string> all;
+        all.reserve(rows.size());
+        for (auto r : rows) all.push_back(table.path(r));
         return all;
     };
 
@@ -392,7 +598,11 @@ int main() {
         bar.setSize({(float)ws.x, barH});
         bar.setPosition({0.f, (float)ws.y - barH});
 
-        fitSprite(spr, tex, ws, barH);
+        {
+            PROFILE_ZONE("fitSprite");
+            pan = fitSprite(spr, ws, barH, zoom, pan).pan;
+            if (fromTex) fitSprite(fromSpr, ws, barH, zoom, pan);
+        }
 
         caption.setPosition({20.f, (float)ws.y - barH + 10.f});
         counter.setPosition({20.f, (float)ws.y - barH + 40.f});
@@ -426,20 +636,141 @@ int main() {
         btnBack.setHovered(false, settings.darkTheme);
     };
 
-    auto loadCurrentPhoto = [&]() {
-        if (photos.empty()) return;
-        if (!tex.loadFromFile(photos[photoIdx])) {
-            std::cout << "Failed to load: " << photos[photoIdx] << "\n";
-            return;
+    // display box photos are decoded for, rounded up so small resizes reuse the same level;
+    // zooming in asks for full resolution
+    auto viewTarget = [&]() -> sf::Vector2u {
+        if (zoom > 1.f) return {0, 0};
+        auto ws = window.getSize();
+        auto roundUp = [](float v) { return ((unsigned)std::max(1.f, v) + 255u) / 256u * 256u; };
+        return {roundUp((float)ws.x - 60.f), roundUp((float)ws.y - barH - 60.f)};
+    };
+
+    // the mtime the listing recorded: what the caches and the thumbnail store are keyed by, so
+    // drawing never stats a file (-1, matching nothing, once the listing has dropped the path)
+    auto listedMtime = [&](const std::string& path) -> std::int64_t {
+        const auto* e = (videoGrid ? videoLibrary : library).find(path);
+        return e ? e->mtime : -1;
+    };
+
+    // neighbors already in the cache are not decoded again
+    auto prefetchAround = [&]() {
+        int n = (int)photos.size();
+        // nearest first; a running slideshow only moves forward, so everything ahead goes first
+        std::vector<int> offsets{0};
+        for (int d = 1; d <= PREFETCH_RADIUS && d < n; d++) {
+            offsets.push_back(d);
+            if (!slideshow) offsets.push_back(-d);
         }
-        spr = sf::Sprite(tex);
-        layoutViewer();
+        for (int d = 1; slideshow && d <= PREFETCH_RADIUS && d < n; d++) offsets.push_back(-d);
+
+        std::vector<std::string> wanted;
+        for (int off : offsets) {
+            const std::string& p = photos[((photoIdx + off) % n + n) % n];
+            if (cache.has(p, listedMtime(p), viewTarget())) continue;
+            if (std::find(wanted.begin(), wanted.end(), p) == wanted.end()) wanted.push_back(p);
+        }
+        decoder.setTarget(viewTarget());
+        decoder.prefetch(wanted);
+    };
 
+    auto isPhotoReady = [&](const std::string& path) {
+        return cache.has(path, listedMtime(path), viewTarget()) || decoder.isReady(path);
+    };
+
+    auto updatePhotoCaption = [&]() {
         std::string file = baseName(photos[photoIdx]);
-        bool fav = inList(favorites, file);
+        bool fav = favorites.contains(photos[photoIdx]);
 
         caption.setString((fav ? "★ " : "") + file);
         counter.setString(std::to_string(photoIdx + 1) + " / " + std::to_string(photos.size()));
+        infoDirty = true;
+    };
+
+    // VRAM hit -> nothing to do; RAM hit -> upload only; miss -> take the decoder's result
+    auto loadCurrentPhoto = [&]() {
+        if (photos.empty()) return;
+        const std::string& path = photos[photoIdx];
+        auto mtime = listedMtime(path);
+
+        auto target = viewTarget();
+        decoder.setTarget(target);
+
+        auto t = cache.texture(path, mtime, target);
+        if (!t) {
+            auto img = cache.image(path, mtime, target);
+            if (!img) {
+                img = decoder.acquire(path);
+                if (img) cache.putImage(path, mtime, img);
+            }
+            t = std::make_shared<ViewTexture>();
+            if (img) {
+                t->fullSize = img->fullSize;
+                t->target = img->target;
+            }
+            bool uploaded = false;
+            if (img) {
+                PROFILE_ZONE("upload");
+                uploaded = t->tex.loadFromImage(img->image);
+                if (uploaded) renderStats.uploadBytes += (std::uint64_t)img->image.getSize().x * img->image.getSize().y * 4;
+            }
+            if (!uploaded) {
+                std::cout << "Failed to load: " << path << "\n";
+                // what is on screen is all there will be; stop waiting for something better
+                tex->target = {0, 0};
+                prefetchAround();
+                return;
+            }
+            cache.putTexture(path, mtime, t);
+        }
+        tex = t;
+        prefetchAround();
+        spr = sf::Sprite(tex->tex);
+        layoutViewer();
+        updatePhotoCaption();
+    };
+
+    // never blocks: the thumbnail store is memory-mapped and an EXIF preview is a few KB
+    // read from the headers. False when the photo has neither.
+    auto showPreview = [&]() -> bool {
+        PROFILE_ZONE("preview");
+        const std::string& path = photos[photoIdx];
+        ImageMeta meta;
+        bool haveSize = metadata.get(path, meta) && meta.width && meta.height;
+        sf::Vector2u slot(ThumbStore::SIZE, ThumbStore::SIZE);
+        sf::IntRect rect;
+        if (thumbs.copyTo(path, listedMtime(path), thumbBuf.data())) {
+            if (preview->tex.getSize() != slot && !preview->tex.resize(slot)) return false;
+            preview->tex.update(thumbBuf.data());
+            renderStats.uploadBytes += ThumbStore::SLOT_BYTES;
+            rect = haveSize ? thumbnailRect({meta.width, meta.height}, ThumbStore::SIZE) : sf::IntRect({0, 0}, sf::Vector2i(slot));
+        } else {
+            DecodedImage img;
+            if (!readExifPreview(path, exifPreview) ||
+                !decodeForTarget(exifPreview.data(), exifPreview.size(), {0, 0}, img) ||
+                !preview->tex.loadFromImage(img.image)) return false;
+            renderStats.uploadBytes += (std::uint64_t)img.image.getSize().x * img.image.getSize().y * 4;
+            rect = {{0, 0}, sf::Vector2i(img.image.getSize())};
+        }
+        preview->tex.setSmooth(true);
+        preview->target = {ThumbStore::SIZE, ThumbStore::SIZE};
+        preview->fullSize = haveSize ? sf::Vector2u(meta.width, meta.height) : sf::Vector2u(rect.size);
+        tex = preview;
+        spr = sf::Sprite(tex->tex, rect);
+        layoutViewer();
+        updatePhotoCaption();
+        return true;
+    };
+
+    // the full photo when it is decoded, the preview otherwise (the main loop swaps the full
+    // one in later); decodes on the spot only when there is nothing to preview
+    auto showCurrentPhoto = [&]() {
+        if (photos.empty()) return;
+        if (isPhotoReady(photos[photoIdx])) {
+            loadCurrentPhoto();
+            return;
+        }
+        prefetchAround();
+        if (!showPreview()) loadCurrentPhoto();
     };
 
     // language applier (updates menu, descriptions, button labels)
@@ -467,20 +798,31 @@ int main() {
         btnFav .setLabel(settings.showFavoritesOnly ? tr(Key::BtnFavOn, settings.lang) : tr(Key::BtnFavOff, settings.lang));
 
         if (!photos.empty()) {
-            bool fav = inList(favorites, baseName(photos[photoIdx]));
+            bool fav = favorites.contains(photos[photoIdx]);
             btnStar.setLabel(fav ? tr(Key::BtnUnstar, settings.lang) : tr(Key::BtnStar, settings.lang));
         } else {
             btnStar.setLabel(tr(Key::BtnStar, settings.lang));
         }
+        menuDirty = chromeDirty = infoDirty = true;
     };
 
     auto enterPhotos = [&]() -> bool {
+        videoGrid = false;
+        library.startScan();
+        library.pollScan();
+        // first run over a big tree: nothing to show yet, so stay in the menu with the scan's
+        // progress in the job strip until it finds something
+        opening = library.scanning() && library.size() == 0 ? Opening::Photos : Opening::None;
+        if (opening != Opening::None) return false;
+        metadata.sync(library.all());
+        searchQuery.clear();
+        searchActive = false;
         photos = applyFilters();
 
         // if filter hides everything, disable it automatically
         if (photos.empty() && settings.showFavoritesOnly) {
             settings.showFavoritesOnly = false;
-            saveSettings(SETTINGS_FILE, settings);
+            saveSettings(catalog, settings);
             photos = applyFilters();
             applyLanguage();
         }
@@ -492,17 +834,40 @@ int main() {
         }
 
         photoIdx = 0;
-        fade = 255.f;
-        fadingOut = false;
-        fadingIn = false;
+        fade = 1.f;
+        fromTex.reset();
         pendingIdx = -1;
 
         slideshow = false;
-        slideTimer = 0.f;
         showInfo = false;
 
         refreshBarColors();
-        loadCurrentPhoto();
+        showCurrentPhoto();
+        applyLanguage();
+        return true;
+    };
+
+    // crossfades from whatever is on screen to photo n, decoded or as a preview; false (and
+    // nothing changes) when n has neither yet. A step taken while a crossfade is still running
+    // cuts instead, so holding an arrow key scrubs through previews.
+    auto transitionTo = [&](int n) -> bool {
+        auto oldTex = tex;
+        sf::Sprite oldSpr = spr;
+        int prev = photoIdx;
+        photoIdx = n;
+        if (isPhotoReady(photos[n])) {
+            loadCurrentPhoto();
+        } else if (showPreview()) {
+            prefetchAround();
+        } else {
+            photoIdx = prev;
+            return false;
+        }
+        if (fade >= 1.f) {
+            fromTex = oldTex;
+            fromSpr = oldSpr;
+            fade = 0.f;
+        }
         applyLanguage();
         return true;
     };
@@ -511,96 +876,314 @@ int main() {
         if (photos.empty()) return;
         int n = (newIndex % (int)photos.size() + (int)photos.size()) % (int)photos.size();
         if (n == photoIdx) return;
-        pendingIdx = n;
-        fadingOut = true;
-        fadingIn = false;
+        if (cache.has(photos[n], listedMtime(photos[n]), viewTarget())) decoder.noteHit();
+        else decoder.noteRequest(photos[n]);
+        pendingIdx = transitionTo(n) ? -1 : n;
     };
 
-    auto addPhotoFromDesktopFolder = [&]() {
-        std::cout << "\n" << tr(Key::ConsoleSourceFolder, settings.lang) << SOURCE_PHOTOS << "\n";
-        std::cout << tr(Key::ConsoleEnterImageName, settings.lang);
+    auto openPrompt = [&](PromptKind kind, const std::string& title, std::function<void(const std::string&)> accept) {
+        promptKind = kind;
+        promptTitle = title;
+        promptInput.clear();
+        promptAccept = std::move(accept);
+        promptDirty = true;
+    };
 
-        std::string name;
-        std::getline(std::cin, name);
-        name = trim(name);
+    // printed as before, and shown in the window as well
+    auto showNotice = [&](const std::string& text) {
+        std::cout << text << "\n";
+        notice = text;
+        noticeClock.restart();
+    };
 
+    // "*" imports the whole folder. The copy runs as a job; the library and metadata only learn
+    // about the new files in its callback, on this thread.
+    auto importFromDesktopFolder = [&](const std::string& input) {
+        std::string name = trim(input);
         if (name.empty()) {
-            std::cout << tr(Key::ConsoleCanceled, settings.lang) << "\n";
+            showNotice(tr(Key::ConsoleCanceled, settings.lang));
             return;
         }
+        Lang lang = settings.lang;
+        std::string label = tr(Key::ConsoleImporting, lang) + (name == "*" ? SOURCE_PHOTOS : name);
+        // identical content already in the library is not copied again; the hashes are brought
+        // up to date against the listing as it is now (a running scan may still add to it)
+        jobQueue.submit(label, [&, name, lang, known = library.all()](JobQueue::Job& job) -> JobQueue::Finish {
+            job.progress(0, 0, tr(Key::JobHashing, lang));
+            hashes.sync(known, hw ? hw : 2);
+            if (job.cancelled()) return [&] { showNotice(tr(Key::ConsoleCanceled, settings.lang)); };
+
+            auto onProgress = [&](const ImportProgress& p) {
+                char line[96];
+                std::snprintf(line, sizeof(line), "%.1f/%.1f MB  %.1f MB/s",
+                              p.bytesDone / 1048576.0, p.bytesTotal / 1048576.0, p.mbPerSec());
+                job.progress(p.filesDone, p.filesTotal, line);
+            };
+
+            if (name == "*") {
+                auto result = importFolder(SOURCE_PHOTOS, IMAGES, hw > 1 ? std::min(hw, 8u) : 2,
+                                           onProgress, &hashes, job.cancelFlag());
+                return [&, result] {
+                    for (auto& f : result.failed) std::cout << tr(Key::ConsoleImportFailed, settings.lang) << f << "\n";
+                    for (auto& [src, existing] : result.duplicates)
+                        std::cout << tr(Key::ConsoleDuplicate, settings.lang) << baseName(src) << " = " << baseName(existing) << "\n";
+                    library.add(result.imported);
+                    metadata.sync(library.all());
+                    std::cout << "clone " << result.cloned << ", kernel copy " << result.kernelCopied << "\n";
+                    showNotice(tr(Key::ConsoleImported, settings.lang) + std::to_string(result.imported.size())
+                               + (result.skipped ? " (" + tr(Key::ConsoleCanceled, settings.lang) + ")" : ""));
+                };
+            }
 
-        fs::path src = fs::path(SOURCE_PHOTOS) / name;
-        if (!fs::exists(src)) {
-            std::cout << tr(Key::ConsoleNotFound, settings.lang) << src << "\n";
-            return;
-        }
-        if (!isImageExt(src)) {
-            std::cout << tr(Key::ConsoleNotImage, settings.lang) << "\n";
-            return;
-        }
+            std::string src = (fs::path(SOURCE_PHOTOS) / name).string();
+            if (!fs::exists(src)) return [&, src] { showNotice(tr(Key::ConsoleNotFound, settings.lang) + src); };
+            if (!isDecodableFormat(sniffImageFile(src))) return [&] { showNotice(tr(Key::ConsoleNotImage, settings.lang)); };
+
+            auto result = importFiles({src}, IMAGES, 1, {}, &hashes, job.cancelFlag());
+            return [&, result] {
+                if (!result.imported.empty()) {
+                    library.add(result.imported.front());
+                    metadata.sync(library.all());
+                    showNotice(tr(Key::ConsoleAddedImage, settings.lang) + baseName(result.imported.front()));
+                } else if (!result.duplicates.empty()) {
+                    showNotice(tr(Key::ConsoleDuplicate, settings.lang) + baseName(result.duplicates.front().second));
+                } else if (result.skipped) {
+                    showNotice(tr(Key::ConsoleCanceled, settings.lang));
+                } else {
+                    showNotice("Failed to copy image");
+                }
+            };
+        });
+    };
+
+    auto addPhotoFromDesktopFolder = [&]() {
+        openPrompt(PromptKind::Text, tr(Key::PromptImageName, settings.lang), importFromDesktopFolder);
+    };
 
-        std::string finalName;
-        if (copyToFolderUnique(src.string(), IMAGES, finalName)) {
-            std::cout << tr(Key::ConsoleAddedImage, settings.lang) << finalName << "\n";
+    // the photo leaves the listing as soon as the answer is yes; the file is removed by a job,
+    // and if that fails it is put back. What is kept about it (thumbnail, metadata, favorite
+    // mark) is only dropped once the file is really gone.
+    auto deleteCurrent = [&]() {
+        if (photos.empty()) return;
+        std::string path = photos[photoIdx];
+        openPrompt(PromptKind::Confirm, tr(Key::PromptDelete, settings.lang) + baseName(path), [&, path](const std::string&) {
+            std::string file = baseName(path);
+            decoder.forget(path);
+            cache.erase(path);
+            library.remove(path);
+
+            jobQueue.submit(tr(Key::JobDelete, settings.lang) + file, [&, path](JobQueue::Job&) -> JobQueue::Finish {
+                std::error_code ec;
+                fs::remove(path, ec);
+                if (!ec) {
+                    hashes.remove(path);
+                    return [&, path] {
+                        thumbs.forget(path);
+                        metadata.forget(path);
+                        favorites.erase(path);
+                    };
+                }
+                std::string error = ec.message();
+                return [&, path, error] {
+                    showNotice("Delete error: " + error);
+                    library.add(path);
+                    metadata.sync(library.all());
+                };
+            });
+
+            photos = applyFilters();
+            if (photos.empty()) return;
+
+            if (photoIdx >= (int)photos.size()) photoIdx = (int)photos.size() - 1;
+            showCurrentPhoto();
+            applyLanguage();
+        });
+    };
+
+    auto runCommand = [&](const std::string& input) {
+        std::string line = trim(input);
+        auto space = line.find(' ');
+        std::string cmd = toLower(line.substr(0, space));
+        std::string arg = space == std::string::npos ? "" : trim(line.substr(space + 1));
+        if (cmd.empty()) return;
+        if (cmd == "add") {
+            if (arg.empty()) addPhotoFromDesktopFolder();
+            else importFromDesktopFolder(arg);
+        } else if (cmd == "import") {
+            importFromDesktopFolder("*");
+        } else if (cmd == "rescan") {
+            library.startScan();
+            videoLibrary.startScan();
+            showNotice(tr(Key::ConsoleRescan, settings.lang));
+        } else if (cmd == "cancel") {
+            jobQueue.cancel();
         } else {
-            std::cout << "Failed to copy image\n";
+            showNotice(tr(Key::ConsoleUnknownCommand, settings.lang) + cmd);
         }
     };
 
-    auto openVideoFromDesktopFolder = [&]() {
-        std::cout << "\n" << tr(Key::ConsoleSourceFolder, settings.lang) << SOURCE_PHOTOS << "\n";
-        std::cout << tr(Key::ConsoleEnterVideoName, settings.lang);
+    auto gridColumns = [&]() {
+        return std::max(1, (int)(((float)window.getSize().x - GRID_PAD * 2.f) / GRID_CELL));
+    };
 
-        std::string name;
-        std::getline(std::cin, name);
-        name = trim(name);
+    auto gridViewHeight = [&]() {
+        return std::max(GRID_CELL, (float)window.getSize().y - barH - GRID_TOP);
+    };
 
-        if (name.empty()) {
-            std::cout << tr(Key::ConsoleCanceled, settings.lang) << "\n";
-            return;
-        }
+    auto clampGridScroll = [&]() {
+        int rows = ((int)photos.size() + gridColumns() - 1) / gridColumns();
+        float maxScroll = std::max(0.f, rows * GRID_CELL - gridViewHeight());
+        gridScroll = std::clamp(gridScroll, 0.f, maxScroll);
+    };
 
-        fs::path src = fs::path(SOURCE_PHOTOS) / name;
-        if (!fs::exists(src)) {
-            std::cout << tr(Key::ConsoleNotFound, settings.lang) << src << "\n";
+    auto updateGridCaption = [&]() {
+        if (photos.empty()) {
+            caption.setString("");
+            counter.setString("0 / 0");
             return;
         }
-        openInDefaultApp(src.string());
+        std::string file = baseName(photos[gridSel]);
+        VideoInfo info;
+        if (!videoGrid) caption.setString((favorites.contains(photos[gridSel]) ? "★ " : "") + file);
+        else if (videoInfo.get(photos[gridSel], info) && info.durationMs) caption.setString(file + "   " + formatDuration(info.durationMs));
+        else caption.setString(file);
+        counter.setString(std::to_string(gridSel + 1) + " / " + std::to_string(photos.size()));
     };
 
-    auto deleteCurrent = [&]() {
+    auto selectGrid = [&](int idx) {
         if (photos.empty()) return;
+        gridSel = std::clamp(idx, 0, (int)photos.size() - 1);
+        float top = (float)(gridSel / gridColumns()) * GRID_CELL;
+        if (top < gridScroll) gridScroll = top;
+        if (top + GRID_CELL > gridScroll + gridViewHeight()) gridScroll = top + GRID_CELL - gridViewHeight();
+        clampGridScroll();
+        updateGridCaption();
+    };
 
-        std::string file = baseName(photos[photoIdx]);
-        std::cout << "\n" << tr(Key::ConsoleDeleteAsk, settings.lang) << file << "\n";
+    auto enterGrid = [&]() {
+        for (auto& c : gridCells) atlas.release(c.second.slot);
+        gridCells.clear();
+        slideshow = false;
+        layoutViewer();
+        selectGrid(photoIdx);
+    };
 
-        std::string ans;
-        std::getline(std::cin, ans);
-        ans = toLower(trim(ans));
-        if (!(ans == "y" || ans == "yes")) return;
+    // re-filter on every keystroke; the grid restarts at the first match
+    auto runSearch = [&]() {
+        photos = applyFilters();
+        photoIdx = 0;
+        gridScroll = 0.f;
+        enterGrid();
+        chromeDirty = true;
+    };
 
-        std::error_code ec;
-        fs::remove(fs::path(IMAGES) / file, ec);
-        if (ec) std::cout << "Delete error: " << ec.message() << "\n";
+    // O: next sort key, Shift+O: reverse; the current photo stays selected
+    auto changeSort = [&](bool reverse) {
+        if (reverse) settings.sortDescending = !settings.sortDescending;
+        else settings.sortKey = (SortKey)(((int)settings.sortKey + 1) % 4);
+        saveSettings(catalog, settings);
+        std::string current = photos.empty() ? "" : photos[photoIdx];
+        photos = applyFilters();
+        auto it = std::find(photos.begin(), photos.end(), current);
+        photoIdx = it == photos.end() ? 0 : (int)(it - photos.begin());
+        chromeDirty = true;
+    };
 
-        if (inList(favorites, file)) {
-            toggleInList(favorites, file);
-            saveLines(FAVORITES_FILE, favorites);
+    // give atlas slots to visible rows only; everything else goes back to the atlas.
+    // Returns true while thumbnails are still arriving.
+    auto updateGridCells = [&]() -> bool {
+        PROFILE_ZONE("grid cells");
+        int cols = gridColumns();
+        int first = (int)(gridScroll / GRID_CELL) * cols;
+        int last  = std::min((int)photos.size(), ((int)((gridScroll + gridViewHeight()) / GRID_CELL) + 1) * cols);
+
+        for (auto it = gridCells.begin(); it != gridCells.end(); ) {
+            if (it->first < first || it->first >= last) {
+                atlas.release(it->second.slot);
+                it = gridCells.erase(it);
+            } else ++it;
         }
 
-        photos = applyFilters();
-        if (photos.empty()) return;
+        int uploads = 0;
+        const LibraryIndex& listing = videoGrid ? videoLibrary : library;
+        std::vector<LibraryIndex::Entry> missing;
+        for (int i = first; i < last; i++) {
+            auto& cell = gridCells[i];
+            if (cell.ready) continue;
+            if (cell.slot < 0) cell.slot = atlas.acquire();
+            const auto* e = listing.find(photos[i]);
+            if (!e) continue;
+            if (cell.slot >= 0 && uploads < GRID_UPLOADS_PER_FRAME &&
+                thumbs.copyTo(e->path, e->mtime, thumbBuf.data())) {
+                atlas.upload(cell.slot, thumbBuf.data());
+                cell.ready = true;
+                uploads++;
+            } else {
+                missing.push_back(*e);
+            }
+        }
+        // one screen ahead so scrolling down finds thumbnails ready
+        for (int i = last; i < std::min((int)photos.size(), last + (last - first)); i++)
+            if (const auto* e = listing.find(photos[i])) missing.push_back(*e);
+        // posters are made by the video store, which works through the whole listing by itself
+        if (videoGrid) return uploads == GRID_UPLOADS_PER_FRAME || videoInfo.pending() > 0;
+        thumbs.request(missing);
+        return uploads == GRID_UPLOADS_PER_FRAME || thumbs.busy();
+    };
 
-        if (photoIdx >= (int)photos.size()) photoIdx = (int)photos.size() - 1;
-        loadCurrentPhoto();
+    auto gridIndexAt = [&](sf::Vector2f p) {
+        if (p.y < GRID_TOP || p.y > GRID_TOP + gridViewHeight()) return -1;
+        int col = (int)((p.x - GRID_PAD) / GRID_CELL);
+        if (p.x < GRID_PAD || col >= gridColumns()) return -1;
+        int row = (int)((p.y - GRID_TOP + gridScroll) / GRID_CELL);
+        int idx = row * gridColumns() + col;
+        return idx < (int)photos.size() ? idx : -1;
+    };
+
+    auto enterVideos = [&]() -> bool {
+        videoLibrary.startScan();
+        videoLibrary.pollScan();
+        opening = videoLibrary.scanning() && videoLibrary.size() == 0 ? Opening::Videos : Opening::None;
+        if (opening != Opening::None) return false;
+        videoInfo.sync(videoLibrary.all());
+        photos = videoLibrary.paths();
+        if (photos.empty()) {
+            std::cout << tr(Key::ConsoleNoVideos, settings.lang) << "\n";
+            std::cout << "Videos dir: " << fs::absolute(VIDEOS) << "\n";
+            return false;
+        }
+        videoGrid = true;
+        searchQuery.clear();
+        searchActive = false;
+        photoIdx = 0;
+        gridScroll = 0.f;
+        refreshBarColors();
+        enterGrid();
+        chromeDirty = true;
+        return true;
+    };
+
+    auto openFromGrid = [&](Screen& screen) {
+        if (photos.empty()) return;
+        if (videoGrid) {
+            openInDefaultApp(photos[gridSel]);
+            return;
+        }
+        photoIdx = gridSel;
+        pendingIdx = -1;
+        fade = 1.f;
+        fromTex.reset();
+        showCurrentPhoto();
         applyLanguage();
+        screen = Screen::Photos;
     };
 
     auto runMenuAction = [&](int index, Screen& screen) {
+        opening = Opening::None;
         if (index == 0) {
             if (enterPhotos()) screen = Screen::Photos;
         } else if (index == 1) {
-            openVideoFromDesktopFolder();
+            if (enterVideos()) screen = Screen::Grid;
         } else if (index == 2) {
             addPhotoFromDesktopFolder();
         } else if (index == 3) {
@@ -614,47 +1197,334 @@ int main() {
     applyLanguage();
 
     Screen screen = Screen::Menu;
+    sf::Vector2f mouse;
+    Screen shownScreen = screen;
+    bool redraw = true;
+    bool gridBusy = false;
+    std::size_t scansReported = 0;
+
+    // idle accounting: frames actually drawn, sleeps in waitEvent, process CPU share
+    std::uint64_t framesDrawn = 0, idleWaits = 0;
+    float cpuPercent = 0.f;
+    std::clock_t cpuMark = std::clock();
+    const std::clock_t cpuStart = cpuMark;
+    sf::Clock cpuWindow, runClock;
+
+    // ---------- retained scene ----------
+    struct MenuItemView {
+        sf::RectangleShape bg, strip;
+        CachedText label, desc, arrow;
+        bool active = false;
+        explicit MenuItemView(TextCache& t) : label(t), desc(t, "", 15), arrow(t, ">", 24) {}
+    };
+    sf::CircleShape menuGlow1(260.f), menuGlow2(320.f);
+    sf::RectangleShape menuCard;
+    CachedText menuTitle(texts), menuSubtitle(texts, "", 16), menuHint(texts, "", 16), menuHint2(texts, "", 15);
+    std::vector<MenuItemView> menuItems;
+
+    CachedText viewerHelp(texts, "", 13), gridHelp(texts, "", 13), searchText(texts, "", 15);
+
+    // profiler overlay (F3), refreshed twice a second
+    bool showProfiler = false;
+    sf::Clock profilerRefresh;
+    sf::RectangleShape profBg;
+    CachedText profText(texts, "", 13);
+    profBg.setFillColor(sf::Color(0,0,0,170));
+    profText.setFillColor(sf::Color(235,235,235));
+    sf::RectangleShape infoBg({480.f, 132.f});
+    CachedText infoText(texts, "", 15);
+    infoBg.setFillColor(sf::Color(0,0,0,160));
+    infoBg.setPosition({20.f, 40.f});
+    infoText.setFillColor(sf::Color(240,240,240));
+    infoText.setPosition({30.f, 48.f});
+
+    // prompt card, and the strip above the bottom bar with the running job or the last notice
+    sf::RectangleShape promptBg, jobBg, jobFill;
+    CachedText promptTitleText(texts, "", 16), promptLine(texts, "", 20), promptHint(texts, "", 13);
+    CachedText jobText(texts, "", 13);
+    jobBg.setFillColor(sf::Color(0,0,0,170));
+    jobFill.setFillColor(sf::Color(160,200,255,220));
+    jobText.setFillColor(sf::Color(235,235,235));
+
+    auto rebuildMenu = [&]() {
+        PROFILE_ZONE("text layout");
+        auto ws = window.getSize();
 
-    while (window.isOpen()) {
-        float dt = dtClock.restart().asSeconds();
-        sf::Vector2f mouse = (sf::Vector2f)sf::Mouse::getPosition(window);
+        menuGlow1.setFillColor(sf::Color(120, 160, 255, 35));
+        menuGlow1.setPosition({-80.f, -90.f});
+        menuGlow2.setFillColor(sf::Color(255, 120, 160, 22));
+        menuGlow2.setPosition({(float)ws.x - 520.f, (float)ws.y - 520.f});
+
+        menuTitle.setString(tr(Key::Title, settings.lang));
+        menuTitle.setCharacterSize((unsigned int)settings.fontSizeTitle);
+        menuTitle.setFillColor(settings.darkTheme ? sf::Color(245,245,245) : sf::Color(30,30,35));
+
+        menuSubtitle.setString(tr(Key::Subtitle, settings.lang));
+        menuSubtitle.setFillColor(settings.darkTheme ? sf::Color(180,180,180) : sf::Color(90,90,100));
+
+        sf::Vector2f cardSize(760.f, 360.f);
+        sf::Vector2f cardPos(((float)ws.x - cardSize.x) / 2.f,
+                             ((float)ws.y - cardSize.y) / 2.f + 30.f);
+
+        menuCard.setSize(cardSize);
+        menuCard.setPosition(cardPos);
+        menuCard.setFillColor(settings.darkTheme ? sf::Color(255,255,255,16) : sf::Color(0,0,0,10));
+        menuCard.setOutlineThickness(1.f);
+        menuCard.setOutlineColor(settings.darkTheme ? sf::Color(255,255,255,35) : sf::Color(0,0,0,25));
+
+        menuTitle.setPosition({cardPos.x, cardPos.y - 110.f});
+        menuSubtitle.setPosition({cardPos.x, cardPos.y - 62.f});
+
+        menuHint.setString(tr(Key::HelpTop, settings.lang));
+        menuHint.setFillColor(settings.darkTheme ? sf::Color(170,170,170) : sf::Color(100,100,110));
+        menuHint.setPosition({cardPos.x, cardPos.y + cardSize.y + 18.f});
+
+        menuHint2.setString(tr(Key::HelpBottom, settings.lang));
+        menuHint2.setFillColor(settings.darkTheme ? sf::Color(160,160,160) : sf::Color(110,110,120));
+        menuHint2.setPosition({cardPos.x, cardPos.y + cardSize.y + 42.f});
+
+        float itemX = cardPos.x + 28.f;
+        float itemY = cardPos.y + 26.f;
+        float itemH = 78.f;
+
+        menuItems.clear();
+        for (int i = 0; i < 4; i++) {
+            sf::FloatRect hit(
+                sf::Vector2f(itemX, itemY + i * itemH),
+                sf::Vector2f(cardSize.x - 56.f, itemH)
+            );
+            menuHit[i] = hit;
+            bool active = (i == menuIndex);
+
+            MenuItemView v(texts);
+            v.active = active;
+            v.bg.setSize({hit.size.x, hit.size.y});
+            v.bg.setPosition({hit.position.x, hit.position.y});
+            v.bg.setOutlineThickness(1.f);
 
-        // slideshow tick
-        if (screen == Screen::Photos && slideshow && !photos.empty()) {
-            slideTimer += dt;
-            if (slideTimer >= SLIDE_DELAY) {
-                slideTimer = 0.f;
-                requestPhoto(photoIdx + 1);
+            if (settings.darkTheme) {
+                v.bg.setFillColor(active ? sf::Color(255,255,255,28) : sf::Color(255,255,255,10));
+                v.bg.setOutlineColor(active ? sf::Color(255,255,255,70) : sf::Color(255,255,255,25));
+            } else {
+                v.bg.setFillColor(active ? sf::Color(0,0,0,12) : sf::Color(0,0,0,6));
+                v.bg.setOutlineColor(active ? sf::Color(0,0,0,55) : sf::Color(0,0,0,18));
             }
+
+            v.strip.setSize({6.f, itemH - 16.f});
+            v.strip.setPosition({itemX + 10.f, itemY + i * itemH + 8.f});
+            v.strip.setFillColor(active ? (settings.darkTheme ? sf::Color(160,200,255,200) : sf::Color(40,110,200,200))
+                                        : (settings.darkTheme ? sf::Color(255,255,255,25) : sf::Color(0,0,0,18)));
+
+            v.label.setString(menu[i]);
+            v.label.setCharacterSize((unsigned int)settings.fontSizeMenu);
+            v.label.setFillColor(settings.darkTheme ? (active ? sf::Color(250,250,250) : sf::Color(210,210,210))
+                                                    : (active ? sf::Color(30,30,35) : sf::Color(70,70,80)));
+            v.label.setPosition({itemX + 30.f, itemY + i * itemH + 12.f});
+
+            v.desc.setString(desc[i]);
+            v.desc.setFillColor(settings.darkTheme ? (active ? sf::Color(190,200,215) : sf::Color(160,160,170))
+                                                   : (active ? sf::Color(70,90,110) : sf::Color(110,110,120)));
+            v.desc.setPosition({itemX + 30.f, itemY + i * itemH + 44.f});
+
+            v.arrow.setFillColor(settings.darkTheme ? sf::Color(240,240,240) : sf::Color(60,60,70));
+            v.arrow.setPosition({itemX + cardSize.x - 86.f, itemY + i * itemH + 18.f});
+
+            menuItems.push_back(std::move(v));
         }
+        menuDirty = false;
+    };
 
-        // fade tick
-        if (screen == Screen::Photos && (fadingOut || fadingIn)) {
-            if (fadingOut) {
-                fade -= 600.f * dt;
-                if (fade <= 0.f) {
-                    fade = 0.f;
-                    fadingOut = false;
+    // help lines for the viewer and the grid (language / theme)
+    auto rebuildChrome = [&]() {
+        PROFILE_ZONE("text layout");
+        sf::Color helpColor = settings.darkTheme ? sf::Color(175,175,175) : sf::Color(90,90,100);
+        viewerHelp.setString((settings.lang == Lang::RU)
+            ? "Клавиши: ←/→ | P авто | I инфо | S избранное | F фильтр | O сортировка | D удалить | G сетка | колесо/Z масштаб (стрелки/мышь двигают) | L язык | Esc меню"
+            : "Keys: LEFT/RIGHT | P play | I info | S star | F filter | O sort | D delete | G grid | wheel/Z zoom (arrows/drag pan) | L language | ESC menu");
+        viewerHelp.setFillColor(helpColor);
+        viewerHelp.setPosition({20.f, 14.f});
+
+        static const char* SORT_EN[] = {"name", "date", "size", "resolution"};
+        static const char* SORT_RU[] = {"имя", "дата", "размер", "разрешение"};
+        std::string sortName = std::string(settings.lang == Lang::RU ? SORT_RU[(int)settings.sortKey] : SORT_EN[(int)settings.sortKey])
+                             + (settings.sortDescending ? " ↓" : " ↑");
+        if (videoGrid)
+            gridHelp.setString((settings.lang == Lang::RU)
+                ? "Видео: стрелки/колесо | Enter/G открыть в плеере | Esc меню"
+                : "Videos: arrows/wheel | ENTER/G play in the system player | ESC menu");
+        else
+            gridHelp.setString((settings.lang == Lang::RU)
+                ? "Сетка: стрелки/колесо | Enter/G открыть | / поиск | O сортировка: " + sortName + " | Esc меню"
+                : "Grid: arrows/wheel | ENTER/G open | / search | O sort: " + sortName + " | ESC menu");
+        gridHelp.setFillColor(helpColor);
+        gridHelp.setPosition({20.f, 14.f});
+
+        searchText.setString(std::string(settings.lang == Lang::RU ? "Поиск: " : "Search: ") + searchQuery
+                             + (searchActive ? "_" : "") + "   (" + std::to_string(photos.size()) + ")");
+        searchText.setFillColor(settings.darkTheme ? sf::Color(235,235,235) : sf::Color(30,30,35));
+        searchText.setPosition({20.f, 11.f});
+        chromeDirty = false;
+    };
 
-                    if (pendingIdx != -1) {
-                        photoIdx = pendingIdx;
-                        pendingIdx = -1;
-                        loadCurrentPhoto();
-                        applyLanguage();
-                    }
-                    fadingIn = true;
-                }
-            } else if (fadingIn) {
-                fade += 600.f * dt;
-                if (fade >= 255.f) {
-                    fade = 255.f;
-                    fadingIn = false;
-                }
-            }
+    // info panel text (photo change, toggle, language, and once a second for metadata that
+    // arrives in the background); sized to the text. Decoder and cache counters are in the
+    // F3 overlay.
+    auto rebuildInfo = [&]() {
+        PROFILE_ZONE("text layout");
+        infoDirty = false;
+        if (photos.empty()) return;
+
+        // header metadata is read in the background; until it arrives, fall back to the decoded size
+        auto imgSize = tex->fullSize;
+        ImageMeta meta;
+        bool haveMeta = metadata.get(photos[photoIdx], meta);
+        if (haveMeta && meta.width && meta.height) imgSize = {meta.width, meta.height};
+        std::uint64_t kb = meta.fileSize / 1024;
+        std::string dateText = meta.captureDate.empty() ? "-" : meta.captureDate;
+        std::string cameraText = meta.camera.empty() ? "-" : meta.camera;
+        std::string orientText = std::to_string(meta.orientation);
+
+        std::string file = baseName(photos[photoIdx]);
+        bool fav = favorites.contains(photos[photoIdx]);
+        std::string captionText;
+        if (!catalog.get(CatalogTable::Captions, libraryKey(IMAGES, photos[photoIdx]), captionText)) captionText = "-";
+
+        if (settings.lang == Lang::RU) {
+            infoText.setString(
+                std::string("Файл: ") + file + "\n" +
+                "Подпись: " + captionText + "\n" +
+                "Разрешение: " + std::to_string(imgSize.x) + " x " + std::to_string(imgSize.y) + "\n" +
+                "Размер: " + std::to_string(kb) + " KB\n" +
+                "Дата съёмки: " + dateText + "\n" +
+                "Камера: " + cameraText + "\n" +
+                "Ориентация (EXIF): " + orientText + "\n" +
+                "Источник: Desktop/Photos\n" +
+                (fav ? "★ Избранное" : "")
+            );
+        } else {
+            infoText.setString(
+                std::string("File: ") + file + "\n" +
+                "Caption: " + captionText + "\n" +
+                "Resolution: " + std::to_string(imgSize.x) + " x " + std::to_string(imgSize.y) + "\n" +
+                "Size: " + std::to_string(kb) + " KB\n" +
+                "Taken: " + dateText + "\n" +
+                "Camera: " + cameraText + "\n" +
+                "Orientation (EXIF): " + orientText + "\n" +
+                "Source: Desktop/Photos\n" +
+                (fav ? "★ Favorite" : "")
+            );
+        }
+        auto b = infoText.getLocalBounds();
+        infoBg.setSize({480.f, std::max(132.f, b.position.y + b.size.y + 24.f)});
+    };
+
+    auto rebuildProfiler = [&]() {
+        auto r = Profiler::instance().takeReport();
+        float secs = std::max(0.001f, profilerRefresh.restart().asSeconds());
+        char line[160];
+        std::snprintf(line, sizeof(line), "frame ms  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f  (%.0f fps)\n",
+                      r.p50, r.p95, r.p99, r.maxMs, (double)r.frames / secs);
+        std::string text = line;
+        text += "zone              ms/frame   calls\n";
+        for (auto& z : r.zones) {
+            if (z.name == "frame") continue;
+            std::snprintf(line, sizeof(line), "%-16s %9.2f %7llu\n", z.name.c_str(),
+                          r.frames ? z.totalMs / (double)r.frames : z.totalMs, (unsigned long long)z.calls);
+            text += line;
+        }
+        double frames = (double)std::max<std::uint64_t>(1, r.frames);
+        std::snprintf(line, sizeof(line), "draw calls %.1f  vertices %.0f  upload %.1f KB  (per frame)\n",
+                      (double)renderStats.drawCalls / frames, (double)renderStats.vertices / frames,
+                      (double)renderStats.uploadBytes / frames / 1024.0);
+        text += line;
+        auto ds = decoder.getStats();
+        std::snprintf(line, sizeof(line), "prefetch hit/miss %llu / %llu  cache RAM %llu MB  VRAM %llu MB\n",
+                      (unsigned long long)ds.hits, (unsigned long long)ds.misses,
+                      (unsigned long long)(cache.ramBytes() >> 20), (unsigned long long)(cache.vramBytes() >> 20));
+        text += line;
+        std::snprintf(line, sizeof(line), "cpu %d%%  frames drawn %llu  idle waits %llu\n", (int)(cpuPercent + 0.5f),
+                      (unsigned long long)framesDrawn, (unsigned long long)idleWaits);
+        text += line;
+        renderStats = RenderStats{};
+        profText.setString(text);
+        auto b = profText.getLocalBounds();
+        float w = b.size.x + 20.f, h = b.size.y + 20.f;
+        float x = (float)window.getSize().x - w - 20.f;
+        profBg.setSize({w, h});
+        profBg.setPosition({x, 40.f});
+        profText.setPosition({x + 10.f, 48.f});
+    };
+
+    auto rebuildPrompt = [&]() {
+        PROFILE_ZONE("text layout");
+        auto ws = window.getSize();
+        float w = std::min(680.f, (float)ws.x - 40.f);
+        float h = promptKind == PromptKind::Text ? 132.f : 96.f;
+        sf::Vector2f pos(((float)ws.x - w) / 2.f, ((float)ws.y - h) / 2.f);
+        promptBg.setSize({w, h});
+        promptBg.setPosition(pos);
+        promptBg.setOutlineThickness(1.f);
+        promptBg.setFillColor(settings.darkTheme ? sf::Color(28,28,36,245) : sf::Color(255,255,255,245));
+        promptBg.setOutlineColor(settings.darkTheme ? sf::Color(160,200,255,140) : sf::Color(40,110,200,140));
+
+        sf::Color fg = settings.darkTheme ? sf::Color(240,240,240) : sf::Color(30,30,35);
+        promptTitleText.setString(promptTitle);
+        promptTitleText.setFillColor(fg);
+        promptTitleText.setPosition({pos.x + 20.f, pos.y + 16.f});
+        promptLine.setString("> " + promptInput + "_");
+        promptLine.setFillColor(fg);
+        promptLine.setPosition({pos.x + 20.f, pos.y + 50.f});
+        promptHint.setString(tr(promptKind == PromptKind::Text ? Key::PromptTextHint : Key::PromptConfirmHint, settings.lang));
+        promptHint.setFillColor(settings.darkTheme ? sf::Color(175,175,175) : sf::Color(90,90,100));
+        promptHint.setPosition({pos.x + 20.f, pos.y + h - 30.f});
+        promptDirty = false;
+    };
+
+    // false when there is neither a running job nor a fresh notice to show
+    auto layoutJobStrip = [&]() -> bool {
+        auto st = jobQueue.status();
+        if (!notice.empty() && noticeClock.getElapsedTime().asSeconds() >= NOTICE_SECONDS) notice.clear();
+        if (!st.running && notice.empty() && opening == Opening::None) return false;
+
+        std::string text = notice;
+        if (opening != Opening::None && notice.empty()) {
+            auto p = (opening == Opening::Photos ? library : videoLibrary).scanProgress();
+            text = tr(opening == Opening::Photos ? Key::ScanPhotos : Key::ScanVideos, settings.lang) + "...  " +
+                   std::to_string(p.dirs) + tr(Key::ScanFolders, settings.lang);
+        }
+        if (st.running) {
+            text = st.label;
+            if (st.total) text += "  " + std::to_string(st.done) + " / " + std::to_string(st.total);
+            if (!st.detail.empty()) text += "  " + st.detail;
+            if (st.queued) text += "  (+" + std::to_string(st.queued) + ")";
+            text += "   " + tr(st.cancelling ? Key::JobCancelling : Key::JobCancelHint, settings.lang);
         }
+        jobText.setString(text);
 
-        // hover buttons
-        if (screen == Screen::Photos) {
+        auto ws = window.getSize();
+        float w = std::max(320.f, jobText.getLocalBounds().size.x + 24.f), h = 34.f;
+        float bottom = (float)ws.y - (screen == Screen::Menu ? 0.f : barH) - 12.f;
+        sf::Vector2f pos((float)ws.x - w - 20.f, bottom - h);
+        jobBg.setSize({w, h});
+        jobBg.setPosition(pos);
+        float frac = st.running && st.total ? (float)st.done / (float)st.total : 0.f;
+        jobFill.setSize({w * frac, 3.f});
+        jobFill.setPosition({pos.x, pos.y + h - 3.f});
+        jobText.setPosition({pos.x + 12.f, pos.y + 8.f});
+        return true;
+    };
+
+    auto updateHover = [&]() {
+        if (screen == Screen::Menu) {
+            for (int i = 0; i < 4; i++) {
+                if (menuHit[i].contains(mouse) && menuIndex != i) {
+                    menuIndex = i;
+                    menuDirty = true;
+                }
+            }
+        } else if (screen == Screen::Grid) {
+            btnBack.setHovered(btnBack.contains(mouse), settings.darkTheme);
+        } else {
             btnPrev.setHovered(btnPrev.contains(mouse), settings.darkTheme);
             btnNext.setHovered(btnNext.contains(mouse), settings.darkTheme);
             btnPlay.setHovered(btnPlay.contains(mouse), settings.darkTheme);
@@ -664,312 +1534,627 @@ int main() {
             btnDel .setHovered(btnDel .contains(mouse), settings.darkTheme);
             btnBack.setHovered(btnBack.contains(mouse), settings.darkTheme);
         }
+    };
+
+    auto handleEvent = [&](const sf::Event& ev) {
+        redraw = true;
+
+        if (const auto* mm = ev.getIf<sf::Event::MouseMoved>()) {
+            sf::Vector2f moved = sf::Vector2f(mm->position) - mouse;
+            mouse = sf::Vector2f(mm->position);
+            if (panning) {
+                pan += moved;
+                layoutViewer();
+            }
+            updateHover();
+        }
+        if (const auto* mb = ev.getIf<sf::Event::MouseButtonReleased>())
+            if (mb->button == sf::Mouse::Button::Left) panning = false;
+        if (const auto* mb = ev.getIf<sf::Event::MouseButtonPressed>()) mouse = sf::Vector2f(mb->position);
+
+        if (ev.is<sf::Event::Closed>()) window.close();
+
+        if (const auto* r = ev.getIf<sf::Event::Resized>()) {
+            window.setView(sf::View(sf::FloatRect(
+                sf::Vector2f(0.f, 0.f),
+                sf::Vector2f((float)r->size.x, (float)r->size.y)
+            )));
+            menuDirty = true;
+            if (screen == Screen::Photos) {
+                layoutViewer();
+                prefetchAround();
+            }
+            if (screen == Screen::Grid) {
+                layoutViewer();
+                selectGrid(gridSel);
+            }
+            promptDirty = true;
+        }
 
-        while (const auto ev = window.pollEvent()) {
-            if (ev->is<sf::Event::Closed>()) window.close();
+        // an open prompt takes every key; the screen under it stays as it is
+        if (promptKind != PromptKind::None) {
+            if (const auto* te = ev.getIf<sf::Event::TextEntered>(); te && promptKind == PromptKind::Text) {
+                if (te->unicode == 8) popUtf8(promptInput);
+                else if (te->unicode >= 32 && te->unicode != 127) appendUtf8(promptInput, te->unicode);
+                promptDirty = true;
+            }
+            if (const auto* k = ev.getIf<sf::Event::KeyPressed>()) {
+                bool confirm = promptKind == PromptKind::Confirm;
+                bool yes = k->code == sf::Keyboard::Key::Enter || (confirm && k->code == sf::Keyboard::Key::Y);
+                bool no = k->code == sf::Keyboard::Key::Escape || (confirm && k->code == sf::Keyboard::Key::N);
+                if (yes || no) {
+                    // closed first: the answer may open the next prompt
+                    auto accept = std::move(promptAccept);
+                    promptAccept = nullptr;
+                    promptKind = PromptKind::None;
+                    if (yes && accept) accept(promptInput);
+                    if (screen != Screen::Menu && photos.empty()) screen = Screen::Menu;
+                }
+            }
+            return;
+        }
 
-            if (const auto* r = ev->getIf<sf::Event::Resized>()) {
-                window.setView(sf::View(sf::FloatRect(
-                    sf::Vector2f(0.f, 0.f),
-                    sf::Vector2f((float)r->size.x, (float)r->size.y)
-                )));
-                if (screen == Screen::Photos) layoutViewer();
+        if (const auto* w = ev.getIf<sf::Event::MouseWheelScrolled>()) {
+            if (screen == Screen::Grid) {
+                gridScroll -= w->delta * GRID_CELL * 0.5f;
+                clampGridScroll();
+            }
+            if (screen == Screen::Photos && !photos.empty()) {
+                float next = std::clamp(zoom * std::pow(1.25f, w->delta), 1.f, MAX_ZOOM);
+                pan *= next / zoom;   // keep the same spot in the middle
+                zoom = next;
+                layoutViewer();
+                prefetchAround();
             }
+        }
 
-            if (const auto* k = ev->getIf<sf::Event::KeyPressed>()) {
-                if (k->code == sf::Keyboard::Key::Escape) {
-                    if (screen == Screen::Photos) screen = Screen::Menu;
-                    else window.close();
+        // typing into the search box; "/" opens it
+        if (const auto* te = ev.getIf<sf::Event::TextEntered>()) {
+            if (screen == Screen::Grid && !videoGrid && !searchActive && te->unicode == U'/') {
+                searchActive = true;
+                chromeDirty = true;
+            } else if (searchActive) {
+                if (te->unicode == 8) {
+                    popUtf8(searchQuery);
+                    runSearch();
+                } else if (te->unicode >= 32 && te->unicode != 127) {
+                    appendUtf8(searchQuery, te->unicode);
+                    runSearch();
                 }
+            }
+        }
+
+        // while the search box has focus keys are text, except ESC (clear) and ENTER (done)
+        if (const auto* k = ev.getIf<sf::Event::KeyPressed>(); k && searchActive) {
+            if (k->code == sf::Keyboard::Key::Escape) {
+                searchQuery.clear();
+                searchActive = false;
+                runSearch();
+            }
+            if (k->code == sf::Keyboard::Key::Enter) {
+                searchActive = false;
+                chromeDirty = true;
+            }
+        } else if (k && screen == Screen::Grid && k->code == sf::Keyboard::Key::Escape && !searchQuery.empty()) {
+            searchQuery.clear();
+            runSearch();
+        } else if (k) {
+            if (k->code == sf::Keyboard::Key::P && (k->control || k->system)) {
+                openPrompt(PromptKind::Text, tr(Key::PromptCommand, settings.lang), runCommand);
+                return;
+            }
+            if (k->code == sf::Keyboard::Key::X && jobQueue.busy()) jobQueue.cancel();
+
+            if (k->code == sf::Keyboard::Key::Escape) {
+                if (screen != Screen::Menu) screen = Screen::Menu;
+                else window.close();
+            }
+
+            if (k->code == sf::Keyboard::Key::T) {
+                settings.darkTheme = !settings.darkTheme;
+                saveSettings(catalog, settings);
+                refreshBarColors();
+                if (screen != Screen::Menu) layoutViewer();
+                menuDirty = chromeDirty = infoDirty = true;
+            }
 
-                if (k->code == sf::Keyboard::Key::T) {
-                    settings.darkTheme = !settings.darkTheme;
-                    saveSettings(SETTINGS_FILE, settings);
-                    refreshBarColors();
-                    if (screen == Screen::Photos) layoutViewer();
+            if (k->code == sf::Keyboard::Key::F3) {
+                showProfiler = !showProfiler;
+                if (showProfiler) rebuildProfiler();
+            }
+
+            if (k->code == sf::Keyboard::Key::L) {
+                settings.lang = (settings.lang == Lang::EN) ? Lang::RU : Lang::EN;
+                saveSettings(catalog, settings);
+                applyLanguage();
+            }
+
+            if (screen == Screen::Menu) {
+                if (k->code == sf::Keyboard::Key::Up) { menuIndex = (menuIndex - 1 + 4) % 4; menuDirty = true; }
+                if (k->code == sf::Keyboard::Key::Down) { menuIndex = (menuIndex + 1) % 4; menuDirty = true; }
+                if (k->code == sf::Keyboard::Key::Enter) runMenuAction(menuIndex, screen);
+                if (k->code == sf::Keyboard::Key::G && enterPhotos()) {
+                    enterGrid();
+                    screen = Screen::Grid;
+                }
+            } else if (screen == Screen::Grid) {
+                int cols = gridColumns();
+                int page = std::max(1, (int)(gridViewHeight() / GRID_CELL)) * cols;
+                if (k->code == sf::Keyboard::Key::Left)     selectGrid(gridSel - 1);
+                if (k->code == sf::Keyboard::Key::Right)    selectGrid(gridSel + 1);
+                if (k->code == sf::Keyboard::Key::Up)       selectGrid(gridSel - cols);
+                if (k->code == sf::Keyboard::Key::Down)     selectGrid(gridSel + cols);
+                if (k->code == sf::Keyboard::Key::PageUp)   selectGrid(gridSel - page);
+                if (k->code == sf::Keyboard::Key::PageDown) selectGrid(gridSel + page);
+                if (k->code == sf::Keyboard::Key::Home)     selectGrid(0);
+                if (k->code == sf::Keyboard::Key::End)      selectGrid((int)photos.size() - 1);
+                if (k->code == sf::Keyboard::Key::O && !videoGrid) {
+                    changeSort(k->shift);
+                    enterGrid();
+                }
+                if (k->code == sf::Keyboard::Key::Enter || k->code == sf::Keyboard::Key::G) openFromGrid(screen);
+            } else {
+                if (k->code == sf::Keyboard::Key::G) {
+                    enterGrid();
+                    screen = Screen::Grid;
                 }
 
-                if (k->code == sf::Keyboard::Key::L) {
-                    settings.lang = (settings.lang == Lang::EN) ? Lang::RU : Lang::EN;
-                    saveSettings(SETTINGS_FILE, settings);
-                    applyLanguage();
+                if (k->code == sf::Keyboard::Key::Z) {
+                    zoom = 1.f;
+                    layoutViewer();
+                    prefetchAround();
                 }
 
-                if (screen == Screen::Menu) {
-                    if (k->code == sf::Keyboard::Key::Up) menuIndex = (menuIndex - 1 + 4) % 4;
-                    if (k->code == sf::Keyboard::Key::Down) menuIndex = (menuIndex + 1) % 4;
-                    if (k->code == sf::Keyboard::Key::Enter) runMenuAction(menuIndex, screen);
+                // zoomed in, the arrows move around the photo; otherwise left/right step
+                if (zoom > 1.f) {
+                    const float STEP = 120.f;
+                    sf::Vector2f step;
+                    if (k->code == sf::Keyboard::Key::Left)  step.x = STEP;
+                    if (k->code == sf::Keyboard::Key::Right) step.x = -STEP;
+                    if (k->code == sf::Keyboard::Key::Up)    step.y = STEP;
+                    if (k->code == sf::Keyboard::Key::Down)  step.y = -STEP;
+                    if (step != sf::Vector2f()) {
+                        pan += step;
+                        layoutViewer();
+                    }
                 } else {
                     if (k->code == sf::Keyboard::Key::Left)  requestPhoto(photoIdx - 1);
                     if (k->code == sf::Keyboard::Key::Right) requestPhoto(photoIdx + 1);
+                }
+                if (k->code == sf::Keyboard::Key::O && !photos.empty()) {
+                    changeSort(k->shift);
+                    showCurrentPhoto();
+                }
 
-                    if (k->code == sf::Keyboard::Key::P) {
+                if (k->code == sf::Keyboard::Key::P) {
+                    slideshow = !slideshow;
+                    slideDue = slideClock.getElapsedTime().asSeconds() + SLIDE_DELAY;
+                    prefetchAround();
+                    btnPlay.setLabel(slideshow ? tr(Key::BtnPause, settings.lang) : tr(Key::BtnPlay, settings.lang));
+                }
+
+                if (k->code == sf::Keyboard::Key::I) {
+                    showInfo = !showInfo;
+                    infoDirty = true;
+                    btnInfo.setLabel(showInfo ? tr(Key::BtnInfoOn, settings.lang) : tr(Key::BtnInfo, settings.lang));
+                }
+
+                if (k->code == sf::Keyboard::Key::F) {
+                    settings.showFavoritesOnly = !settings.showFavoritesOnly;
+                    saveSettings(catalog, settings);
+                    photos = applyFilters();
+                    photoIdx = 0;
+                    btnFav.setLabel(settings.showFavoritesOnly ? tr(Key::BtnFavOn, settings.lang) : tr(Key::BtnFavOff, settings.lang));
+                    if (!photos.empty()) showCurrentPhoto();
+                    else screen = Screen::Menu;
+                    applyLanguage();
+                }
+
+                if (k->code == sf::Keyboard::Key::S) {
+                    if (!photos.empty()) {
+                        favorites.toggle(photos[photoIdx]);
+                        table.setFavorite(photos[photoIdx], favorites.contains(photos[photoIdx]));
+                        updatePhotoCaption();
+                        applyLanguage();
+                    }
+                }
+
+                if (k->code == sf::Keyboard::Key::D) deleteCurrent();
+            }
+        }
+
+        if (const auto* mb = ev.getIf<sf::Event::MouseButtonPressed>()) {
+            if (mb->button == sf::Mouse::Button::Left) {
+                if (screen == Screen::Menu) {
+                    for (int i = 0; i < 4; i++) {
+                        if (menuHit[i].contains(mouse)) {
+                            menuIndex = i;
+                            runMenuAction(i, screen);
+                            break;
+                        }
+                    }
+                } else if (screen == Screen::Grid) {
+                    if (btnBack.contains(mouse)) screen = Screen::Menu;
+                    else {
+                        int idx = gridIndexAt(mouse);
+                        if (idx == gridSel) openFromGrid(screen);
+                        else if (idx >= 0) selectGrid(idx);
+                    }
+                } else {
+                    if (btnPrev.contains(mouse)) requestPhoto(photoIdx - 1);
+                    else if (btnNext.contains(mouse)) requestPhoto(photoIdx + 1);
+                    else if (btnPlay.contains(mouse)) {
                         slideshow = !slideshow;
-                        slideTimer = 0.f;
+                        slideDue = slideClock.getElapsedTime().asSeconds() + SLIDE_DELAY;
+                        prefetchAround();
                         btnPlay.setLabel(slideshow ? tr(Key::BtnPause, settings.lang) : tr(Key::BtnPlay, settings.lang));
                     }
-
-                    if (k->code == sf::Keyboard::Key::I) {
+                    else if (btnInfo.contains(mouse)) {
                         showInfo = !showInfo;
+                        infoDirty = true;
                         btnInfo.setLabel(showInfo ? tr(Key::BtnInfoOn, settings.lang) : tr(Key::BtnInfo, settings.lang));
                     }
-
-                    if (k->code == sf::Keyboard::Key::F) {
+                    else if (btnStar.contains(mouse)) {
+                        if (!photos.empty()) {
+                            favorites.toggle(photos[photoIdx]);
+                            table.setFavorite(photos[photoIdx], favorites.contains(photos[photoIdx]));
+                            updatePhotoCaption();
+                            applyLanguage();
+                        }
+                    }
+                    else if (btnFav.contains(mouse)) {
                         settings.showFavoritesOnly = !settings.showFavoritesOnly;
-                        saveSettings(SETTINGS_FILE, settings);
+                        saveSettings(catalog, settings);
                         photos = applyFilters();
                         photoIdx = 0;
-                        btnFav.setLabel(settings.showFavoritesOnly ? tr(Key::BtnFavOn, settings.lang) : tr(Key::BtnFavOff, settings.lang));
-                        if (!photos.empty()) loadCurrentPhoto();
+                        if (!photos.empty()) showCurrentPhoto();
                         else screen = Screen::Menu;
                         applyLanguage();
                     }
-
-                    if (k->code == sf::Keyboard::Key::S) {
-                        if (!photos.empty()) {
-                            std::string file = baseName(photos[photoIdx]);
-                            toggleInList(favorites, file);
-                            saveLines(FAVORITES_FILE, favorites);
-                            loadCurrentPhoto();
-                            applyLanguage();
-                        }
-                    }
-
-                    if (k->code == sf::Keyboard::Key::D) {
+                    else if (btnDel.contains(mouse)) {
                         deleteCurrent();
-                        if (photos.empty()) screen = Screen::Menu;
+                    }
+                    else if (btnBack.contains(mouse)) {
+                        screen = Screen::Menu;
+                    }
+                    // a press on the photo itself starts a drag while zoomed in
+                    else if (zoom > 1.f && mouse.y < (float)window.getSize().y - barH) {
+                        panning = true;
                     }
                 }
             }
+        }
+    };
 
-            if (const auto* mb = ev->getIf<sf::Event::MouseButtonPressed>()) {
-                if (mb->button == sf::Mouse::Button::Left) {
-                    if (screen == Screen::Menu) {
-                        for (int i = 0; i < 4; i++) {
-                            if (menuHit[i].contains(mouse)) {
-                                menuIndex = i;
-                                runMenuAction(i, screen);
-                                break;
-                            }
-                        }
-                    } else {
-                        if (btnPrev.contains(mouse)) requestPhoto(photoIdx - 1);
-                        else if (btnNext.contains(mouse)) requestPhoto(photoIdx + 1);
-                        else if (btnPlay.contains(mouse)) {
-                            slideshow = !slideshow;
-                            slideTimer = 0.f;
-                            btnPlay.setLabel(slideshow ? tr(Key::BtnPause, settings.lang) : tr(Key::BtnPlay, settings.lang));
-                        }
-                        else if (btnInfo.contains(mouse)) {
-                            showInfo = !showInfo;
-                            btnInfo.setLabel(showInfo ? tr(Key::BtnInfoOn, settings.lang) : tr(Key::BtnInfo, settings.lang));
-                        }
-                        else if (btnStar.contains(mouse)) {
-                            if (!photos.empty()) {
-                                std::string file = baseName(photos[photoIdx]);
-                                toggleInList(favorites, file);
-                                saveLines(FAVORITES_FILE, favorites);
-                                loadCurrentPhoto();
-                                applyLanguage();
-                            }
-                        }
-                        else if (btnFav.contains(mouse)) {
-                            settings.showFavoritesOnly = !settings.showFavoritesOnly;
-                            saveSettings(SETTINGS_FILE, settings);
-                            photos = applyFilters();
-                            photoIdx = 0;
-                            if (!photos.empty()) loadCurrentPhoto();
-                            else screen = Screen::Menu;
-                            applyLanguage();
-                        }
-                        else if (btnDel.contains(mouse)) {
-                            deleteCurrent();
-                            if (photos.empty()) screen = Screen::Menu;
-                        }
-                        else if (btnBack.contains(mouse)) {
-                            screen = Screen::Menu;
-                        }
-                    }
-                }
+    while (window.isOpen()) {
+        bool animating = (screen == Screen::Photos &&
+                          (fade < 1.f || pendingIdx >= 0 || (!photos.empty() && !tex->covers(viewTarget()))))
+                      || (screen == Screen::Grid && gridBusy);
+
+        // nothing on screen can change without input: sleep in the OS until the next event
+        // (wake once a second while the info panel or profiler shows live stats, and at the
+        // next slide's deadline; every 10 ms past it while that slide is still decoding)
+        if (!animating && !redraw) {
+            sf::Time wake = showInfo || showProfiler ? sf::seconds(1.f) : sf::Time::Zero;
+            if (screen == Screen::Photos && slideshow) {
+                sf::Time due = sf::seconds(std::max(0.01f, slideDue - slideClock.getElapsedTime().asSeconds()));
+                if (wake == sf::Time::Zero || due < wake) wake = due;
+            }
+            // a running library scan has new images to merge twice a second
+            if ((library.scanning() || videoLibrary.scanning()) && (wake == sf::Time::Zero || wake > sf::seconds(0.5f)))
+                wake = sf::seconds(0.5f);
+            // a running job's progress ten times a second; a notice goes away on its own
+            if (jobQueue.busy() && (wake == sf::Time::Zero || wake > sf::seconds(0.1f))) wake = sf::seconds(0.1f);
+            if (!notice.empty()) {
+                sf::Time left = sf::seconds(std::max(0.01f, NOTICE_SECONDS - noticeClock.getElapsedTime().asSeconds()));
+                if (wake == sf::Time::Zero || left < wake) wake = left;
             }
+            if (const auto ev = window.waitEvent(wake)) handleEvent(*ev);
+            else redraw = true;
+            idleWaits++;
+            dtClock.restart();
         }
+        redraw = false;
+        Profiler::instance().beginFrame();
 
-        // ---------- draw ----------
-        sf::Color baseBg = settings.darkTheme ? sf::Color(12,12,16) : sf::Color(245,245,250);
-        window.clear(baseBg);
+        float dt = dtClock.restart().asSeconds();
 
-        if (screen == Screen::Menu) {
-            auto ws = window.getSize();
+        if (cpuWindow.getElapsedTime().asSeconds() >= 1.f) {
+            std::clock_t now = std::clock();
+            cpuPercent = 100.f * (float)(now - cpuMark) / (float)CLOCKS_PER_SEC / cpuWindow.restart().asSeconds();
+            cpuMark = now;
+            if (showInfo) infoDirty = true;
+        }
 
-            if (settings.darkTheme) {
-                sf::CircleShape glow1(260.f);
-                glow1.setFillColor(sf::Color(120, 160, 255, 35));
-                glow1.setPosition({-80.f, -90.f});
-                window.draw(glow1);
+        // images found by the background scan join the open list as they arrive; the photo on
+        // screen and the grid selection stay on the same files, and grid cells whose index now
+        // holds another file are fetched again
+        if (library.scanning() && library.pollScan()) {
+            metadata.sync(library.all());
+            if (screen != Screen::Menu && !videoGrid) {
+                std::vector<std::string> old = std::move(photos);
+                photos = applyFilters();
+                auto indexOf = [&](int i) -> int {
+                    if (i < 0 || i >= (int)old.size()) return -1;
+                    auto it = std::find(photos.begin(), photos.end(), old[i]);
+                    return it == photos.end() ? -1 : (int)(it - photos.begin());
+                };
+                int shown = indexOf(photoIdx);
+                gridSel = std::max(0, indexOf(gridSel));
+                if (pendingIdx >= 0) pendingIdx = indexOf(pendingIdx);
+                for (auto it = gridCells.begin(); it != gridCells.end(); ) {
+                    if (it->first >= (int)photos.size() || old[it->first] != photos[it->first]) {
+                        atlas.release(it->second.slot);
+                        it = gridCells.erase(it);
+                    } else ++it;
+                }
 
-                sf::CircleShape glow2(320.f);
-                glow2.setFillColor(sf::Color(255, 120, 160, 22));
-                glow2.setPosition({(float)ws.x - 520.f, (float)ws.y - 520.f});
-                window.draw(glow2);
+                if (photos.empty()) {
+                    screen = Screen::Menu;
+                } else if (shown < 0) {
+                    photoIdx = 0;
+                    if (screen == Screen::Photos) {
+                        fade = 1.f;
+                        fromTex.reset();
+                        showCurrentPhoto();
+                    }
+                } else {
+                    photoIdx = shown;
+                }
+                if (screen == Screen::Photos) updatePhotoCaption();
+                if (screen == Screen::Grid) {
+                    clampGridScroll();
+                    updateGridCaption();
+                }
+                chromeDirty = true;
+            }
+            redraw = true;
+        }
+        // the same for the video grid, which lists every video by path
+        if (videoLibrary.scanning() && videoLibrary.pollScan()) {
+            videoInfo.sync(videoLibrary.all());
+            if (screen == Screen::Grid && videoGrid) {
+                std::vector<std::string> old = std::move(photos);
+                photos = videoLibrary.paths();
+                auto it = gridSel < (int)old.size() ? std::find(photos.begin(), photos.end(), old[gridSel]) : photos.end();
+                gridSel = it == photos.end() ? 0 : (int)(it - photos.begin());
+                for (auto c = gridCells.begin(); c != gridCells.end(); ) {
+                    if (c->first >= (int)photos.size() || c->first >= (int)old.size() || old[c->first] != photos[c->first]) {
+                        atlas.release(c->second.slot);
+                        c = gridCells.erase(c);
+                    } else ++c;
+                }
+                if (photos.empty()) screen = Screen::Menu;
+                else {
+                    clampGridScroll();
+                    updateGridCaption();
+                }
+                chromeDirty = true;
+            }
+            redraw = true;
+        }
+        // a photo or video list picked from the menu before the scan had anything opens now
+        if (opening != Opening::None && screen == Screen::Menu) {
+            bool photosWanted = opening == Opening::Photos;
+            const LibraryIndex& lib = photosWanted ? library : videoLibrary;
+            if (lib.size() > 0 || !lib.scanning()) {
+                if (photosWanted ? enterPhotos() : enterVideos()) screen = photosWanted ? Screen::Photos : Screen::Grid;
+                opening = Opening::None;
+                redraw = true;
             }
+        } else {
+            opening = Opening::None;
+        }
+        // callbacks of finished jobs (new files into the library, failed deletes back into it)
+        if (jobQueue.poll()) redraw = true;
+        if (server && servedGeneration != library.generation()) {
+            server->publish(IMAGES, library.all());
+            servedGeneration = library.generation();
+        }
+        if (!library.scanning() && library.lastScan().count != scansReported) {
+            auto& r = library.lastScan();
+            scansReported = r.count;
+            std::printf("Library scan: %zu folders (%zu listed), %zu files sniffed, %zu images in %.2f s\n",
+                        r.dirs, r.listed, r.opened, r.images, r.seconds);
+            if (r.mislabeled) std::cout << "  " << r.mislabeled << " files have an extension that does not match their content\n";
+            if (r.unsupported) std::cout << "  " << r.unsupported << " images in formats that cannot be shown (HEIF/AVIF/WebP) were skipped\n";
+        }
 
-            sf::Text title(font, tr(Key::Title, settings.lang), (unsigned int)settings.fontSizeTitle);
-            title.setFillColor(settings.darkTheme ? sf::Color(245,245,245) : sf::Color(30,30,35));
+        // slideshow tick: advance exactly on the deadline. A slide that is not decoded by then
+        // goes up as soon as it is, and the schedule restarts from that moment.
+        if (screen == Screen::Photos && slideshow && photos.size() > 1) {
+            float now = slideClock.getElapsedTime().asSeconds();
+            int next = (photoIdx + 1) % (int)photos.size();
+            if (now >= slideDue && isPhotoReady(photos[next])) {
+                float late = now - slideDue;
+                if (late > 0.05f) {
+                    slidesLate++;
+                    std::cout << "Slide deadline missed by " << (int)(late * 1000.f) << " ms: " << baseName(photos[next]) << "\n";
+                    slideDue = now;
+                }
+                slideDue += SLIDE_DELAY;
+                slidesShown++;
+                requestPhoto(next);
+            }
+        }
 
-            sf::Text subtitle(font, tr(Key::Subtitle, settings.lang), 16);
-            subtitle.setFillColor(settings.darkTheme ? sf::Color(180,180,180) : sf::Color(90,90,100));
+        // crossfade tick
+        if (screen == Screen::Photos && fade < 1.f) {
+            fade = std::min(1.f, fade + dt / FADE_TIME);
+            if (fade >= 1.f) fromTex.reset();
+        }
 
-            sf::Vector2f cardSize(760.f, 360.f);
-            sf::Vector2f cardPos(((float)ws.x - cardSize.x) / 2.f,
-                                 ((float)ws.y - cardSize.y) / 2.f + 30.f);
+        // a photo asked for before it had a preview replaces the current one once decoded
+        if (screen == Screen::Photos && pendingIdx >= 0) {
+            if (pendingIdx >= (int)photos.size()) pendingIdx = -1;
+            else if (isPhotoReady(photos[pendingIdx])) {
+                int n = pendingIdx;
+                pendingIdx = -1;
+                transitionTo(n);
+            }
+        }
 
-            sf::RectangleShape card(cardSize);
-            card.setPosition(cardPos);
-            card.setFillColor(settings.darkTheme ? sf::Color(255,255,255,16) : sf::Color(0,0,0,10));
-            card.setOutlineThickness(1.f);
-            card.setOutlineColor(settings.darkTheme ? sf::Color(255,255,255,35) : sf::Color(0,0,0,25));
-            window.draw(card);
+        // swap in a higher decode level once a worker has it (after a resize or zoom)
+        if (screen == Screen::Photos && !photos.empty() && !tex->covers(viewTarget())
+            && isPhotoReady(photos[photoIdx])) {
+            loadCurrentPhoto();
+        }
 
-            title.setPosition({cardPos.x, cardPos.y - 110.f});
-            subtitle.setPosition({cardPos.x, cardPos.y - 62.f});
-            window.draw(title);
-            window.draw(subtitle);
+        {
+            PROFILE_ZONE("events");
+            while (const auto ev = window.pollEvent()) handleEvent(*ev);
+        }
 
-            sf::Text hint(font, tr(Key::HelpTop, settings.lang), 16);
-            hint.setFillColor(settings.darkTheme ? sf::Color(170,170,170) : sf::Color(100,100,110));
-            hint.setPosition({cardPos.x, cardPos.y + cardSize.y + 18.f});
-            window.draw(hint);
+        // hover state belongs to the screen it was computed on
+        if (screen != shownScreen) {
+            shownScreen = screen;
+            menuDirty = true;
+            updateHover();
+        }
 
-            sf::Text hint2(font, tr(Key::HelpBottom, settings.lang), 15);
-            hint2.setFillColor(settings.darkTheme ? sf::Color(160,160,160) : sf::Color(110,110,120));
-            hint2.setPosition({cardPos.x, cardPos.y + cardSize.y + 42.f});
-            window.draw(hint2);
+        // ---------- draw ----------
+        std::optional<ProfileZone> drawZone;
+        drawZone.emplace("draw");
+        sf::Color baseBg = settings.darkTheme ? sf::Color(12,12,16) : sf::Color(245,245,250);
+        window.clear(baseBg);
 
-            float itemX = cardPos.x + 28.f;
-            float itemY = cardPos.y + 26.f;
-            float itemH = 78.f;
+        if (menuDirty) rebuildMenu();
+        if (chromeDirty) rebuildChrome();
+        if (infoDirty && showInfo) rebuildInfo();
 
-            for (int i = 0; i < 4; i++) {
-                sf::FloatRect hit(
-                    sf::Vector2f(itemX, itemY + i * itemH),
-                    sf::Vector2f(cardSize.x - 56.f, itemH)
-                );
-                menuHit[i] = hit;
-
-                bool hover = hit.contains(mouse);
-                if (hover) menuIndex = i;
-                bool active = (i == menuIndex) || hover;
-
-                sf::RectangleShape itemBg({hit.size.x, hit.size.y});
-                itemBg.setPosition({hit.position.x, hit.position.y});
-                itemBg.setOutlineThickness(1.f);
-
-                if (settings.darkTheme) {
-                    itemBg.setFillColor(active ? sf::Color(255,255,255,28) : sf::Color(255,255,255,10));
-                    itemBg.setOutlineColor(active ? sf::Color(255,255,255,70) : sf::Color(255,255,255,25));
-                } else {
-                    itemBg.setFillColor(active ? sf::Color(0,0,0,12) : sf::Color(0,0,0,6));
-                    itemBg.setOutlineColor(active ? sf::Color(0,0,0,55) : sf::Color(0,0,0,18));
-                }
-                window.draw(itemBg);
-
-                sf::RectangleShape strip({6.f, itemH - 16.f});
-                strip.setPosition({itemX + 10.f, itemY + i * itemH + 8.f});
-                strip.setFillColor(active ? (settings.darkTheme ? sf::Color(160,200,255,200) : sf::Color(40,110,200,200))
-                                          : (settings.darkTheme ? sf::Color(255,255,255,25) : sf::Color(0,0,0,18)));
-                window.draw(strip);
-
-                sf::Text item(font, menu[i], (unsigned int)settings.fontSizeMenu);
-                item.setFillColor(settings.darkTheme ? (active ? sf::Color(250,250,250) : sf::Color(210,210,210))
-                                                     : (active ? sf::Color(30,30,35) : sf::Color(70,70,80)));
-                item.setPosition({itemX + 30.f, itemY + i * itemH + 12.f});
-                window.draw(item);
-
-                sf::Text d(font, desc[i], 15);
-                d.setFillColor(settings.darkTheme ? (active ? sf::Color(190,200,215) : sf::Color(160,160,170))
-                                                  : (active ? sf::Color(70,90,110) : sf::Color(110,110,120)));
-                d.setPosition({itemX + 30.f, itemY + i * itemH + 44.f});
-                window.draw(d);
-
-                if (active) {
-                    sf::Text arrow(font, ">", 24);
-                    arrow.setFillColor(settings.darkTheme ? sf::Color(240,240,240) : sf::Color(60,60,70));
-                    arrow.setPosition({itemX + cardSize.x - 86.f, itemY + i * itemH + 18.f});
-                    window.draw(arrow);
+        if (screen == Screen::Menu) {
+            if (settings.darkTheme) {
+                batch.add(menuGlow1);
+                batch.add(menuGlow2);
+            }
+            batch.add(menuCard);
+            for (auto& v : menuItems) {
+                batch.add(v.bg);
+                batch.add(v.strip);
+            }
+            batch.flush(window);
+
+            menuTitle.draw(textBatch);
+            menuSubtitle.draw(textBatch);
+            menuHint.draw(textBatch);
+            menuHint2.draw(textBatch);
+            for (auto& v : menuItems) {
+                v.label.draw(textBatch);
+                v.desc.draw(textBatch);
+                if (v.active) v.arrow.draw(textBatch);
+            }
+            textBatch.flush(window);
+        } else if (screen == Screen::Grid) {
+            gridBusy = updateGridCells();
+            // durations arrive with the posters
+            if (videoGrid && gridBusy) updateGridCaption();
+
+            int cols = gridColumns();
+            float inset = (GRID_CELL - (float)ThumbStore::SIZE) / 2.f;
+            sf::Vector2f thumbSize((float)ThumbStore::SIZE, (float)ThumbStore::SIZE);
+            for (auto& [i, cell] : gridCells) {
+                float x = GRID_PAD + (float)(i % cols) * GRID_CELL;
+                float y = GRID_TOP + (float)(i / cols) * GRID_CELL - gridScroll;
+
+                if (i == gridSel) {
+                    sf::FloatRect sel({x + 3.f, y + 3.f}, {GRID_CELL - 6.f, GRID_CELL - 6.f});
+                    batch.rect(sel, settings.darkTheme ? sf::Color(255,255,255,28) : sf::Color(0,0,0,16));
+                    batch.outline(sel, 2.f, settings.darkTheme ? sf::Color(160,200,255,200) : sf::Color(40,110,200,200));
                 }
+                if (cell.ready) batch.image(cell.slot, {{x + inset, y + inset}, thumbSize});
+                else batch.rect({{x + inset, y + inset}, thumbSize},
+                                settings.darkTheme ? sf::Color(255,255,255,10) : sf::Color(0,0,0,8));
             }
+            // the bar sits on top of the grid: finish the grid before it
+            batch.flush(window);
+
+            batch.add(bar);
+            btnBack.draw(batch, textBatch);
+            caption.draw(textBatch);
+            counter.draw(textBatch);
+            if (searchActive || !searchQuery.empty()) searchText.draw(textBatch);
+            else gridHelp.draw(textBatch);
+            batch.flush(window);
+            textBatch.flush(window);
         } else {
-            refreshBarColors();
-
-            spr.setColor(sf::Color(255, 255, 255, static_cast<std::uint8_t>(fade)));
-            if (!photos.empty()) window.draw(spr);
-
-            window.draw(bar);
-            window.draw(caption);
-            window.draw(counter);
-
-            btnPrev.draw(window);
-            btnNext.draw(window);
-            btnPlay.draw(window);
-            btnInfo.draw(window);
-            btnStar.draw(window);
-            btnFav.draw(window);
-            btnDel.draw(window);
-            btnBack.draw(window);
-
-            // top help line
-            sf::Text help(font,
-                          (settings.lang == Lang::RU)
-                              ? "Клавиши: ←/→ | P авто | I инфо | S избранное | F фильтр | D удалить | L язык | Esc меню"
-                              : "Keys: LEFT/RIGHT | P play | I info | S star | F filter | D delete | L language | ESC menu",
-                          13);
-            help.setFillColor(settings.darkTheme ? sf::Color(175,175,175) : sf::Color(90,90,100));
-            help.setPosition({20.f, 14.f});
-            window.draw(help);
-
-            if (showInfo && !photos.empty()) {
-                auto imgSize = tex.getSize();
-                fs::path p = photos[photoIdx];
-                std::error_code ec;
-                auto bytes = fs::file_size(p, ec);
-                std::uint64_t kb = ec ? 0 : (std::uint64_t)(bytes / 1024);
-
-                std::string file = baseName(photos[photoIdx]);
-                bool fav = inList(favorites, file);
-
-                sf::RectangleShape infoBg({480.f, 132.f});
-                infoBg.setFillColor(sf::Color(0,0,0,160));
-                infoBg.setPosition({20.f, 40.f});
-                window.draw(infoBg);
-
-                sf::Text info(font, "", 15);
-                info.setFillColor(sf::Color(240,240,240));
-                info.setPosition({30.f, 48.f});
-
-                if (settings.lang == Lang::RU) {
-                    info.setString(
-                        std::string("Файл: ") + file + "\n" +
-                        "Разрешение: " + std::to_string(imgSize.x) + " x " + std::to_string(imgSize.y) + "\n" +
-                        "Размер: " + std::to_string(kb) + " KB\n" +
-                        "Источник: Desktop/Photos\n" +
-                        (fav ? "★ Избранное" : "")
-                    );
-                } else {
-                    info.setString(
-                        std::string("File: ") + file + "\n" +
-                        "Resolution: " + std::to_string(imgSize.x) + " x " + std::to_string(imgSize.y) + "\n" +
-                        "Size: " + std::to_string(kb) + " KB\n" +
-                        "Source: Desktop/Photos\n" +
-                        (fav ? "★ Favorite" : "")
-                    );
+            if (!photos.empty()) {
+                // the outgoing photo stays opaque for the first half, so the incoming one
+                // blends over it rather than over the background
+                if (fromTex) {
+                    fromSpr.setColor(sf::Color(255, 255, 255, static_cast<std::uint8_t>(255.f * std::min(1.f, 2.f * (1.f - fade)))));
+                    drawDirect(fromSpr);
                 }
+                spr.setColor(sf::Color(255, 255, 255, static_cast<std::uint8_t>(255.f * fade)));
+                drawDirect(spr);
+            }
+
+            batch.add(bar);
+            for (auto* b : {&btnPrev, &btnNext, &btnPlay, &btnInfo, &btnStar, &btnFav, &btnDel, &btnBack})
+                b->draw(batch, textBatch);
+            caption.draw(textBatch);
+            counter.draw(textBatch);
+            viewerHelp.draw(textBatch);
+            batch.flush(window);
+            textBatch.flush(window);
 
-                window.draw(info);
+            if (showInfo && !photos.empty()) {
+                batch.add(infoBg);
+                infoText.draw(textBatch);
+                batch.flush(window);
+                textBatch.flush(window);
             }
         }
 
-        window.display();
+        if (layoutJobStrip()) {
+            batch.add(jobBg);
+            batch.add(jobFill);
+            jobText.draw(textBatch);
+            batch.flush(window);
+            textBatch.flush(window);
+        }
+        if (promptKind != PromptKind::None) {
+            if (promptDirty) rebuildPrompt();
+            batch.add(promptBg);
+            promptTitleText.draw(textBatch);
+            if (promptKind == PromptKind::Text) promptLine.draw(textBatch);
+            promptHint.draw(textBatch);
+            batch.flush(window);
+            textBatch.flush(window);
+        }
+
+        if (showProfiler) {
+            if (profilerRefresh.getElapsedTime().asSeconds() >= 0.5f) rebuildProfiler();
+            batch.add(profBg);
+            profText.draw(textBatch);
+            batch.flush(window);
+            textBatch.flush(window);
+        }
+        drawZone.reset();
+
+        framesDrawn++;
+        {
+            PROFILE_ZONE("display");
+            window.display();
+        }
+        Profiler::instance().endFrame();
     }
 
+    // a running import stops at the next file; deletes already confirmed still happen
+    jobQueue.shutdown();
+    if (server) {
+        server->stop();
+        serverReport(*server);
+    }
+    library.flush();
+    hashes.flush();
+    catalog.flush();
+    if (Profiler::instance().writeTrace()) std::cout << "Trace written\n";
+
+    auto ds = decoder.getStats();
+    std::cout << "Prefetch hits: " << ds.hits << ", misses: " << ds.misses << "\n";
+    float wall = std::max(0.001f, runClock.getElapsedTime().asSeconds());
+    std::cout << "Frames drawn: " << framesDrawn << ", idle waits: " << idleWaits
+              << ", average CPU: " << (int)(100.f * (float)(std::clock() - cpuStart) / (float)CLOCKS_PER_SEC / wall) << "%\n";
+    if (slidesShown) std::cout << "Slides shown: " << slidesShown << ", deadlines missed: " << slidesLate << "\n";
     return 0;
 }
\ No newline at end of file